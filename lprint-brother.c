@@ -11,6 +11,14 @@
 #ifdef LPRINT_EXPERIMENTAL
 
 
+//
+// Constants...
+//
+
+#define LPRINT_BROTHER_AUTO_MAX	1048576	// Maximum size of auto-length page buffer in bytes
+#define LPRINT_BROTHER_BAND	16384	// Size of output band in bytes
+
+
 //
 // Local types...
 //
@@ -19,11 +27,17 @@ typedef struct lprint_brother_s		// Brother driver data
 {
   bool		is_pt_series;		// Is this a PT-series printer?
   bool		is_ql_800;		// Is this the QL-800 printer?
+  bool		auto_length;		// Buffer the page for auto-length?
+  bool		compress;		// PackBits compress lines?
+  unsigned char	header[13];		// Print Information command
   lprint_dither_t dither;		// Dither buffer
-  int		count;			// Output count for print info
-  size_t	alloc_bytes,		// Allocated bytes for output buffer
-		num_bytes;		// Number of bytes in output buffer
-  unsigned char	*buffer;		// Output buffer
+  size_t	alloc_bytes,		// Allocated bytes for band buffer
+		num_bytes,		// Number of bytes in band buffer
+		last_bytes,		// Number of bytes through the last inked line
+		blank_bytes;		// Number of bytes for a blank line
+  unsigned	last_line;		// Number of lines through the last inked line
+  unsigned char	*buffer,		// Band buffer
+		*comp_buffer;		// PackBits compression buffer
 } lprint_brother_t;
 
 
@@ -344,8 +358,14 @@ lprint_brother_rendjob(
 
   papplDevicePuts(device, "\032");	// Eject the last page
 
+  // Answer a queued status request now that the last page has been printed...
+  if (lprintSessionStatusQueued(job))
+    lprint_brother_get_status(papplJobGetPrinter(job), device);
+
   free(brother->buffer);
+  free(brother->comp_buffer);
   free(brother);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -365,49 +385,53 @@ lprint_brother_rendpage(
 {
   lprint_brother_t	*brother = (lprint_brother_t *)papplJobGetData(job);
 					// Brother driver data
-  unsigned char	buffer[13];		// Print Information command buffer
+  bool			ret = true;	// Return value
+  unsigned		lines;		// Number of lines to print
 
 
-  // Write last line
+  (void)page;
+
+  // Write last line and any remaining band data...
   lprint_brother_rwriteline(job, options, device, options->header.cupsHeight, NULL);
 
-  // Send print information...
-  buffer[ 0] = 0x1b;
-  buffer[ 1] = 'i';
-  buffer[ 2] = 'z';
-  buffer[ 3] = !strncmp(options->media.type, "continuous", 10) ? 0x04 : 0x0c;
-  buffer[ 4] = 0;
-  buffer[ 5] = LPRINT_PWG_TO_MM(options->media.size_width);
-  buffer[ 6] = LPRINT_PWG_TO_MM(options->media.size_length);
-#if 1
-  buffer[ 7] = options->header.cupsHeight & 255;
-  buffer[ 8] = (options->header.cupsHeight >> 8) & 255;
-  buffer[ 9] = (options->header.cupsHeight >> 16) & 255;
-  buffer[10] = (options->header.cupsHeight >> 24) & 255;
-#else
-  buffer[ 7] = brother->count & 255;
-  buffer[ 8] = (brother->count >> 8) & 255;
-  buffer[ 9] = (brother->count >> 16) & 255;
-  buffer[10] = (brother->count >> 24) & 255;
-#endif // 1
-  buffer[11] = page == 0 ? 0 : 1;
-  buffer[12] = 0;
+  if (brother->auto_length)
+  {
+    // Send the print information with the shortened line count, followed by
+    // the lines through the last inked line plus the margin...
+    lines = lprintAutoLength(options, brother->last_line);
 
-  if (!papplDeviceWrite(device, buffer, sizeof(buffer)))
-    return (false);
+    brother->header[ 7] = lines & 255;
+    brother->header[ 8] = (lines >> 8) & 255;
+    brother->header[ 9] = (lines >> 16) & 255;
+    brother->header[10] = (lines >> 24) & 255;
 
-  // Send label data...
-  if (brother->num_bytes > 0 && !papplDeviceWrite(device, brother->buffer, brother->num_bytes))
-    return (false);
+    brother->num_bytes = brother->last_bytes + (lines - brother->last_line) * brother->blank_bytes;
+
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Auto-length: printing %u of %u lines.", lines, options->header.cupsHeight);
+
+    if (papplDeviceWrite(device, brother->header, sizeof(brother->header)) < 0 || papplDeviceWrite(device, brother->compress ? "M\002" : "M\000", 2) < 0)
+      ret = false;
+  }
+
+  if (ret && brother->num_bytes > 0 && papplDeviceWrite(device, brother->buffer, brother->num_bytes) < 0)
+    ret = false;
+
+  brother->num_bytes = 0;
 
   // Eject/cut
-  papplDevicePrintf(device, "\033iM%c", !strncmp(options->media.type, "continuous", 10) ? 64 : 0);
-  papplDeviceFlush(device);
+  if (ret)
+  {
+    papplDevicePrintf(device, "\033iM%c", !strncmp(options->media.type, "continuous", 10) ? 64 : 0);
+    papplDeviceFlush(device);
+  }
 
   // Free memory and return...
   lprintDitherFree(&brother->dither);
 
-  return (true);
+  free(brother->comp_buffer);
+  brother->comp_buffer = NULL;
+
+  return (ret);
 }
 
 
@@ -434,27 +458,34 @@ lprint_brother_rstartjob(
   // Save driver data...
   papplJobSetData(job, brother);
 
-  // Reset the printer...
-  memset(buffer, 0, sizeof(buffer));
   if (driver_name && !strncmp(driver_name, "brother_pt-", 11))
-  {
-    // Send short reset sequence for PT-series tape printers
-    papplDeviceWrite(device, buffer, 100);
     brother->is_pt_series = true;
-  }
   else
+    brother->is_ql_800 = driver_name && !strcmp(driver_name, "brother_ql-800");
+
+  brother->compress = lprintCompression() != LPRINT_COMPRESSION_NONE;
+
+  // Reset the printer, unless continuing a session with a ready printer...
+  if (lprintSessionBegin(job, device) || !lprint_brother_get_status(papplJobGetPrinter(job), device))
   {
-    // Send long reset sequence for QL-series label printers
-    papplDeviceWrite(device, buffer, sizeof(buffer));
+    memset(buffer, 0, sizeof(buffer));
+    if (brother->is_pt_series)
+    {
+      // Send short reset sequence for PT-series tape printers
+      papplDeviceWrite(device, buffer, 100);
+    }
+    else
+    {
+      // Send long reset sequence for QL-series label printers
+      papplDeviceWrite(device, buffer, sizeof(buffer));
+    }
 
-    brother->is_ql_800 = driver_name && !strcmp(driver_name, "brother_ql-800");
+    // Get status information...
+    lprint_brother_get_status(papplJobGetPrinter(job), device);
+//    if (!lprint_brother_get_status(papplJobGetPrinter(job), device))
+//      return (false);
   }
 
-  // Get status information...
-  lprint_brother_get_status(papplJobGetPrinter(job), device);
-//  if (!lprint_brother_get_status(papplJobGetPrinter(job), device))
-//    return (false);
-
   // Reset and set raster mode...
   if (!papplDevicePuts(device, "\033@\033ia\001"))
     return (false);
@@ -472,6 +503,13 @@ lprint_brother_rstartjob(
 //
 // 'lprint_brother_rstartpage()' - Start a page.
 //
+// The print information command needs the number of raster lines up front,
+// which is the page height, so the raster data can be streamed to the printer
+// in bands as it is produced.  When auto-length is enabled for continuous
+// media, the page is buffered instead and the print information is sent by
+// `lprint_brother_rendpage()` with the shortened line count.  Pages that do not
+// fit in `LPRINT_BROTHER_AUTO_MAX` bytes are printed at the full page length.
+//
 
 static bool				// O - `true` on success, `false` on failure
 lprint_brother_rstartpage(
@@ -482,18 +520,74 @@ lprint_brother_rstartpage(
 {
   lprint_brother_t *brother = (lprint_brother_t *)papplJobGetData(job);
 					// Brother driver data
+  unsigned char	*buffer = brother->header;
+					// Print Information command buffer
+  size_t	alloc_bytes;		// Size of band buffer
 
 
   if (page > 0)
+  {
     papplDevicePuts(device, "\014");	// Eject the previous page
 
+    // Answer a queued status request between labels - status cannot be mixed
+    // into a raster page, so wait until the print command has been sent...
+    if (lprintSessionStatusQueued(job))
+      lprint_brother_get_status(papplJobGetPrinter(job), device);
+  }
+
   if (!lprintDitherAlloc(&brother->dither, job, options, /*head_width*/0, CUPS_CSPACE_K, options->header.HWResolution[0] == 300 ? 1.2 : 1.0, /*out_mirror*/false))
     return (false);
 
-  brother->count     = 0;
-  brother->num_bytes = 0;
+  if ((brother->comp_buffer = lprintPackBitsAlloc(brother->dither.out_width)) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate compression buffer.");
+    return (false);
+  }
 
-  return (true);
+  if ((alloc_bytes = LPRINT_BROTHER_BAND + 3 + brother->dither.out_width + (brother->dither.out_width + 127) / 128) > brother->alloc_bytes)
+  {
+    // Allocate the band buffer, big enough for at least one line...
+    free(brother->buffer);
+
+    if ((brother->buffer = malloc(alloc_bytes)) == NULL)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate %lu bytes of memory memory.", (unsigned long)alloc_bytes);
+      brother->alloc_bytes = 0;
+      return (false);
+    }
+
+    brother->alloc_bytes = alloc_bytes;
+  }
+
+  brother->num_bytes   = 0;
+  brother->last_bytes  = 0;
+  brother->blank_bytes = 0;
+  brother->last_line   = 0;
+  brother->auto_length = lprintAutoLengthEnabled() && !strncmp(options->media.type, "continuous", 10);
+
+  // Send print information...
+  buffer[ 0] = 0x1b;
+  buffer[ 1] = 'i';
+  buffer[ 2] = 'z';
+  buffer[ 3] = !strncmp(options->media.type, "continuous", 10) ? 0x04 : 0x0c;
+  buffer[ 4] = 0;
+  buffer[ 5] = LPRINT_PWG_TO_MM(options->media.size_width);
+  buffer[ 6] = LPRINT_PWG_TO_MM(options->media.size_length);
+  buffer[ 7] = options->header.cupsHeight & 255;
+  buffer[ 8] = (options->header.cupsHeight >> 8) & 255;
+  buffer[ 9] = (options->header.cupsHeight >> 16) & 255;
+  buffer[10] = (options->header.cupsHeight >> 24) & 255;
+  buffer[11] = page == 0 ? 0 : 1;
+  buffer[12] = 0;
+
+  if (brother->auto_length)
+    return (true);
+
+  if (papplDeviceWrite(device, buffer, sizeof(brother->header)) < 0)
+    return (false);
+
+  // Enable PackBits compression (TIFF mode) or send uncompressed lines...
+  return (papplDeviceWrite(device, brother->compress ? "M\002" : "M\000", 2) > 0);
 }
 
 
@@ -511,62 +605,100 @@ lprint_brother_rwriteline(
 {
   lprint_brother_t	*brother = (lprint_brother_t *)papplJobGetData(job);
 					// Brother driver data
-  unsigned char		*bufptr;	// Pointer into page buffer
+  unsigned char		*bufptr;	// Pointer into band buffer
+  size_t		comp_bytes;	// Compressed bytes
 
 
   if (!lprintDitherLine(&brother->dither, y, line))
     return (true);
 
-  if ((brother->alloc_bytes - brother->num_bytes) < (3 + brother->dither.out_width))
+  if ((brother->alloc_bytes - brother->num_bytes) < (3 + brother->dither.out_width + (brother->dither.out_width + 127) / 128) && brother->auto_length)
   {
-    size_t temp_alloc = brother->alloc_bytes + brother->dither.out_width + 4096;
-				      // New allocated size
-    unsigned char *temp = realloc(brother->buffer, temp_alloc);
-				      // New buffer
+    if ((2 * brother->alloc_bytes) > LPRINT_BROTHER_AUTO_MAX)
+    {
+      // Page buffer is at its limit, send the print information for the full
+      // page length and stream the rest of the page in bands...
+      papplLogJob(job, PAPPL_LOGLEVEL_INFO, "Auto-length page is larger than %lu bytes, printing the full page length.", (unsigned long)brother->alloc_bytes);
+
+      if (papplDeviceWrite(device, brother->header, sizeof(brother->header)) < 0 || papplDeviceWrite(device, brother->compress ? "M\002" : "M\000", 2) < 0 || papplDeviceWrite(device, brother->buffer, brother->num_bytes) < 0)
+        return (false);
 
-    if (!temp)
+      brother->num_bytes   = 0;
+      brother->auto_length = false;
+    }
+    else
     {
-      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate %lu bytes of memory memory.", (unsigned long)temp_alloc);
-      return (false);
+      // Page buffer is full, grow it...
+      if ((bufptr = realloc(brother->buffer, 2 * brother->alloc_bytes)) == NULL)
+      {
+        papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate %lu bytes of memory.", (unsigned long)(2 * brother->alloc_bytes));
+        return (false);
+      }
+
+      brother->buffer      = bufptr;
+      brother->alloc_bytes *= 2;
     }
+  }
+  else if ((brother->alloc_bytes - brother->num_bytes) < (3 + brother->dither.out_width + (brother->dither.out_width + 127) / 128))
+  {
+    // Band buffer is full, send it...
+    if (papplDeviceWrite(device, brother->buffer, brother->num_bytes) < 0)
+      return (false);
 
-    brother->alloc_bytes = temp_alloc;
-    brother->buffer      = temp;
+    brother->num_bytes = 0;
   }
 
   bufptr = brother->buffer + brother->num_bytes;
 
-  if (brother->is_ql_800 || brother->dither.output[0] || memcmp(brother->dither.output, brother->dither.output + 1, brother->dither.out_width - 1))
+  if (brother->dither.output[0] || memcmp(brother->dither.output, brother->dither.output + 1, brother->dither.out_width - 1))
   {
-    // Non-blank line...
-    // TODO: Add PackBits compression support
-    brother->count += 3 + brother->dither.out_width;
+    // Track the last inked line (output line y - 1) for auto-length...
+    brother->last_line = y;
+  }
+
+  if (brother->is_ql_800 || brother->last_line == y)
+  {
+    // Non-blank line, PackBits compress it...
+    if (brother->compress)
+    {
+      comp_bytes = lprintPackBitsCompress(brother->comp_buffer, brother->dither.output, brother->dither.out_width);
+    }
+    else
+    {
+      memcpy(brother->comp_buffer, brother->dither.output, brother->dither.out_width);
+      comp_bytes = brother->dither.out_width;
+    }
 
     if (brother->is_pt_series)
     {
       *bufptr++ = 'G';
-      *bufptr++ = brother->dither.out_width & 255;
-      *bufptr++ = (brother->dither.out_width >> 8) & 255;
+      *bufptr++ = comp_bytes & 255;
+      *bufptr++ = (comp_bytes >> 8) & 255;
     }
     else
     {
       *bufptr++ = 'g';
       *bufptr++ = 0;
-      *bufptr++ = brother->dither.out_width;
+      *bufptr++ = (unsigned char)comp_bytes;
     }
 
-    memcpy(bufptr, brother->dither.output, brother->dither.out_width);
-    brother->num_bytes += 3 + brother->dither.out_width;
+    memcpy(bufptr, brother->comp_buffer, comp_bytes);
+    brother->num_bytes += 3 + comp_bytes;
+
+    if (brother->last_line != y)
+      brother->blank_bytes = 3 + comp_bytes;
   }
   else
   {
     // Blank line
-    brother->count ++;
-
     *bufptr = 'Z';
     brother->num_bytes ++;
+    brother->blank_bytes = 1;
   }
 
+  if (brother->last_line == y)
+    brother->last_bytes = brother->num_bytes;
+
   return (true);
 }
 
@@ -579,8 +711,44 @@ static bool				// O - `true` on success, `false` on failure
 lprint_brother_status(
     pappl_printer_t *printer)		// I - Printer
 {
-  (void)printer;
+  pappl_device_t	*device;	// Connection to printer
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
 
-  return (true);
+
+  // See if the status checks need to be suspended...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata->status_disabled || extdata->status_time >= time(NULL))
+    return (true);
+
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
+  // No, try talking to the printer...
+  if ((device = papplPrinterOpenDevice(printer)) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to open device for status.");
+    goto done;
+  }
+
+  // Get the printer status...
+  ret = lprint_brother_get_status(printer, device);
+
+  done:
+
+  papplPrinterCloseDevice(printer);
+
+  if (!ret)
+  {
+    // Don't try doing status updates for 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+    ret = true;
+  }
+
+  return (ret);
 }
 #endif // LPRINT_EXPERIMENTAL
@@ -8,6 +8,11 @@
 //
 
 #include "lprint.h"
+#ifdef __SSE2__
+#  include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#  include <arm_neon.h>
+#endif // __SSE2__
 
 
 //
@@ -16,16 +21,197 @@
 
 #define LPRINT_WHITE	56
 #define LPRINT_BLACK	199
+#define LPRINT_HASH_INIT 14695981039346656037ULL
+					// Initial FNV-1a hash value
+#define LPRINT_STATUS_ACTIVE 5		// Status poll interval with queued jobs in seconds
+#define LPRINT_STATUS_IDLE 60		// Status poll interval when idle in seconds
+#define LPRINT_STATUS_WORKERS 4		// Number of status poll threads
 #define LPRINT_TRASH	"<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"16\" height=\"16\" fill=\"currentColor\" class=\"bi bi-trash3-fill\" viewBox=\"0 0 16 16\"><path d=\"M11 1.5v1h3.5a.5.5 0 0 1 0 1h-.538l-.853 10.66A2 2 0 0 1 11.115 16h-6.23a2 2 0 0 1-1.994-1.84L2.038 3.5H1.5a.5.5 0 0 1 0-1H5v-1A1.5 1.5 0 0 1 6.5 0h3A1.5 1.5 0 0 1 11 1.5Zm-5 0v1h4v-1a.5.5 0 0 0-.5-.5h-3a.5.5 0 0 0-.5.5ZM4.5 5.029l.5 8.5a.5.5 0 1 0 .998-.06l-.5-8.5a.5.5 0 1 0-.998.06Zm6.53-.528a.5.5 0 0 0-.528.47l-.5 8.5a.5.5 0 0 0 .998.058l.5-8.5a.5.5 0 0 0-.47-.528ZM8 4.5a.5.5 0 0 0-.5.5v8.5a.5.5 0 0 0 1 0V5a.5.5 0 0 0-.5-.5Z\"/></svg>"
 
 
+//
+// Local types...
+//
+
+typedef struct lprint_dkey_s		// Driver index key
+{
+  uint64_t	hash;			// Hash of "KEY:value"
+  size_t	match;			// Index into matches
+} lprint_dkey_t;
+
+typedef struct lprint_dmatch_s		// Parsed driver device ID match string
+{
+  size_t	driver;			// Index into driver list
+  bool		keyed;			// Is there a key for this match?
+  pappl_len_t	num_pairs;		// Number of key/value pairs
+  cups_option_t	*pairs;			// Key/value pairs
+} lprint_dmatch_t;
+
+struct lprint_drivers_s			// Driver index
+{
+  size_t	num_drivers;		// Number of drivers
+  pappl_pr_driver_t *drivers;		// Drivers
+  size_t	num_names,		// Size of name hash table (power of 2)
+		*names;			// Name hash table (driver number + 1)
+  size_t	num_matches;		// Number of parsed match strings
+  lprint_dmatch_t *matches;		// Parsed match strings in driver order
+  size_t	num_keys;		// Number of keys
+  lprint_dkey_t	*keys;			// Keys sorted by hash
+};
+
+
+//
+// Local globals...
+//
+
+static int		lprint_auto_length = -1;
+					// Auto-length margin in millimeters, -1 to disable
+static lprint_compression_t lprint_compression = LPRINT_COMPRESSION_AUTO;
+					// Graphics compression
+static bool		lprint_graphics_enabled = true;
+					// Store graphics in printer memory?
+static pthread_mutex_t	lprint_graphics_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for stored graphics
+static pthread_mutex_t	lprint_media_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for media size indexes
+static pthread_mutex_t	lprint_session_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for device session state
+static int		lprint_session_timeout = 0;
+					// Idle timeout for device sessions in seconds, 0 to disable
+static size_t		lprint_status_alloc = 0;
+					// Allocated printers in status queue
+static pthread_cond_t	lprint_status_cond = PTHREAD_COND_INITIALIZER;
+					// Condition for status poll changes
+static size_t		lprint_status_count = 0;
+					// Number of printers with extension data
+static const char * const lprint_status_drivers[] =
+{					// Driver prefixes with scheduled status polls
+  "brother_",
+  "dymo_",
+  "epl2_",
+  "sii_",
+  "tspl_"
+};
+static pthread_mutex_t	lprint_status_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for status polls
+static size_t		lprint_status_num = 0;
+					// Number of printers in status queue
+static size_t		lprint_status_num_threads = 0;
+					// Number of status threads
+static pappl_printer_t	**lprint_status_queue = NULL;
+					// Printers waiting for a status poll
+static bool		lprint_status_running = false;
+					// Are the status threads running?
+static bool		lprint_status_stop = false;
+					// Stop the status threads?
+static pappl_system_t	*lprint_status_system = NULL;
+					// System for status polls
+static pthread_t	lprint_status_threads[LPRINT_STATUS_WORKERS + 1];
+					// Status scheduler and poll threads
+
+
 //
 // Local functions...
 //
 
+static int	compare_dkeys(lprint_dkey_t *a, lprint_dkey_t *b);
+static int	compare_length(lprint_msize_t *a, lprint_msize_t *b);
+static int	compare_width(lprint_msize_t *a, lprint_msize_t *b);
 static void	free_cmedia(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
+static uint64_t	hash_string(uint64_t hash, const char *s, size_t len);
 static char	*localize_keyword(pappl_client_t *client, const char *attrname, const char *keyword, char *buffer, size_t bufsize);
+static void	match_driver(lprint_dmatch_t *match, pappl_len_t num_did, cups_option_t *did, lprint_dmatch_t **best, int *best_score);
+static void	match_key(lprint_drivers_t *index, uint64_t hash, pappl_len_t num_did, cups_option_t *did, lprint_dmatch_t **best, int *best_score);
 static void	media_chooser(pappl_client_t *client, pappl_pr_driver_data_t *driver_data, const char *title, const char *name, pappl_media_col_t *media);
+static const char *media_find(lprint_extdata_t *cmedia, int width, int length);
+static void	media_index(lprint_extdata_t *cmedia, pappl_pr_driver_data_t *data);
+static const unsigned char *packbits_literal_end(const unsigned char *ptr, const unsigned char *end);
+static const unsigned char *packbits_run_end(const unsigned char *ptr, const unsigned char *end);
+static void	status_add_printer(void);
+static void	*status_poll(void *data);
+static void	status_printer_cb(pappl_printer_t *printer, void *data);
+static void	status_remove_printer(lprint_extdata_t *extdata);
+static void	*status_run(void *data);
+static void	status_start(void);
+
+
+//
+// 'lprintAutoLength()' - Get the number of lines to print on continuous media.
+//
+// The `lines` argument is the number of lines up to and including the last
+// inked line.  The auto-length margin is added, limited to the page height.
+// The full page height is returned when auto-length is disabled.
+//
+
+unsigned				// O - Number of lines to print
+lprintAutoLength(
+    pappl_pr_options_t *options,	// I - Job options
+    unsigned           lines)		// I - Number of lines through the last inked line
+{
+  if (lprint_auto_length < 0)
+    return (options->header.cupsHeight);
+
+  lines += (unsigned)(lprint_auto_length * options->header.HWResolution[1] * 10 / 254);
+
+  if (lines < 1)
+    lines = 1;
+  else if (lines > options->header.cupsHeight)
+    lines = options->header.cupsHeight;
+
+  return (lines);
+}
+
+
+//
+// 'lprintAutoLengthEnabled()' - Is auto-length enabled?
+//
+
+bool					// O - `true` if enabled, `false` otherwise
+lprintAutoLengthEnabled(void)
+{
+  return (lprint_auto_length >= 0);
+}
+
+
+//
+// 'lprintAutoLengthSetMargin()' - Set the margin after the last inked line on continuous media.
+//
+// A margin less than `0` disables auto-length, so the full page length is
+// printed.
+//
+
+void
+lprintAutoLengthSetMargin(int margin)	// I - Margin in millimeters or `-1` to disable
+{
+  lprint_auto_length = margin;
+}
+
+
+//
+// 'lprintCompression()' - Get the graphics compression.
+//
+
+lprint_compression_t			// O - Graphics compression
+lprintCompression(void)
+{
+  return (lprint_compression);
+}
+
+
+//
+// 'lprintCompressionSetMode()' - Set the graphics compression.
+//
+// `LPRINT_COMPRESSION_AUTO` uses each driver's choice of encoding.
+// `LPRINT_COMPRESSION_NONE` and `LPRINT_COMPRESSION_ALWAYS` override it, for
+// example to compare the bytes sent for each encoding.
+//
+
+void
+lprintCompressionSetMode(
+    lprint_compression_t compression)	// I - Graphics compression
+{
+  lprint_compression = compression;
+}
 
 
 //
@@ -357,230 +543,677 @@ lprintDitherLine(
 
 
 //
-// 'lprintMediaLoad()' - Load custom label sizes for a printer.
+// 'lprintDriversDelete()' - Free a driver index.
 //
 
-bool					// O - `true` on success, `false` on error
-lprintMediaLoad(
-    pappl_printer_t        *printer,	// I - Printer
-    pappl_pr_driver_data_t *data)	// I - Driver data
+void
+lprintDriversDelete(
+    lprint_drivers_t *index)		// I - Driver index
 {
-  lprint_extdata_t	*cmedia;	// Custom media
-  int			fd;		// Custom media file descriptor
-  cups_file_t		*fp;		// Custom media file
-  char			filename[1024],	// Custom media filename
-			line[256];	// Line from file
-  int			i;		// Looping var
-
-
-  // Allocate memory as needed...
-  if ((cmedia = (lprint_extdata_t *)data->extension) == NULL)
-  {
-    if ((cmedia = (lprint_extdata_t *)calloc(1, sizeof(lprint_extdata_t))) == NULL)
-      return (false);
-
-    data->extension = cmedia;
-    data->delete_cb = free_cmedia;
-  }
-
-  // Load any existing custom media sizes...
-  if ((fd = papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "r")) < 0)
-    return (true);
+  size_t	i;			// Looping var
 
-  if ((fp = cupsFileOpenFd(fd, "r")) == NULL)
-  {
-    close(fd);
-    return (true);
-  }
 
-  for (i = 0; i < data->num_source && cupsFileGets(fp, line, sizeof(line)); i ++)
-    cupsCopyString(cmedia->custom_name[i], line, sizeof(cmedia->custom_name[i]));
+  if (!index)
+    return;
 
-  cupsFileClose(fp);
+  for (i = 0; i < index->num_matches; i ++)
+    cupsFreeOptions((cups_len_t)index->matches[i].num_pairs, index->matches[i].pairs);
 
-  return (true);
+  free(index->names);
+  free(index->matches);
+  free(index->keys);
+  free(index);
 }
 
 
 //
-// 'lprintMediaMatch()' - Match the loaded media to one of the supported sizes.
+// 'lprintDriversFind()' - Find a driver by name.
 //
 
-const char *				// O - Matching media size or `NULL` if none
-lprintMediaMatch(
-    pappl_printer_t *printer,		// I - Printer
-    int             source,		// I - "media-source" index (0-based)
-    int             width,		// I - Width in hundredths of millimeters or `0` if unknown
-    int             length)		// I - Length in hundredths of millimeters
+const pappl_pr_driver_t *		// O - Driver or `NULL` if not found
+lprintDriversFind(
+    lprint_drivers_t *index,		// I - Driver index
+    const char       *name)		// I - Driver name
 {
-  pappl_pr_driver_data_t pdata;		// Printer driver data
-  lprint_extdata_t	*cmedia;	// Custom media info
-  int			i;		// Looping var
-  pwg_media_t		*pwg;		// Current size info
-  const char		*ret = NULL;	// Return value
+  size_t	bucket,			// Current bucket
+		driver;			// Driver number
 
 
-  papplPrinterGetDriverData(printer, &pdata);
+  if (!index || !name)
+    return (NULL);
 
-  for (i = 0; i < pdata.num_media; i ++)
+  for (bucket = (size_t)hash_string(LPRINT_HASH_INIT, name, strlen(name)) & (index->num_names - 1); (driver = index->names[bucket]) > 0; bucket = (bucket + 1) & (index->num_names - 1))
   {
-    if ((!strncmp(pdata.media[i], "custom_", 7) || !strncmp(pdata.media[i], "roll_", 5)) && (strstr(pdata.media[i], "_min_") != NULL || strstr(pdata.media[i], "_max_") != NULL))
-      continue;
+    if (!strcmp(name, index->drivers[driver - 1].name))
+      return (index->drivers + driver - 1);
+  }
 
-    if ((pwg = pwgMediaForPWG(pdata.media[i])) == NULL)
-      continue;
+  return (NULL);
+}
 
-    if ((abs(pwg->width - width) <= 100 || !width) && (abs(pwg->length - length) <= 100 || !length))
-    {
-      if (!ret || !strncmp(pdata.media[i], "custom_", 7) || !strncmp(pdata.media[i], "roll_", 5))
-        ret = pdata.media[i];
-    }
-  }
 
-  if (!ret)
-  {
-    if (!pdata.extension)
-      lprintMediaLoad(printer, &pdata);
+//
+// 'lprintDriversMatch()' - Find the best driver for an IEEE-1284 device ID.
+//
+// Each key/value pair in the device ID, and each comma-delimited value, is
+// looked up in the index to find the drivers that might match.  Only those
+// drivers are scored, using the same rules as a full scan of the driver list:
+// 2 for each exact match and 1 for a partial match in a comma-delimited
+// field, with ties going to the earlier driver.
+//
 
-    if ((cmedia = (lprint_extdata_t *)pdata.extension) != NULL)
-    {
-      if (length == 0)
-        pwgFormatSizeName(cmedia->custom_name[source], sizeof(cmedia->custom_name[source]), "roll", pdata.source[source], width, length, /*units*/NULL);
-      else
-        pwgFormatSizeName(cmedia->custom_name[source], sizeof(cmedia->custom_name[source]), "custom", pdata.source[source], width, length, /*units*/NULL);
+const char *				// O - Driver name or `NULL` for none
+lprintDriversMatch(
+    lprint_drivers_t *index,		// I - Driver index
+    pappl_len_t      num_did,		// I - Number of device ID key/value pairs
+    cups_option_t    *did)		// I - Device ID key/value pairs
+{
+  pappl_len_t	i;			// Looping var
+  size_t	j;			// Looping var
+  cups_option_t	*current;		// Current key/value pair
+  const char	*start,			// Start of comma-delimited value
+		*end;			// End of comma-delimited value
+  uint64_t	prefix;			// Hash of "KEY:"
+  lprint_dmatch_t *best = NULL;		// Best match
+  int		best_score = 0;		// Best score
 
-      lprintMediaUpdate(printer, &pdata);
-      lprintMediaSave(printer, &pdata);
 
-      ret = cmedia->custom_name[source];
-    }
+  if (!index)
+    return (NULL);
+
+  // Score the drivers that have no usable key...
+  for (j = 0; j < index->num_matches; j ++)
+  {
+    if (!index->matches[j].keyed)
+      match_driver(index->matches + j, num_did, did, &best, &best_score);
   }
 
-  if (ret && strcmp(pdata.media_ready[source].size_name, ret) && (pwg = pwgMediaForPWG(ret)) != NULL)
+  // Then look up each key/value pair in the device ID...
+  for (i = num_did, current = did; i > 0; i --, current ++)
   {
-    // Ready media has changed...
-    cupsCopyString(pdata.media_ready[source].size_name, ret, sizeof(pdata.media_ready[source].size_name));
-    pdata.media_ready[source].size_width  = pwg->width;
-    pdata.media_ready[source].size_length = pwg->length;
+    prefix = hash_string(hash_string(LPRINT_HASH_INIT, current->name, strlen(current->name)), ":", 1);
 
-    if (pwg->length == 0)
-      cupsCopyString(pdata.media_ready[source].type, "continuous", sizeof(pdata.media_ready[source].type));
-    else
-      cupsCopyString(pdata.media_ready[source].type, "label", sizeof(pdata.media_ready[source].type));
+    match_key(index, hash_string(prefix, current->value, strlen(current->value)), num_did, did, &best, &best_score);
 
-    papplPrinterSetDriverData(printer, &pdata, NULL);
+    if (!strchr(current->value, ','))
+      continue;
+
+    for (start = current->value; *start; start = *end ? end + 1 : end)
+    {
+      if ((end = strchr(start, ',')) == NULL)
+        end = start + strlen(start);
+
+      match_key(index, hash_string(prefix, start, (size_t)(end - start)), num_did, did, &best, &best_score);
+    }
   }
 
-  return (ret);
+  return (best ? index->drivers[best->driver].name : NULL);
 }
 
 
 //
-// 'lprintMediaSave()' - Save custom label sizes for a printer.
+// 'lprintDriversNew()' - Create an index for a driver list.
+//
+// The device ID match strings are parsed once and indexed by their first
+// key/value pair, for example "MFG:Zebra Technologies", and the driver names
+// are put in a hash table.  The driver list must not change while the index
+// is in use.
 //
 
-bool					// O - `true` on success, `false` on error
-lprintMediaSave(
-    pappl_printer_t        *printer,	// I - Printer
-    pappl_pr_driver_data_t *data)	// I - Driver data
+lprint_drivers_t *			// O - Driver index or `NULL` on error
+lprintDriversNew(
+    size_t            num_drivers,	// I - Number of drivers
+    pappl_pr_driver_t *drivers)		// I - Drivers
 {
-  lprint_extdata_t	*cmedia;	// Custom media
-  int			i,		// Looping var
-			fd;		// Custom media file descriptor
-  cups_file_t		*fp;		// Custom media file
-  char			filename[1024];	// Custom media filename
+  lprint_drivers_t *index;		// Driver index
+  size_t	i,			// Looping var
+		bucket;			// Current bucket
+  pappl_len_t	j;			// Looping var
+  lprint_dmatch_t *match;		// Current match
+  cups_option_t	*pair;			// Current key/value pair
 
 
-  // Get the custom media...
-  if ((cmedia = (lprint_extdata_t *)data->extension) == NULL)
+  if ((index = (lprint_drivers_t *)calloc(1, sizeof(lprint_drivers_t))) == NULL)
+    return (NULL);
+
+  index->num_drivers = num_drivers;
+  index->drivers     = drivers;
+
+  // Build the driver name hash table, keeping it at most half full...
+  for (index->num_names = 16; index->num_names < 2 * num_drivers; index->num_names *= 2);
+
+  if ((index->names = (size_t *)calloc(index->num_names, sizeof(size_t))) == NULL)
+    goto error;
+
+  for (i = 0; i < num_drivers; i ++)
   {
-    // No custom media, delete any existing file...
-    papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "x");
-    return (true);
+    for (bucket = (size_t)hash_string(LPRINT_HASH_INIT, drivers[i].name, strlen(drivers[i].name)) & (index->num_names - 1); index->names[bucket]; bucket = (bucket + 1) & (index->num_names - 1));
+
+    index->names[bucket] = i + 1;
   }
 
-  // Save custom media sizes...
-  if ((fd = papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "w")) < 0)
-    return (true);
+  // Parse the device ID match strings...
+  if (num_drivers > 0 && ((index->matches = (lprint_dmatch_t *)calloc(num_drivers, sizeof(lprint_dmatch_t))) == NULL || (index->keys = (lprint_dkey_t *)calloc(num_drivers, sizeof(lprint_dkey_t))) == NULL))
+    goto error;
 
-  if ((fp = cupsFileOpenFd(fd, "w")) == NULL)
+  for (i = 0; i < num_drivers; i ++)
   {
-    close(fd);
-    return (true);
+    if (!drivers[i].device_id)
+      continue;
+
+    match = index->matches + index->num_matches;
+
+    if ((match->num_pairs = papplDeviceParseID(drivers[i].device_id, &match->pairs)) == 0)
+      continue;
+
+    match->driver = i;
+    index->num_matches ++;
+
+    // Use the first value without commas as the key, since partial matches
+    // cannot be found by looking up a comma-delimited value...
+    for (j = match->num_pairs, pair = match->pairs; j > 0; j --, pair ++)
+    {
+      if (!strchr(pair->value, ','))
+        break;
+    }
+
+    if (j > 0)
+    {
+      index->keys[index->num_keys].hash  = hash_string(hash_string(hash_string(LPRINT_HASH_INIT, pair->name, strlen(pair->name)), ":", 1), pair->value, strlen(pair->value));
+      index->keys[index->num_keys].match = index->num_matches - 1;
+      index->num_keys ++;
+      match->keyed = true;
+    }
   }
 
-  for (i = 0; i < data->num_source; i ++)
-    cupsFilePrintf(fp, "%s\n", cmedia->custom_name[i]);
+  // Sort the keys for binary searches...
+  if (index->num_keys > 1)
+    qsort(index->keys, index->num_keys, sizeof(lprint_dkey_t), (int (*)(const void *, const void *))compare_dkeys);
 
-  cupsFileClose(fp);
+  return (index);
 
-  return (true);
+  // If we get here there was an allocation error...
+  error:
+
+  lprintDriversDelete(index);
+
+  return (NULL);
 }
 
 
 //
-// 'lprintMediaUI()' - Show the printer media web page.
+// 'lprintGraphicsClear()' - Forget the graphics stored in a printer.
+//
+// Graphics that are in printer memory are not deleted, but their slots will
+// be overwritten as new graphics are stored.
 //
 
-bool					// O - `true` on success, `false` on failure
-lprintMediaUI(
-    pappl_client_t  *client,		// I - Client
+void
+lprintGraphicsClear(
     pappl_printer_t *printer)		// I - Printer
 {
-  int			i;		// Looping var
   pappl_pr_driver_data_t data;		// Driver data
-  lprint_extdata_t	*cmedia;	// Custom label sizes, if any
-  char			name[128],	// Form variable name
-			text[256];	// Localized text
-  const char		*status = NULL;	// Status message, if any
+  lprint_extdata_t	*extdata;	// Extension data
 
 
-  LPRINT_DEBUG("lprintMediaUI(client=%p, printer=%p(%s))\n", client, printer, printer ? papplPrinterGetName(printer) : "null");
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return;
+
+  pthread_mutex_lock(&lprint_graphics_mutex);
+  memset(extdata->graphics, 0, sizeof(extdata->graphics));
+  extdata->graphics_size = 0;
+  extdata->graphics_used = 0;
+  pthread_mutex_unlock(&lprint_graphics_mutex);
+}
 
-  // Only allow access as appropriate...
-  if (!papplClientHTMLAuthorize(client))
-    return (true);
 
-  // Get the driver data...
+//
+// 'lprintGraphicsEnabled()' - Are graphics stored in printer memory?
+//
+
+bool					// O - `true` if enabled, `false` if disabled
+lprintGraphicsEnabled(void)
+{
+  return (lprint_graphics_enabled);
+}
+
+
+//
+// 'lprintGraphicsFind()' - Find a graphic stored in a printer.
+//
+// Returns the slot number of the stored graphic, or `-1` if the graphic is not
+// stored in the printer.  In the latter case the `repeated` argument is set
+// to `true` if the same graphic was printed before, which makes it a good
+// candidate for @link lprintGraphicsStore@.
+//
+
+int					// O - Slot number or `-1` if not stored
+lprintGraphicsFind(
+    pappl_printer_t *printer,		// I - Printer
+    uint64_t        hash,		// I - Hash from @link lprintGraphicsHash@
+    bool            *repeated)		// O - `true` if graphic has been seen before
+{
+  int			i,		// Looping var
+			slot = -1,	// Slot number
+			oldest = -1;	// Oldest unstored slot
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+  lprint_graphic_t	*graphic;	// Current graphic
+
+
+  *repeated = false;
+
   papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return (-1);
 
-  LPRINT_DEBUG("lprintMediaUI: data.extension=%p\n", data.extension);
-  if (!data.extension)
-  {
-    lprintMediaLoad(printer, &data);
-    LPRINT_DEBUG("lprintMediaUI: AFTER data.extension=%p\n", data.extension);
-  }
-  cmedia = (lprint_extdata_t *)data.extension;
+  pthread_mutex_lock(&lprint_graphics_mutex);
 
-  if (papplClientGetMethod(client) == HTTP_STATE_POST)
+  for (i = 0, graphic = extdata->graphics; i < LPRINT_MAX_GRAPHICS; i ++, graphic ++)
   {
-    int			num_form = 0;	// Number of form variable
-    cups_option_t	*form = NULL;	// Form variables
-
-    if ((num_form = papplClientGetForm(client, &form)) == 0)
+    if (graphic->hash == hash)
     {
-      status = papplClientGetLocString(client, "Invalid form data.");
+      // Found it...
+      graphic->used = ++ extdata->graphics_used;
+
+      if (graphic->size > 0)
+        slot = i;
+      else
+        *repeated = true;
+      break;
     }
-    else if (!papplClientIsValidForm(client, num_form, form))
+    else if (graphic->size == 0 && (oldest < 0 || graphic->used < extdata->graphics[oldest].used))
     {
-      status = papplClientGetLocString(client, "Invalid form submission.");
+      oldest = i;
     }
-    else
-    {
-      // Collect new settings...
-      bool		changed = false;// Did the custom media list change?
-      pwg_media_t	*pwg = NULL;	// PWG media info
-      pappl_media_col_t	*ready;		// Current ready media
-      const char	*value,		// Value of form variable
-			*custom_width,	// Custom media width
-			*custom_length,	// Custom media length
-			*custom_units;	// Custom media units
+  }
 
-      // Ready media...
-      memset(data.media_ready, 0, sizeof(data.media_ready));
-      for (i = 0, ready = data.media_ready; i < data.num_source; i ++, ready ++)
-      {
-        // size
+  if (i >= LPRINT_MAX_GRAPHICS && oldest >= 0)
+  {
+    // Remember this graphic in place of the oldest unstored one...
+    graphic       = extdata->graphics + oldest;
+    graphic->hash = hash;
+    graphic->used = ++ extdata->graphics_used;
+  }
+
+  pthread_mutex_unlock(&lprint_graphics_mutex);
+
+  return (slot);
+}
+
+
+//
+// 'lprintGraphicsHash()' - Compute the hash of a bitmap.
+//
+// The hash (64-bit FNV-1a) includes the dimensions of the bitmap and is never
+// `0`.
+//
+
+uint64_t				// O - Hash value
+lprintGraphicsHash(
+    const unsigned char *bitmap,	// I - Bitmap
+    unsigned            width,		// I - Width in bytes
+    unsigned            height)		// I - Height in lines
+{
+  uint64_t	hash = 14695981039346656037ULL;
+					// Hash value
+  size_t	count = (size_t)width * height;
+					// Number of bytes
+
+
+  hash = (hash ^ width) * 1099511628211ULL;
+  hash = (hash ^ height) * 1099511628211ULL;
+
+  while (count > 0)
+  {
+    hash = (hash ^ *bitmap++) * 1099511628211ULL;
+    count --;
+  }
+
+  return (hash ? hash : 1);
+}
+
+
+//
+// 'lprintGraphicsSetEnabled()' - Enable or disable storing graphics in printer memory.
+//
+// Printers often store graphics in flash memory, which wears out after a
+// number of writes.
+//
+
+void
+lprintGraphicsSetEnabled(bool enabled)	// I - `true` to enable, `false` to disable
+{
+  lprint_graphics_enabled = enabled;
+}
+
+
+//
+// 'lprintGraphicsStore()' - Reserve a slot for storing a graphic in a printer.
+//
+// The least recently used graphics are deleted, using the callback function,
+// until the new graphic fits in `max_size` bytes of printer memory.  The
+// callback is called after the graphics lock is released since it writes to
+// the printer.  The caller then sends the graphic to the printer using the
+// returned slot number.
+//
+
+int					// O - Slot number or `-1` if the graphic is too large or storage is disabled
+lprintGraphicsStore(
+    pappl_printer_t      *printer,	// I - Printer
+    uint64_t             hash,		// I - Hash from @link lprintGraphicsHash@
+    size_t               size,		// I - Size in printer memory
+    size_t               max_size,	// I - Maximum size of all stored graphics
+    lprint_graphics_cb_t cb,		// I - Delete graphic callback
+    void                 *cbdata)	// I - Callback data
+{
+  int			i,		// Looping var
+			slot = -1,	// Slot for graphic
+			oldest,		// Oldest stored graphic
+			num_deleted = 0,
+					// Number of deleted graphics
+			deleted[LPRINT_MAX_GRAPHICS];
+					// Deleted graphics
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+  lprint_graphic_t	*graphic;	// Current graphic
+
+
+  if (!lprint_graphics_enabled || size == 0 || size > max_size)
+    return (-1);
+
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return (-1);
+
+  pthread_mutex_lock(&lprint_graphics_mutex);
+
+  // Use the slot for this graphic or the least recently used one...
+  for (i = 0, graphic = extdata->graphics; i < LPRINT_MAX_GRAPHICS; i ++, graphic ++)
+  {
+    if (graphic->hash == hash)
+    {
+      slot = i;
+      break;
+    }
+    else if (slot < 0 || graphic->used < extdata->graphics[slot].used)
+    {
+      slot = i;
+    }
+  }
+
+  graphic = extdata->graphics + slot;
+
+  if (graphic->size > 0)
+  {
+    deleted[num_deleted ++] = slot;
+    extdata->graphics_size -= graphic->size;
+    graphic->size = 0;
+  }
+
+  // Delete the least recently used graphics until there is enough room...
+  while ((extdata->graphics_size + size) > max_size)
+  {
+    for (i = 0, oldest = -1; i < LPRINT_MAX_GRAPHICS; i ++)
+    {
+      if (extdata->graphics[i].size > 0 && (oldest < 0 || extdata->graphics[i].used < extdata->graphics[oldest].used))
+        oldest = i;
+    }
+
+    if (oldest < 0)
+      break;
+
+    deleted[num_deleted ++] = oldest;
+    extdata->graphics_size -= extdata->graphics[oldest].size;
+    extdata->graphics[oldest].size = 0;
+  }
+
+  graphic->hash = hash;
+  graphic->size = size;
+  graphic->used = ++ extdata->graphics_used;
+
+  extdata->graphics_size += size;
+
+  pthread_mutex_unlock(&lprint_graphics_mutex);
+
+  // Delete the old graphics from printer memory...
+  for (i = 0; i < num_deleted; i ++)
+    (cb)(deleted[i], cbdata);
+
+  return (slot);
+}
+
+
+//
+// 'lprintMediaLoad()' - Load custom label sizes for a printer.
+//
+
+bool					// O - `true` on success, `false` on error
+lprintMediaLoad(
+    pappl_printer_t        *printer,	// I - Printer
+    pappl_pr_driver_data_t *data)	// I - Driver data
+{
+  lprint_extdata_t	*cmedia;	// Custom media
+  int			fd;		// Custom media file descriptor
+  cups_file_t		*fp;		// Custom media file
+  char			filename[1024],	// Custom media filename
+			line[256];	// Line from file
+  int			i;		// Looping var
+
+
+  // Allocate memory as needed...
+  if ((cmedia = (lprint_extdata_t *)data->extension) == NULL)
+  {
+    if ((cmedia = (lprint_extdata_t *)calloc(1, sizeof(lprint_extdata_t))) == NULL)
+      return (false);
+
+    data->extension = cmedia;
+    data->delete_cb = free_cmedia;
+
+    status_add_printer();
+  }
+
+  // Load any existing custom media sizes...
+  if ((fd = papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "r")) < 0)
+    return (true);
+
+  if ((fp = cupsFileOpenFd(fd, "r")) == NULL)
+  {
+    close(fd);
+    return (true);
+  }
+
+  for (i = 0; i < data->num_source && cupsFileGets(fp, line, sizeof(line)); i ++)
+    cupsCopyString(cmedia->custom_name[i], line, sizeof(cmedia->custom_name[i]));
+
+  cupsFileClose(fp);
+
+  return (true);
+}
+
+
+//
+// 'lprintMediaMatch()' - Match the loaded media to one of the supported sizes.
+//
+// The supported sizes are indexed by width and length whenever the media list
+// changes, so a match is a binary search rather than a scan of the media list.
+//
+
+const char *				// O - Matching media size or `NULL` if none
+lprintMediaMatch(
+    pappl_printer_t *printer,		// I - Printer
+    int             source,		// I - "media-source" index (0-based)
+    int             width,		// I - Width in hundredths of millimeters or `0` if unknown
+    int             length)		// I - Length in hundredths of millimeters
+{
+  pappl_pr_driver_data_t pdata;		// Printer driver data
+  lprint_extdata_t	*cmedia;	// Custom media info
+  pwg_media_t		*pwg;		// Current size info
+  const char		*ret = NULL;	// Return value
+
+
+  papplPrinterGetDriverData(printer, &pdata);
+
+  if (!pdata.extension)
+  {
+    // Load custom media info, which also holds the media size index...
+    lprintMediaLoad(printer, &pdata);
+    lprintMediaUpdate(printer, &pdata);
+    papplPrinterSetDriverData(printer, &pdata, NULL);
+  }
+
+  if ((cmedia = (lprint_extdata_t *)pdata.extension) == NULL)
+    return (NULL);
+
+  pthread_mutex_lock(&lprint_media_mutex);
+
+  // Re-index the media sizes if they have changed...
+  if (cmedia->media_count != pdata.num_media || memcmp(cmedia->media_names, pdata.media, (size_t)pdata.num_media * sizeof(pdata.media[0])))
+    media_index(cmedia, &pdata);
+
+  ret = media_find(cmedia, width, length);
+
+  pthread_mutex_unlock(&lprint_media_mutex);
+
+  if (!ret)
+  {
+    if (length == 0)
+      pwgFormatSizeName(cmedia->custom_name[source], sizeof(cmedia->custom_name[source]), "roll", pdata.source[source], width, length, /*units*/NULL);
+    else
+      pwgFormatSizeName(cmedia->custom_name[source], sizeof(cmedia->custom_name[source]), "custom", pdata.source[source], width, length, /*units*/NULL);
+
+    lprintMediaUpdate(printer, &pdata);
+    lprintMediaSave(printer, &pdata);
+
+    ret = cmedia->custom_name[source];
+  }
+
+  if (ret && strcmp(pdata.media_ready[source].size_name, ret) && (pwg = pwgMediaForPWG(ret)) != NULL)
+  {
+    // Ready media has changed...
+    cupsCopyString(pdata.media_ready[source].size_name, ret, sizeof(pdata.media_ready[source].size_name));
+    pdata.media_ready[source].size_width  = pwg->width;
+    pdata.media_ready[source].size_length = pwg->length;
+
+    if (pwg->length == 0)
+      cupsCopyString(pdata.media_ready[source].type, "continuous", sizeof(pdata.media_ready[source].type));
+    else
+      cupsCopyString(pdata.media_ready[source].type, "label", sizeof(pdata.media_ready[source].type));
+
+    papplPrinterSetDriverData(printer, &pdata, NULL);
+  }
+
+  return (ret);
+}
+
+
+//
+// 'lprintMediaSave()' - Save custom label sizes for a printer.
+//
+
+bool					// O - `true` on success, `false` on error
+lprintMediaSave(
+    pappl_printer_t        *printer,	// I - Printer
+    pappl_pr_driver_data_t *data)	// I - Driver data
+{
+  lprint_extdata_t	*cmedia;	// Custom media
+  int			i,		// Looping var
+			fd;		// Custom media file descriptor
+  cups_file_t		*fp;		// Custom media file
+  char			filename[1024];	// Custom media filename
+
+
+  // Get the custom media...
+  if ((cmedia = (lprint_extdata_t *)data->extension) == NULL)
+  {
+    // No custom media, delete any existing file...
+    papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "x");
+    return (true);
+  }
+
+  // Save custom media sizes...
+  if ((fd = papplPrinterOpenFile(printer, filename, sizeof(filename), /*directory*/NULL, "custom-media", "txt", "w")) < 0)
+    return (true);
+
+  if ((fp = cupsFileOpenFd(fd, "w")) == NULL)
+  {
+    close(fd);
+    return (true);
+  }
+
+  for (i = 0; i < data->num_source; i ++)
+    cupsFilePrintf(fp, "%s\n", cmedia->custom_name[i]);
+
+  cupsFileClose(fp);
+
+  return (true);
+}
+
+
+//
+// 'lprintMediaUI()' - Show the printer media web page.
+//
+
+bool					// O - `true` on success, `false` on failure
+lprintMediaUI(
+    pappl_client_t  *client,		// I - Client
+    pappl_printer_t *printer)		// I - Printer
+{
+  int			i;		// Looping var
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*cmedia;	// Custom label sizes, if any
+  char			name[128],	// Form variable name
+			text[256];	// Localized text
+  const char		*status = NULL;	// Status message, if any
+
+
+  LPRINT_DEBUG("lprintMediaUI(client=%p, printer=%p(%s))\n", client, printer, printer ? papplPrinterGetName(printer) : "null");
+
+  // Only allow access as appropriate...
+  if (!papplClientHTMLAuthorize(client))
+    return (true);
+
+  // Get the driver data...
+  papplPrinterGetDriverData(printer, &data);
+
+  LPRINT_DEBUG("lprintMediaUI: data.extension=%p\n", data.extension);
+  if (!data.extension)
+  {
+    lprintMediaLoad(printer, &data);
+    LPRINT_DEBUG("lprintMediaUI: AFTER data.extension=%p\n", data.extension);
+  }
+  cmedia = (lprint_extdata_t *)data.extension;
+
+  if (papplClientGetMethod(client) == HTTP_STATE_POST)
+  {
+    int			num_form = 0;	// Number of form variable
+    cups_option_t	*form = NULL;	// Form variables
+
+    if ((num_form = papplClientGetForm(client, &form)) == 0)
+    {
+      status = papplClientGetLocString(client, "Invalid form data.");
+    }
+    else if (!papplClientIsValidForm(client, num_form, form))
+    {
+      status = papplClientGetLocString(client, "Invalid form submission.");
+    }
+    else
+    {
+      // Collect new settings...
+      bool		changed = false;// Did the custom media list change?
+      pwg_media_t	*pwg = NULL;	// PWG media info
+      pappl_media_col_t	*ready;		// Current ready media
+      const char	*value,		// Value of form variable
+			*custom_width,	// Custom media width
+			*custom_length,	// Custom media length
+			*custom_units;	// Custom media units
+
+      // Ready media...
+      memset(data.media_ready, 0, sizeof(data.media_ready));
+      for (i = 0, ready = data.media_ready; i < data.num_source; i ++, ready ++)
+      {
+        // size
         snprintf(name, sizeof(name), "ready%d-size", i);
         if ((value = cupsGetOption(name, num_form, form)) == NULL)
           continue;
@@ -689,6 +1322,10 @@ lprintMediaUI(
           data.tear_offset_configured = offset;
       }
 
+      // Stored graphics...
+      if (cupsGetOption("clear-graphics", num_form, form))
+        lprintGraphicsClear(printer);
+
       // Save changes as needed...
       if (changed)
       {
@@ -762,6 +1399,28 @@ lprintMediaUI(
 			  "              <tr><th>%s</th><td><input type=\"number\" name=\"label-tear-offset-configured\" size=\"4\" value=\"%d\">mm</td></tr>\n", papplClientGetLocString(client, "Label Tear Offset:"), data.tear_offset_configured / 100);
   }
 
+  if (cmedia)
+  {
+    int		num_graphics = 0;	// Number of stored graphics
+    size_t	graphics_size;		// Size of stored graphics
+
+    pthread_mutex_lock(&lprint_graphics_mutex);
+    for (i = 0; i < LPRINT_MAX_GRAPHICS; i ++)
+    {
+      if (cmedia->graphics[i].size > 0)
+        num_graphics ++;
+    }
+    graphics_size = cmedia->graphics_size;
+    pthread_mutex_unlock(&lprint_graphics_mutex);
+
+    if (num_graphics > 0)
+    {
+      papplClientHTMLPrintf(client, "              <tr><th>%s</th><td><input type=\"checkbox\" name=\"clear-graphics\">", papplClientGetLocString(client, "Stored Graphics:"));
+      papplClientHTMLPrintf(client, papplClientGetLocString(client, "Clear %d graphics (%u KiB)"), num_graphics, (unsigned)((graphics_size + 1023) / 1024));
+      papplClientHTMLPuts(client, "</td></tr>\n");
+    }
+  }
+
   papplClientHTMLPrintf(client,
 			"              <tr><th></th><td><input type=\"submit\" value=\"%s\"></td></tr>\n"
 			"            </tbody>\n"
@@ -815,12 +1474,97 @@ lprintMediaUpdate(
 
   data->num_media = i;
 
+  // Index the media sizes for lprintMediaMatch...
+  if (cmedia)
+  {
+    pthread_mutex_lock(&lprint_media_mutex);
+    media_index(cmedia, data);
+    pthread_mutex_unlock(&lprint_media_mutex);
+  }
+
   LPRINT_DEBUG("lprintMediaUpdate: num_media=%d\n", data->num_media);
   for (i = 0; i < data->num_media; i ++)
     LPRINT_DEBUG("lprintMediaUpdate: media[%d]='%s'\n", i, data->media[i]);
 }
 
 
+//
+// 'lprintPCXEncode()' - Encode a 1-bit bitmap as a PCX file.
+//
+// The bitmap uses 1 bits for white and the image is encoded with 1 plane and a
+// white second palette entry.  Each line is run-length encoded: bytes 0xC1 to
+// 0xFF give a repeat count of 1 to 63 for the byte that follows and any other
+// byte value is copied as-is.
+//
+// Zero is returned if the PCX file does not fit in the destination buffer.
+//
+
+size_t					// O - Size of PCX file or `0` if it does not fit
+lprintPCXEncode(
+    unsigned char       *dst,		// I - Destination buffer
+    size_t              dstsize,	// I - Size of destination buffer
+    const unsigned char *bitmap,	// I - Bitmap
+    unsigned            width,		// I - Width in bytes
+    unsigned            height,		// I - Height in lines
+    unsigned            resolution)	// I - Resolution in DPI
+{
+  unsigned	y,			// Current line
+		x,			// Current byte in line
+		count,			// Repeat count
+		bpl = (width + 1) & ~1U;// Bytes per PCX line (always even)
+  unsigned char	byte,			// Current byte
+		*dstptr,		// Pointer into destination
+		*dstend;		// End of destination
+
+
+  if (dstsize < LPRINT_PCX_HEADER || width == 0 || height == 0)
+    return (0);
+
+  // Build the header...
+  memset(dst, 0, LPRINT_PCX_HEADER);
+
+  dst[0]  = 10;				// Manufacturer = ZSoft
+  dst[1]  = 5;				// Version 3.0
+  dst[2]  = 1;				// Run-length encoding
+  dst[3]  = 1;				// Bits per pixel
+  dst[8]  = (unsigned char)(8 * width - 1);
+  dst[9]  = (unsigned char)((8 * width - 1) >> 8);
+  dst[10] = (unsigned char)(height - 1);
+  dst[11] = (unsigned char)((height - 1) >> 8);
+  dst[12] = dst[14] = (unsigned char)resolution;
+  dst[13] = dst[15] = (unsigned char)(resolution >> 8);
+  dst[19] = dst[20] = dst[21] = 255;	// Palette entry 1 = white
+  dst[65] = 1;				// Number of planes
+  dst[66] = (unsigned char)bpl;
+  dst[67] = (unsigned char)(bpl >> 8);
+  dst[68] = 1;				// Monochrome palette
+
+  dstptr = dst + LPRINT_PCX_HEADER;
+  dstend = dst + dstsize;
+
+  // Encode each line, padding odd widths with white...
+  for (y = 0; y < height; y ++, bitmap += width)
+  {
+    for (x = 0; x < bpl; x += count)
+    {
+      byte = x < width ? bitmap[x] : 0xff;
+
+      for (count = 1; count < 63 && (x + count) < bpl && ((x + count) < width ? bitmap[x + count] : 0xff) == byte; count ++);
+
+      if ((dstend - dstptr) < 2)
+        return (0);
+
+      if (count > 1 || byte >= 0xc0)
+        *dstptr++ = (unsigned char)(0xc0 | count);
+
+      *dstptr++ = byte;
+    }
+  }
+
+  return ((size_t)(dstptr - dst));
+}
+
+
 //
 // 'lprintPackBitsAlloc()' - Allocate a PackBits compression buffer.
 //
@@ -872,8 +1616,7 @@ lprintPackBitsCompress(
     while (srcptr <= srcend)
     {
       // Extend literal sequence, if any...
-      while (srcptr < srcend && srcptr[0] != srcptr[1])
-	srcptr ++;
+      srcptr = packbits_literal_end(srcptr, srcend);
 
       srclcount = srcptr - srclptr;
       srcrcount = 0;
@@ -887,16 +1630,9 @@ lprintPackBitsCompress(
       }
 
       // Count a run...
-      srcrptr = srcptr;
-
-      while (srcptr < srcend && srcptr[0] == srcptr[1])
-      {
-	srcptr ++;
-	srcrcount ++;
-      }
-
-      srcptr ++;
-      srcrcount ++;
+      srcrptr   = srcptr;
+      srcptr    = packbits_run_end(srcptr, srcend) + 1;
+      srcrcount = (unsigned)(srcptr - srcrptr);
 
       // Only stop to encode if the repeated sequence is long enough to make sense...
       if (srcrcount > 2 || srcrptr == srclptr)
@@ -939,6 +1675,298 @@ lprintPackBitsCompress(
 }
 
 
+//
+// 'lprintSessionBegin()' - Make a job the owner of the printer's device connection.
+//
+// While a job owns the connection, status requests are queued with
+// @link lprintSessionQueueStatus@ and answered by the job between bands or
+// labels instead of opening a second connection to the printer.
+//
+// Returns `false` when the job continues the session of the previous job on a
+// "socket" or "usb" printer, that is, the previous job ended cleanly within
+// the session timeout.  Drivers can then check the printer's health and skip
+// their reset prologue.
+//
+
+bool					// O - `true` for a new session, `false` to continue the current one
+lprintSessionBegin(
+    pappl_job_t    *job,		// I - Job
+    pappl_device_t *device)		// I - Output device
+{
+  pappl_printer_t	*printer = papplJobGetPrinter(job);
+					// Printer
+  const char		*uri = papplPrinterGetDeviceURI(printer);
+					// Device URI
+  bool			new_session = true;
+					// New session?
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+
+
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return (true);
+
+  pthread_mutex_lock(&lprint_session_mutex);
+
+  if (lprint_session_timeout > 0 && uri && (!strncmp(uri, "socket://", 9) || !strncmp(uri, "usb://", 6)) && extdata->session_clean && (time(NULL) - extdata->session_used) <= lprint_session_timeout)
+    new_session = false;
+
+  extdata->session_job    = job;
+  extdata->session_device = device;
+  extdata->session_clean  = false;
+  extdata->status_queued  = false;
+
+  pthread_mutex_unlock(&lprint_session_mutex);
+
+  if (!new_session)
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Continuing device session.");
+
+  return (new_session);
+}
+
+
+//
+// 'lprintSessionEnd()' - Release the printer's device connection from a job.
+//
+
+void
+lprintSessionEnd(pappl_job_t *job)	// I - Job
+{
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+
+
+  papplPrinterGetDriverData(papplJobGetPrinter(job), &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return;
+
+  pthread_mutex_lock(&lprint_session_mutex);
+  if (extdata->session_job == job)
+  {
+    extdata->session_job    = NULL;
+    extdata->session_device = NULL;
+    extdata->session_used   = time(NULL);
+    extdata->session_clean  = !papplJobIsCanceled(job) && !(papplPrinterGetReasons(papplJobGetPrinter(job)) & (PAPPL_PREASON_OTHER | PAPPL_PREASON_COVER_OPEN | PAPPL_PREASON_MEDIA_EMPTY | PAPPL_PREASON_MEDIA_JAM));
+
+    if (extdata->status_queued)
+    {
+      // Let the next poll get the status right away...
+      extdata->status_queued = false;
+      extdata->status_time   = 0;
+
+      pthread_mutex_lock(&lprint_status_mutex);
+      extdata->status_next = 0;
+      pthread_mutex_unlock(&lprint_status_mutex);
+    }
+  }
+  pthread_mutex_unlock(&lprint_session_mutex);
+}
+
+
+//
+// 'lprintSessionQueueStatus()' - Queue a status request on the current job's connection.
+//
+// Returns `true` if a job is using the printer, in which case the status
+// callback should return without opening the device.  The request is answered
+// by the job if it owns the connection and otherwise by the next poll.
+//
+// The status poll scheduler calls this directly for printers that are
+// processing a job, since PAPPL does not call the status callback while the
+// device is in use.
+//
+
+bool					// O - `true` if queued, `false` if the device is available
+lprintSessionQueueStatus(
+    pappl_printer_t *printer)		// I - Printer
+{
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+
+
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return (false);
+
+  pthread_mutex_lock(&lprint_session_mutex);
+  if (extdata->session_job && papplPrinterGetState(printer) != IPP_PSTATE_IDLE)
+  {
+    // Don't compete with the job for the device, just ask it for status...
+    extdata->status_queued = true;
+    ret                    = true;
+  }
+  else if (papplPrinterGetState(printer) == IPP_PSTATE_PROCESSING)
+  {
+    // Job doesn't own the connection, try again with the next poll...
+    ret = true;
+  }
+  else if (extdata->session_job)
+  {
+    // Job went away without releasing the connection...
+    extdata->session_job    = NULL;
+    extdata->session_device = NULL;
+    extdata->status_queued  = false;
+  }
+  pthread_mutex_unlock(&lprint_session_mutex);
+
+  return (ret);
+}
+
+
+//
+// 'lprintSessionReset()' - Start a new device session with the next job.
+//
+// Drivers call this after sending data that leaves the printer in an unknown
+// state, such as raw print files.
+//
+
+void
+lprintSessionReset(
+    pappl_printer_t *printer)		// I - Printer
+{
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+
+
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return;
+
+  pthread_mutex_lock(&lprint_session_mutex);
+  extdata->session_clean = false;
+  pthread_mutex_unlock(&lprint_session_mutex);
+}
+
+
+//
+// 'lprintSessionSetTimeout()' - Set the idle timeout for device sessions.
+//
+// A timeout of `0` seconds disables reuse of device sessions.
+//
+
+void
+lprintSessionSetTimeout(int timeout)	// I - Timeout in seconds
+{
+  pthread_mutex_lock(&lprint_session_mutex);
+  lprint_session_timeout = timeout;
+  pthread_mutex_unlock(&lprint_session_mutex);
+}
+
+
+//
+// 'lprintSessionStatusQueued()' - Check for and clear a queued status request.
+//
+// Drivers call this at points where a status query can be inserted into the
+// job's data stream and update the printer state reasons when it returns
+// `true`.
+//
+
+bool					// O - `true` if status was requested
+lprintSessionStatusQueued(
+    pappl_job_t *job)			// I - Job
+{
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Extension data
+
+
+  papplPrinterGetDriverData(papplJobGetPrinter(job), &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL)
+    return (false);
+
+  pthread_mutex_lock(&lprint_session_mutex);
+  if (extdata->session_job == job && extdata->status_queued)
+  {
+    extdata->status_queued = false;
+    ret                    = true;
+  }
+  pthread_mutex_unlock(&lprint_session_mutex);
+
+  return (ret);
+}
+
+
+//
+// 'lprintStatusStart()' - Start the shared status poll scheduler.
+//
+// A single thread schedules a status poll of each Brother, DYMO, EPL2, SII,
+// and TSPL printer, every `LPRINT_STATUS_ACTIVE` seconds while jobs are
+// queued and every `LPRINT_STATUS_IDLE` seconds otherwise.  The polls run on a
+// pool of `LPRINT_STATUS_WORKERS` threads, one at a time per printer, so a
+// printer that is slow to answer only ties up one thread.  Printers that are
+// processing a job get their status from the job instead, using
+// @link lprintSessionQueueStatus@.
+//
+// The threads run while the system has printers.  Deleting a printer waits for
+// its status poll to finish, and deleting the last printer (which also happens
+// when the system is deleted) stops and joins the threads.
+//
+
+void
+lprintStatusStart(
+    pappl_system_t *system)		// I - System
+{
+  pthread_mutex_lock(&lprint_status_mutex);
+  lprint_status_system = system;
+  status_start();
+  pthread_mutex_unlock(&lprint_status_mutex);
+}
+
+
+//
+// 'compare_dkeys()' - Compare two driver index keys.
+//
+
+static int				// O - Result of comparison
+compare_dkeys(lprint_dkey_t *a,		// I - First key
+              lprint_dkey_t *b)		// I - Second key
+{
+  if (a->hash < b->hash)
+    return (-1);
+  else if (a->hash > b->hash)
+    return (1);
+  else if (a->match < b->match)
+    return (-1);
+  else if (a->match > b->match)
+    return (1);
+  else
+    return (0);
+}
+
+
+//
+// 'compare_length()' - Compare two media sizes by length.
+//
+
+static int				// O - Result of comparison
+compare_length(lprint_msize_t *a,	// I - First media size
+               lprint_msize_t *b)	// I - Second media size
+{
+  if (a->length != b->length)
+    return (a->length - b->length);
+  else
+    return (a->order - b->order);
+}
+
+
+//
+// 'compare_width()' - Compare two media sizes by width and length.
+//
+
+static int				// O - Result of comparison
+compare_width(lprint_msize_t *a,	// I - First media size
+              lprint_msize_t *b)	// I - Second media size
+{
+  if (a->width != b->width)
+    return (a->width - b->width);
+  else if (a->length != b->length)
+    return (a->length - b->length);
+  else
+    return (a->order - b->order);
+}
+
+
 //
 // 'free_cmedia()' - Free custom media information.
 //
@@ -948,10 +1976,33 @@ free_cmedia(
     pappl_printer_t        *printer,	// I - Printer (unused)
     pappl_pr_driver_data_t *data)	// I - Driver data
 {
+  if (data->extension)
+    status_remove_printer((lprint_extdata_t *)data->extension);
+
   free(data->extension);
 }
 
 
+//
+// 'hash_string()' - Add a string to a case-insensitive 64-bit FNV-1a hash.
+//
+
+static uint64_t				// O - New hash value
+hash_string(uint64_t   hash,		// I - Current hash value
+            const char *s,		// I - String
+            size_t     len)		// I - Length of string
+{
+  while (len > 0)
+  {
+    hash = (hash ^ (unsigned char)tolower(*s & 255)) * 1099511628211ULL;
+    s ++;
+    len --;
+  }
+
+  return (hash);
+}
+
+
 //
 // 'localize_keyword()' - Localize an attribute keyword value.
 //
@@ -990,28 +2041,118 @@ localize_keyword(
     }
     else
     {
-      snprintf(buffer, bufsize, "Invalid '%s'", keyword);
+      snprintf(buffer, bufsize, "Invalid '%s'", keyword);
+    }
+  }
+  else
+  {
+    // Convert "separated-words" to "Separated Words"...
+    char	*ptr;			// Pointer into string
+
+    cupsCopyString(buffer, keyword, bufsize);
+    *buffer = (char)toupper(*buffer & 255);
+
+    for (ptr = buffer + 1; *ptr; ptr ++)
+    {
+      if (*ptr == '-' && ptr[1])
+      {
+	*ptr++ = ' ';
+	*ptr   = (char)toupper(*ptr & 255);
+      }
+    }
+  }
+
+  return (buffer);
+}
+
+
+//
+// 'match_driver()' - Score a driver's device ID match string.
+//
+// The score is 2 for each exact match and 1 for a partial match in a comma-
+// delimited field.  Any non-match results in a score of 0.
+//
+
+static void
+match_driver(
+    lprint_dmatch_t *match,		// I  - Parsed match string
+    pappl_len_t     num_did,		// I  - Number of device ID key/value pairs
+    cups_option_t   *did,		// I  - Device ID key/value pairs
+    lprint_dmatch_t **best,		// IO - Best match
+    int             *best_score)	// IO - Best score
+{
+  pappl_len_t	i;			// Looping var
+  int		score = 0;		// Score
+  cups_option_t	*current;		// Current key/value pair
+  const char	*value,			// Device ID value
+		*valptr;		// Pointer into value
+  size_t	mlen;			// Length of match value
+
+
+  // Loop through the match pairs to find matches (or not)
+  for (i = match->num_pairs, current = match->pairs; i > 0; i --, current ++)
+  {
+    if ((value = cupsGetOption(current->name, (cups_len_t)num_did, did)) == NULL)
+      return;				// No match
+
+    if (!strcasecmp(current->value, value))
+    {
+      // Full match!
+      score += 2;
+    }
+    else if ((valptr = strstr(value, current->value)) != NULL && (valptr == value || valptr[-1] == ',') && (!valptr[mlen = strlen(current->value)] || valptr[mlen] == ','))
+    {
+      // Partial match!
+      score ++;
+    }
+    else
+    {
+      // No match
+      return;
     }
   }
-  else
+
+  // Earlier drivers win ties...
+  if (score > *best_score || (score == *best_score && score > 0 && match->driver < (*best)->driver))
   {
-    // Convert "separated-words" to "Separated Words"...
-    char	*ptr;			// Pointer into string
+    *best       = match;
+    *best_score = score;
+  }
+}
 
-    cupsCopyString(buffer, keyword, bufsize);
-    *buffer = (char)toupper(*buffer & 255);
 
-    for (ptr = buffer + 1; *ptr; ptr ++)
-    {
-      if (*ptr == '-' && ptr[1])
-      {
-	*ptr++ = ' ';
-	*ptr   = (char)toupper(*ptr & 255);
-      }
-    }
+//
+// 'match_key()' - Score the drivers for a driver index key.
+//
+
+static void
+match_key(
+    lprint_drivers_t *index,		// I  - Driver index
+    uint64_t         hash,		// I  - Hash of "KEY:value"
+    pappl_len_t      num_did,		// I  - Number of device ID key/value pairs
+    cups_option_t    *did,		// I  - Device ID key/value pairs
+    lprint_dmatch_t  **best,		// IO - Best match
+    int              *best_score)	// IO - Best score
+{
+  size_t	left = 0,		// Left side of search
+		right = index->num_keys,// Right side of search
+		current;		// Current key
+
+
+  // Find the first key with this hash...
+  while (left < right)
+  {
+    current = (left + right) / 2;
+
+    if (index->keys[current].hash < hash)
+      left = current + 1;
+    else
+      right = current;
   }
 
-  return (buffer);
+  // Then score every driver with this key...
+  for (current = left; current < index->num_keys && index->keys[current].hash == hash; current ++)
+    match_driver(index->matches + index->keys[current].match, num_did, did, best, best_score);
 }
 
 
@@ -1163,3 +2304,492 @@ media_chooser(
   }
   papplClientHTMLPrintf(client, "</select></td></tr>\n");
 }
+
+
+//
+// 'media_find()' - Find a media size in the index.
+//
+// The width and length must match within 1mm.  The last matching custom or
+// roll size is preferred, otherwise the first matching size in the media list
+// is used.
+//
+
+static const char *			// O - Media size name or `NULL` if none
+media_find(lprint_extdata_t *cmedia,	// I - Custom media info
+           int              width,	// I - Width in hundredths of millimeters or `0` if unknown
+           int              length)	// I - Length in hundredths of millimeters or `0` if unknown
+{
+  lprint_msize_t	*sizes,		// Sizes to search
+			*size,		// Current size
+			*end,		// End of sizes
+			*best = NULL;	// Best size
+  int			key,		// Sort key to search for
+			left,		// Left side of search
+			right,		// Right side of search
+			current;	// Current size
+
+
+  // Search by width when known, otherwise by length...
+  if (width)
+  {
+    sizes = cmedia->sizes_width;
+    key   = width - 100;
+  }
+  else
+  {
+    sizes = cmedia->sizes_length;
+    key   = length - 100;
+  }
+
+  // Find the first size within 1mm, or the first size if neither dimension
+  // is known...
+  for (left = 0, right = cmedia->num_sizes; left < right;)
+  {
+    current = (left + right) / 2;
+
+    if ((width ? sizes[current].width : sizes[current].length) < key)
+      left = current + 1;
+    else
+      right = current;
+  }
+
+  if (!width && !length)
+    left = 0;
+
+  // Then check each size until it is more than 1mm larger...
+  for (size = sizes + left, end = sizes + cmedia->num_sizes; size < end; size ++)
+  {
+    if (width && size->width > width + 100)
+      break;
+    else if (!width && length && size->length > length + 100)
+      break;
+
+    if ((abs(size->width - width) <= 100 || !width) && (abs(size->length - length) <= 100 || !length))
+    {
+      if (!best || (size->custom && (!best->custom || size->order > best->order)) || (!size->custom && !best->custom && size->order < best->order))
+        best = size;
+    }
+  }
+
+  return (best ? best->name : NULL);
+}
+
+
+//
+// 'media_index()' - Index the supported media sizes.
+//
+
+static void
+media_index(lprint_extdata_t       *cmedia,	// I - Custom media info
+            pappl_pr_driver_data_t *data)	// I - Driver data
+{
+  int		i;			// Looping var
+  pwg_media_t	*pwg;			// Current size info
+  lprint_msize_t *size;			// Current indexed size
+
+
+  // Remember the media list for this index...
+  cmedia->media_count = data->num_media;
+  memcpy(cmedia->media_names, data->media, (size_t)data->num_media * sizeof(data->media[0]));
+
+  // Parse the sizes, skipping custom size ranges...
+  for (i = 0, size = cmedia->sizes_width, cmedia->num_sizes = 0; i < data->num_media; i ++)
+  {
+    if ((!strncmp(data->media[i], "custom_", 7) || !strncmp(data->media[i], "roll_", 5)) && (strstr(data->media[i], "_min_") != NULL || strstr(data->media[i], "_max_") != NULL))
+      continue;
+
+    if ((pwg = pwgMediaForPWG(data->media[i])) == NULL)
+      continue;
+
+    size->width  = pwg->width;
+    size->length = pwg->length;
+    size->order  = i;
+    size->custom = !strncmp(data->media[i], "custom_", 7) || !strncmp(data->media[i], "roll_", 5);
+    size->name   = data->media[i];
+
+    size ++;
+    cmedia->num_sizes ++;
+  }
+
+  // Sort by width and by length...
+  memcpy(cmedia->sizes_length, cmedia->sizes_width, (size_t)cmedia->num_sizes * sizeof(lprint_msize_t));
+
+  qsort(cmedia->sizes_width, (size_t)cmedia->num_sizes, sizeof(lprint_msize_t), (int (*)(const void *, const void *))compare_width);
+  qsort(cmedia->sizes_length, (size_t)cmedia->num_sizes, sizeof(lprint_msize_t), (int (*)(const void *, const void *))compare_length);
+}
+
+
+//
+// 'packbits_literal_end()' - Find the end of a literal sequence.
+//
+// Returns the first pointer in the range `[ptr,end)` whose byte is the same
+// as the following byte, or `end` if there is none.  `end` points to the last
+// byte of the buffer.  Vector compares of each byte with its neighbor are used
+// to skip 16 bytes at a time when available.
+//
+
+static const unsigned char *		// O - End of literal sequence
+packbits_literal_end(
+    const unsigned char *ptr,		// I - Start of sequence
+    const unsigned char *end)		// I - Last byte in buffer
+{
+#ifdef __SSE2__
+  unsigned	mask;			// Mask of equal neighbors
+
+
+  while ((end - ptr) >= 16)
+  {
+    mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ptr), _mm_loadu_si128((const __m128i *)(ptr + 1))));
+    if (mask)
+      return (ptr + __builtin_ctz(mask));
+
+    ptr += 16;
+  }
+
+#elif defined(__ARM_NEON)
+  uint64_t	mask;			// Mask of equal neighbors (4 bits per byte)
+
+
+  while ((end - ptr) >= 16)
+  {
+    mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(vld1q_u8(ptr), vld1q_u8(ptr + 1))), 4)), 0);
+    if (mask)
+      return (ptr + __builtin_ctzll(mask) / 4);
+
+    ptr += 16;
+  }
+#endif // __SSE2__
+
+  while (ptr < end && ptr[0] != ptr[1])
+    ptr ++;
+
+  return (ptr);
+}
+
+
+//
+// 'packbits_run_end()' - Find the end of a repeated sequence.
+//
+// Returns the first pointer in the range `[ptr,end)` whose byte differs from
+// the following byte, or `end` if there is none.
+//
+
+static const unsigned char *		// O - Last byte of repeated sequence
+packbits_run_end(
+    const unsigned char *ptr,		// I - Start of sequence
+    const unsigned char *end)		// I - Last byte in buffer
+{
+#ifdef __SSE2__
+  unsigned	mask;			// Mask of different neighbors
+
+
+  while ((end - ptr) >= 16)
+  {
+    mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)ptr), _mm_loadu_si128((const __m128i *)(ptr + 1)))) ^ 0xffff;
+    if (mask)
+      return (ptr + __builtin_ctz(mask));
+
+    ptr += 16;
+  }
+
+#elif defined(__ARM_NEON)
+  uint64_t	mask;			// Mask of different neighbors (4 bits per byte)
+
+
+  while ((end - ptr) >= 16)
+  {
+    mask = ~vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(vceqq_u8(vld1q_u8(ptr), vld1q_u8(ptr + 1))), 4)), 0);
+    if (mask)
+      return (ptr + __builtin_ctzll(mask) / 4);
+
+    ptr += 16;
+  }
+#endif // __SSE2__
+
+  while (ptr < end && ptr[0] == ptr[1])
+    ptr ++;
+
+  return (ptr);
+}
+
+
+//
+// 'status_add_printer()' - Add a printer to the status poll scheduler.
+//
+
+static void
+status_add_printer(void)
+{
+  pthread_mutex_lock(&lprint_status_mutex);
+  lprint_status_count ++;
+  status_start();
+  pthread_mutex_unlock(&lprint_status_mutex);
+}
+
+
+//
+// 'status_poll()' - Poll the status of queued printers.
+//
+
+static void *				// O - Thread exit status
+status_poll(void *data)			// I - System (unused)
+{
+  pappl_printer_t	*printer;	// Current printer
+  pappl_pr_driver_data_t pdata;		// Printer driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+  bool			disabled;	// Has the printer been deleted?
+
+
+  (void)data;
+
+  pthread_mutex_lock(&lprint_status_mutex);
+
+  while (!lprint_status_stop)
+  {
+    if (lprint_status_num == 0)
+    {
+      pthread_cond_wait(&lprint_status_cond, &lprint_status_mutex);
+      continue;
+    }
+
+    // Take the next printer from the queue...
+    printer = lprint_status_queue[0];
+
+    lprint_status_num --;
+    memmove(lprint_status_queue, lprint_status_queue + 1, lprint_status_num * sizeof(pappl_printer_t *));
+
+    pthread_mutex_unlock(&lprint_status_mutex);
+
+    // The "status_busy" flag keeps the printer from being freed until the poll
+    // is done...
+    papplPrinterGetDriverData(printer, &pdata);
+    extdata = (lprint_extdata_t *)pdata.extension;
+
+    pthread_mutex_lock(&lprint_status_mutex);
+    disabled = extdata->status_disabled;
+    pthread_mutex_unlock(&lprint_status_mutex);
+
+    if (!disabled)
+      (pdata.status_cb)(printer);
+
+    pthread_mutex_lock(&lprint_status_mutex);
+    extdata->status_busy = false;
+    pthread_cond_broadcast(&lprint_status_cond);
+  }
+
+  pthread_mutex_unlock(&lprint_status_mutex);
+
+  return (NULL);
+}
+
+
+//
+// 'status_printer_cb()' - Queue a status poll for a printer if it is due.
+//
+// This is called with the system lock held, so it must not block.  Printers
+// are queued with "status_busy" set, so they cannot be freed until the poll is
+// done.
+//
+
+static void
+status_printer_cb(
+    pappl_printer_t *printer,		// I - Printer
+    void            *data)		// I - Unused
+{
+  pappl_pr_driver_data_t pdata;		// Printer driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+  const char		*driver_name;	// Driver name
+  size_t		i;		// Looping var
+  time_t		curtime;	// Current time
+  int			interval;	// Poll interval
+  bool			processing;	// Is the printer processing a job?
+  pappl_printer_t	**queue;	// New status queue
+
+
+  (void)data;
+
+  papplPrinterGetDriverData(printer, &pdata);
+
+  if (!pdata.status_cb || (extdata = (lprint_extdata_t *)pdata.extension) == NULL)
+    return;
+
+  // Only poll the drivers that need it, ZPL printers send alerts and ESC/POS
+  // printers report status with each job...
+  driver_name = papplPrinterGetDriverName(printer);
+
+  for (i = 0; i < (sizeof(lprint_status_drivers) / sizeof(lprint_status_drivers[0])); i ++)
+  {
+    if (!strncmp(driver_name, lprint_status_drivers[i], strlen(lprint_status_drivers[i])))
+      break;
+  }
+
+  if (i >= (sizeof(lprint_status_drivers) / sizeof(lprint_status_drivers[0])))
+    return;
+
+  curtime    = time(NULL);
+  interval   = papplPrinterGetNumberOfActiveJobs(printer) > 0 ? LPRINT_STATUS_ACTIVE : LPRINT_STATUS_IDLE;
+  processing = papplPrinterGetState(printer) == IPP_PSTATE_PROCESSING;
+
+  pthread_mutex_lock(&lprint_status_mutex);
+
+  if (extdata->status_disabled || extdata->status_busy || curtime < extdata->status_next)
+  {
+    pthread_mutex_unlock(&lprint_status_mutex);
+    return;
+  }
+
+  extdata->status_next = curtime + interval;
+
+  if (processing)
+  {
+    // Ask the job for status between labels...
+    pthread_mutex_unlock(&lprint_status_mutex);
+    lprintSessionQueueStatus(printer);
+    return;
+  }
+
+  // Queue the printer for one of the poll threads...
+  if (lprint_status_num >= lprint_status_alloc)
+  {
+    if ((queue = realloc(lprint_status_queue, (lprint_status_alloc + 16) * sizeof(pappl_printer_t *))) == NULL)
+    {
+      pthread_mutex_unlock(&lprint_status_mutex);
+      return;
+    }
+
+    lprint_status_queue = queue;
+    lprint_status_alloc += 16;
+  }
+
+  extdata->status_busy = true;
+  lprint_status_queue[lprint_status_num ++] = printer;
+
+  pthread_cond_broadcast(&lprint_status_cond);
+  pthread_mutex_unlock(&lprint_status_mutex);
+}
+
+
+//
+// 'status_remove_printer()' - Remove a printer from the status poll scheduler.
+//
+// This waits for any status poll of the printer to finish, and stops the
+// scheduler and poll threads when the last printer is removed.
+//
+
+static void
+status_remove_printer(
+    lprint_extdata_t *extdata)		// I - Driver extension data
+{
+  pthread_t	threads[LPRINT_STATUS_WORKERS + 1];
+					// Threads to join
+  size_t	i,			// Looping var
+		num_threads = 0;	// Number of threads to join
+
+
+  pthread_mutex_lock(&lprint_status_mutex);
+
+  // Skip any queued poll and wait for a running one to finish...
+  extdata->status_disabled = true;
+
+  while (extdata->status_busy)
+    pthread_cond_wait(&lprint_status_cond, &lprint_status_mutex);
+
+  if (lprint_status_count > 0)
+    lprint_status_count --;
+
+  if (lprint_status_count == 0 && lprint_status_running && !lprint_status_stop)
+  {
+    lprint_status_stop = true;
+    num_threads        = lprint_status_num_threads;
+    memcpy(threads, lprint_status_threads, sizeof(threads));
+
+    pthread_cond_broadcast(&lprint_status_cond);
+  }
+
+  pthread_mutex_unlock(&lprint_status_mutex);
+
+  if (num_threads == 0)
+    return;
+
+  for (i = 0; i < num_threads; i ++)
+    pthread_join(threads[i], NULL);
+
+  pthread_mutex_lock(&lprint_status_mutex);
+
+  lprint_status_running = false;
+  lprint_status_stop    = false;
+
+  // Restart if a printer was added while stopping...
+  status_start();
+
+  pthread_mutex_unlock(&lprint_status_mutex);
+}
+
+
+//
+// 'status_run()' - Run the status poll scheduler.
+//
+
+static void *				// O - Thread exit status
+status_run(void *data)			// I - System
+{
+  pappl_system_t	*system = (pappl_system_t *)data;
+					// System
+  struct timespec	timeout;	// Time to wait for the next check
+
+
+  pthread_mutex_lock(&lprint_status_mutex);
+
+  // Check each printer once a second until stopped...
+  while (!lprint_status_stop)
+  {
+    pthread_mutex_unlock(&lprint_status_mutex);
+
+    if (papplSystemIsRunning(system))
+      papplSystemIteratePrinters(system, status_printer_cb, NULL);
+
+    pthread_mutex_lock(&lprint_status_mutex);
+
+    if (!lprint_status_stop)
+    {
+      timeout.tv_sec  = time(NULL) + 1;
+      timeout.tv_nsec = 0;
+
+      pthread_cond_timedwait(&lprint_status_cond, &lprint_status_mutex, &timeout);
+    }
+  }
+
+  pthread_mutex_unlock(&lprint_status_mutex);
+
+  return (NULL);
+}
+
+
+//
+// 'status_start()' - Start the status scheduler and poll threads.
+//
+// The threads are started once the system is set and it has printers.  This
+// must be called with the status mutex held.
+//
+
+static void
+status_start(void)
+{
+  int	error;				// Thread creation error
+
+
+  if (!lprint_status_system || lprint_status_count == 0 || lprint_status_running || lprint_status_stop)
+    return;
+
+  for (lprint_status_num_threads = 0; lprint_status_num_threads <= LPRINT_STATUS_WORKERS; lprint_status_num_threads ++)
+  {
+    // The first thread is the scheduler, the rest poll printers...
+    if ((error = pthread_create(lprint_status_threads + lprint_status_num_threads, NULL, lprint_status_num_threads ? status_poll : status_run, lprint_status_system)) != 0)
+    {
+      papplLog(lprint_status_system, PAPPL_LOGLEVEL_ERROR, "Unable to create status thread: %s", strerror(error));
+      break;
+    }
+  }
+
+  lprint_status_running = lprint_status_num_threads > 0;
+}
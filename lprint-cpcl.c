@@ -11,6 +11,13 @@
 #ifdef LPRINT_EXPERIMENTAL
 
 
+//
+// Constants...
+//
+
+#define LPRINT_CPCL_MAX_BLOCK	32768	// Maximum size of a CG block in bytes
+
+
 //
 // Local types...
 //
@@ -18,6 +25,12 @@
 typedef struct lprint_cpcl_s		// CPCL driver data
 {
   lprint_dither_t dither;		// Dither buffer
+  unsigned char	*block;			// Graphics block buffer
+  unsigned	block_y,		// First line in block
+		block_lines,		// Number of lines in block
+		block_max,		// Maximum number of lines in block
+		block_left,		// Left-most inked byte in block
+		block_right;		// Right-most inked byte in block
 } lprint_cpcl_t;
 
 
@@ -98,6 +111,7 @@ static const char * const lprint_hma300e_media[] =
 // Local functions...
 //
 
+static bool	lprint_cpcl_flush(pappl_device_t *device, lprint_cpcl_t *cpcl);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_cpcl_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
 #else
@@ -200,6 +214,47 @@ lprintCPCL(
 }
 
 
+//
+// 'lprint_cpcl_flush()' - Send the current graphics block.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_cpcl_flush(
+    pappl_device_t *device,		// I - Output device
+    lprint_cpcl_t  *cpcl)		// I - CPCL driver data
+{
+  unsigned	i,			// Looping var
+		lines = cpcl->block_lines,
+					// Number of lines in block
+		width,			// Width of block in bytes
+		out_width = cpcl->dither.out_width;
+					// Width of a line in bytes
+
+
+  if (lines == 0)
+    return (true);
+
+  cpcl->block_lines = 0;
+
+  // Crop each line in place to the inked bytes of the block...
+  width = cpcl->block_right - cpcl->block_left + 1;
+
+  if (width < out_width)
+  {
+    for (i = 0; i < lines; i ++)
+      memmove(cpcl->block + i * width, cpcl->block + i * out_width + cpcl->block_left, width);
+  }
+
+  // Then send a single CG command for all of the lines...
+  papplDevicePrintf(device, "CG %u %u %u %u ", width, lines, 8 * cpcl->block_left, cpcl->block_y);
+
+  if (papplDeviceWrite(device, cpcl->block, (size_t)width * lines) < 0)
+    return (false);
+
+  return (papplDevicePuts(device, "\r\n") > 0);
+}
+
+
 //
 // 'lprint_cpcl_printfile()' - Print a file.
 //
@@ -268,6 +323,7 @@ lprint_cpcl_rendjob(
   (void)options;
   (void)device;
 
+  free(cpcl->block);
   free(cpcl);
   papplJobSetData(job, NULL);
 
@@ -295,6 +351,7 @@ lprint_cpcl_rendpage(
 
   // Write last line
   lprint_cpcl_rwriteline(job, options, device, options->header.cupsHeight, NULL);
+  lprint_cpcl_flush(device, cpcl);
 
   // Set options
   papplDevicePrintf(device, "PRESENT-AT %d 4\r\n", options->media.top_offset * options->printer_resolution[1] / 2540);
@@ -369,24 +426,40 @@ lprint_cpcl_rstartpage(
 {
   lprint_cpcl_t	*cpcl = (lprint_cpcl_t *)papplJobGetData(job);
 					// CPCL driver data
+  unsigned	block_max;		// Maximum lines in a graphics block
 
 
   (void)page;
 
   // Initialize the dither buffer...
-  if (!lprintDitherAlloc(&cpcl->dither, job, options, /*head_width*/0, CUPS_CSPACE_W, options->header.HWResolution[0] == 300 ? 1.2 : 1.0, /*out_mirror*/false))
+  if (!lprintDitherAlloc(&cpcl->dither, job, options, /*head_width*/0, CUPS_CSPACE_K, options->header.HWResolution[0] == 300 ? 1.2 : 1.0, /*out_mirror*/false))
     return (false);
 
+  // Allocate the graphics block buffer...
+  if ((block_max = LPRINT_CPCL_MAX_BLOCK / cpcl->dither.out_width) < 1)
+    block_max = 1;
+
+  if (block_max != cpcl->block_max)
+  {
+    free(cpcl->block);
+
+    if ((cpcl->block = malloc(block_max * cpcl->dither.out_width)) == NULL)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate graphics block buffer.");
+      cpcl->block_max = 0;
+      return (false);
+    }
+
+    cpcl->block_max = block_max;
+  }
+
+  cpcl->block_lines = 0;
+
   // Initialize the printer...
   papplDevicePrintf(device, "! 0 %u %u %u %u\r\n", options->header.HWResolution[0], options->header.HWResolution[1], options->header.cupsHeight, options->header.NumCopies ? options->header.NumCopies : 1);
   papplDevicePrintf(device, "PAGE-WIDTH %u\r\n", options->header.cupsWidth);
   papplDevicePrintf(device, "PAGE-HEIGHT %u\r\n", options->header.cupsHeight);
 
-
-  // Start the page image...
-  papplDevicePuts(device, "CLS\n");
-  papplDevicePrintf(device, "BITMAP 0,0,%u,%u,1,", cpcl->dither.out_width, options->header.cupsHeight);
-
   return (true);
 }
 
@@ -394,6 +467,9 @@ lprint_cpcl_rstartpage(
 //
 // 'lprint_cpcl_rwriteline()' - Write a raster line.
 //
+// Consecutive non-blank lines are collected into a single CG block that only
+// covers the inked bytes of those lines, while blank lines are skipped.
+//
 
 static bool				// O - `true` on success, `false` on failure
 lprint_cpcl_rwriteline(
@@ -405,22 +481,49 @@ lprint_cpcl_rwriteline(
 {
   lprint_cpcl_t		*cpcl = (lprint_cpcl_t *)papplJobGetData(job);
 					// CPCL driver data
+  lprint_dither_t	*dither = &cpcl->dither;
+					// Dither buffer
+  unsigned		left,		// Left-most inked byte
+			right;		// Right-most inked byte
 
 
   (void)options;
 
-  // Dither and write the line...
-  if (lprintDitherLine(&cpcl->dither, y, line))
+  if (!lprintDitherLine(dither, y, line))
+    return (true);
+
+  // Find the inked bytes...
+  for (left = 0; left < dither->out_width && dither->output[left] == dither->out_white; left ++);
+
+  if (left >= dither->out_width)
   {
-    if (cpcl->dither.output[0] || memcmp(cpcl->dither.output, cpcl->dither.output + 1, cpcl->dither.out_width - 1))
-    {
-      papplDevicePrintf(device, "CG %u 1 0 %d ", (unsigned)cpcl->dither.out_width, y);
-      papplDeviceWrite(device, cpcl->dither.output, cpcl->dither.out_width);
-      papplDevicePuts(device, "\r\n");
-      papplDeviceFlush(device);
-    }
+    // Blank line, send the current block...
+    return (lprint_cpcl_flush(device, cpcl));
+  }
+
+  for (right = dither->out_width - 1; right > left && dither->output[right] == dither->out_white; right --);
+
+  // Add the line to the current block...
+  if (cpcl->block_lines >= cpcl->block_max && !lprint_cpcl_flush(device, cpcl))
+    return (false);
+
+  if (cpcl->block_lines == 0)
+  {
+    cpcl->block_y     = y;
+    cpcl->block_left  = left;
+    cpcl->block_right = right;
+  }
+  else
+  {
+    if (left < cpcl->block_left)
+      cpcl->block_left = left;
+    if (right > cpcl->block_right)
+      cpcl->block_right = right;
   }
 
+  memcpy(cpcl->block + cpcl->block_lines * dither->out_width, dither->output, dither->out_width);
+  cpcl->block_lines ++;
+
   return (true);
 }
 
@@ -22,6 +22,9 @@ typedef enum lprint_dlang_e
   LPRINT_DLANG_TAPE			// Tape printing
 } lprint_dlang_t;
 
+// Status bits
+#define LPRINT_DYMO_STATUS_PAPER_OUT	0x20	// Paper out
+
 typedef struct lprint_dymo_s		// DYMO driver data
 {
   lprint_dlang_t dlang;			// Printer language
@@ -29,6 +32,8 @@ typedef struct lprint_dymo_s		// DYMO driver data
   int		feed,			// Accumulated feed
 		min_leader,		// Leader distance for cut
 		normal_leader;		// Leader distance for top of label
+  bool		compress;		// Send compressed (ETB) lines?
+  unsigned char	comp_buffer[256];	// Compressed line buffer
 } lprint_dymo_t;
 
 
@@ -142,6 +147,7 @@ static const char * const lprint_dymo_tape[] =
 // Local functions...
 //
 
+static size_t	lprint_dymo_compress(lprint_dymo_t *dymo);
 static void	lprint_dymo_init(pappl_job_t *job, lprint_dymo_t *dymo);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_dymo_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
@@ -154,6 +160,7 @@ static bool	lprint_dymo_rstartjob(pappl_job_t *job, pappl_pr_options_t *options,
 static bool	lprint_dymo_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_dymo_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
 static bool	lprint_dymo_status(pappl_printer_t *printer);
+static bool	lprint_dymo_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
 
 
 //
@@ -273,6 +280,56 @@ lprintDYMO(
 }
 
 
+//
+// 'lprint_dymo_compress()' - Compress the current line for the ETB command.
+//
+// Each compressed byte holds a run of 1 to 128 dots, with the high bit set
+// for black dots and the run length minus 1 in the low 7 bits.  Returns `0` if
+// the compressed line would not be smaller than the raw line.
+//
+
+static size_t				// O - Number of compressed bytes or `0` to send raw data
+lprint_dymo_compress(
+    lprint_dymo_t *dymo)		// I - Driver data
+{
+  const unsigned char	*line = dymo->dither.output;
+					// Line to compress
+  unsigned		x,		// Current dot
+			count,		// Dots in current run
+			dots = 8 * dymo->dither.out_width;
+					// Width in dots
+  unsigned char		*compptr = dymo->comp_buffer,
+					// Pointer into compressed line
+			*compend = dymo->comp_buffer + dymo->dither.out_width - 1,
+					// End of compressed line
+			black,		// Color of current run (0x80 = black)
+			bit;		// Current bit
+
+
+  if (dymo->dither.out_width > sizeof(dymo->comp_buffer))
+    return (0);
+
+  for (x = 0; x < dots;)
+  {
+    black = (line[x / 8] & (0x80 >> (x & 7))) ? 0x80 : 0x00;
+
+    for (count = 1, x ++; x < dots && count < 128; count ++, x ++)
+    {
+      bit = (line[x / 8] & (0x80 >> (x & 7))) ? 0x80 : 0x00;
+      if (bit != black)
+        break;
+    }
+
+    if (compptr >= compend)
+      return (0);			// Not smaller than raw data
+
+    *compptr++ = black | (unsigned char)(count - 1);
+  }
+
+  return ((size_t)(compptr - dymo->comp_buffer));
+}
+
+
 //
 // 'lprint_dymo_init()' - Initialize DYMO driver data based on the driver name...
 //
@@ -310,6 +367,12 @@ lprint_dymo_init(
   else
   {
     dymo->dlang = LPRINT_DLANG_LABEL;
+
+    // The LabelWriter 400 and 450 series accept compressed lines...
+    if (lprintCompression() == LPRINT_COMPRESSION_AUTO)
+      dymo->compress = !strncmp(driver_name, "dymo_lw-4", 9) || !strcmp(driver_name, "dymo_lw-se450");
+    else
+      dymo->compress = lprintCompression() == LPRINT_COMPRESSION_ALWAYS;
   }
 }
 
@@ -390,6 +453,7 @@ lprint_dymo_rendjob(
   (void)options;
 
   free(dymo);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -410,6 +474,7 @@ lprint_dymo_rendpage(
   lprint_dymo_t	*dymo = (lprint_dymo_t *)papplJobGetData(job);
 					// DYMO driver data
   char		buffer[256];		// Command buffer
+  int		leader;			// Leader after the last line
 
 
   (void)page;
@@ -422,10 +487,26 @@ lprint_dymo_rendpage(
         break;
 
     case LPRINT_DLANG_TAPE :
-	// Skip and cut...
+        // Skip the leader to the cutter, or the auto-length margin if that
+        // is longer since trailing blank lines are never sent...
+        leader = (int)dymo->min_leader;
+
+        if (lprintAutoLengthEnabled())
+        {
+	  int margin = (int)(lprintAutoLength(options, options->header.cupsHeight - (unsigned)dymo->feed) + (unsigned)dymo->feed - options->header.cupsHeight);
+					// Margin after the last inked line
+
+          if (margin > leader)
+            leader = margin;
+        }
+
+        // Skip and cut...
         papplDevicePrintf(device, "\033D%c", 0);
-        memset(buffer, 0x16, dymo->min_leader);
-        papplDeviceWrite(device, buffer, dymo->min_leader);
+	memset(buffer, 0x16, sizeof(buffer));
+	for (; leader > (int)sizeof(buffer); leader -= (int)sizeof(buffer))
+	  papplDeviceWrite(device, buffer, sizeof(buffer));
+
+        papplDeviceWrite(device, buffer, (size_t)leader);
         break;
   }
 
@@ -433,6 +514,10 @@ lprint_dymo_rendpage(
   papplDevicePuts(device, "\033E");
   papplDeviceFlush(device);
 
+  // Answer a queued status request between labels...
+  if (lprintSessionStatusQueued(job) && dymo->dlang == LPRINT_DLANG_LABEL)
+    lprint_dymo_update_reasons(papplJobGetPrinter(job), job, device);
+
   // Free memory and return...
   lprintDitherFree(&dymo->dither);
 
@@ -453,6 +538,7 @@ lprint_dymo_rstartjob(
   lprint_dymo_t		*dymo = (lprint_dymo_t *)calloc(1, sizeof(lprint_dymo_t));
 					// DYMO driver data
   char			buffer[23];	// Buffer for reset command
+  bool			new_session;	// New device session?
 
 
   (void)options;
@@ -461,11 +547,15 @@ lprint_dymo_rstartjob(
   lprint_dymo_init(job, dymo);
 
   papplJobSetData(job, dymo);
+  new_session = lprintSessionBegin(job, device);
 
-  // Reset the printer...
+  // Reset the printer, unless continuing a session with a ready printer...
   switch (dymo->dlang)
   {
     case LPRINT_DLANG_LABEL :
+        if (!new_session && lprint_dymo_update_reasons(papplJobGetPrinter(job), job, device))
+          break;
+
 	papplDevicePuts(device, "\033\033\033\033\033\033\033\033\033\033"
 				"\033\033\033\033\033\033\033\033\033\033"
 				"\033\033\033\033\033\033\033\033\033\033"
@@ -480,9 +570,12 @@ lprint_dymo_rstartjob(
         break;
 
     case LPRINT_DLANG_TAPE :
-        // Send nul bytes to clear input buffer...
-        memset(buffer, 0, sizeof(buffer));
-        papplDeviceWrite(device, buffer, sizeof(buffer));
+        if (new_session)
+        {
+          // Send nul bytes to clear input buffer...
+          memset(buffer, 0, sizeof(buffer));
+          papplDeviceWrite(device, buffer, sizeof(buffer));
+        }
 
         // Set tape color to black on white...
         papplDevicePrintf(device, "\033C%c", 0);
@@ -598,6 +691,7 @@ lprint_dymo_rwriteline(
   lprint_dymo_t		*dymo = (lprint_dymo_t *)papplJobGetData(job);
 					// DYMO driver data
   unsigned char		byte;		// Byte to write
+  size_t		comp_bytes;	// Compressed bytes
 
 
   if (!lprintDitherLine(&dymo->dither, y, line))
@@ -622,10 +716,19 @@ lprint_dymo_rwriteline(
 	    dymo->feed = 0;
 	  }
 
-	  // Then write the non-blank line...
-	  byte = 0x16;
-	  papplDeviceWrite(device, &byte, 1);
-	  papplDeviceWrite(device, dymo->dither.output, dymo->dither.out_width);
+	  // Then write the non-blank line, compressed if that is smaller...
+	  if (dymo->compress && (comp_bytes = lprint_dymo_compress(dymo)) > 0)
+	  {
+	    byte = 0x17;
+	    papplDeviceWrite(device, &byte, 1);
+	    papplDeviceWrite(device, dymo->comp_buffer, comp_bytes);
+	  }
+	  else
+	  {
+	    byte = 0x16;
+	    papplDeviceWrite(device, &byte, 1);
+	    papplDeviceWrite(device, dymo->dither.output, dymo->dither.out_width);
+	  }
 	  break;
 
       case LPRINT_DLANG_TAPE :
@@ -670,7 +773,90 @@ static bool				// O - `true` on success, `false` on failure
 lprint_dymo_status(
     pappl_printer_t *printer)		// I - Printer
 {
-  (void)printer;
+  pappl_device_t	*device;	// Connection to printer
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+
+
+  // See if the status checks need to be suspended...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata->status_disabled || extdata->status_time >= time(NULL))
+    return (true);
+
+  // Tape printers don't support the print engine status command...
+  if (!strncmp(papplPrinterGetDriverName(printer), "dymo_lm-", 8) || strstr(papplPrinterGetDriverName(printer), "-tape"))
+    return (true);
+
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
+  // No, try talking to the printer...
+  if ((device = papplPrinterOpenDevice(printer)) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to open device for status.");
+    goto done;
+  }
+
+  // Get the printer status...
+  ret = lprint_dymo_update_reasons(printer, NULL, device);
+
+  done:
+
+  papplPrinterCloseDevice(printer);
+
+  if (!ret)
+  {
+    // Don't try doing status updates for 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+    ret = true;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'lprint_dymo_update_reasons()' - Update "printer-state-reasons" values.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_dymo_update_reasons(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    pappl_device_t  *device)		// I - Connection to device
+{
+  unsigned char		status;		// Status byte
+  pappl_preason_t	reasons;	// "printer-state-reasons" values
+
+
+  // Get the print engine status...
+  if (papplDevicePuts(device, "\033A") < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send print engine status command.");
+    return (false);
+  }
+
+  if (papplDeviceRead(device, &status, 1) < 1)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read print engine status response.");
+    return (false);
+  }
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Print engine status is 0x%02X.", status);
+
+  reasons = PAPPL_PREASON_NONE;
+
+  if (status & LPRINT_DYMO_STATUS_PAPER_OUT)
+    reasons |= PAPPL_PREASON_MEDIA_EMPTY;
+
+  if (job && (reasons & PAPPL_PREASON_MEDIA_EMPTY))
+    reasons |= PAPPL_PREASON_MEDIA_NEEDED;
+
+  papplPrinterSetReasons(printer, reasons, PAPPL_PREASON_MEDIA_EMPTY | PAPPL_PREASON_MEDIA_NEEDED);
 
   return (true);
 }
@@ -10,6 +10,35 @@
 #include "lprint.h"
 
 
+//
+// Constants...
+//
+
+#define LPRINT_EPL2_MAX_BLOCK	32768	// Maximum size of a GW block in bytes
+#define LPRINT_EPL2_MAX_STORED	131072	// Maximum printer memory for stored graphics
+
+
+//
+// Local types...
+//
+
+typedef struct lprint_epl2_s		// EPL2 driver data
+{
+  lprint_dither_t dither;		// Dither buffer
+  bool		store;			// Buffer the page for stored graphics?
+  unsigned char	*page;			// Page bitmap
+  unsigned	page_height;		// Height of page bitmap in lines
+  unsigned char	*pcx;			// PCX image buffer
+  size_t	pcx_size;		// Size of PCX image buffer
+  unsigned char	*block;			// Graphics block buffer
+  unsigned	block_y,		// First line in block
+		block_lines,		// Number of lines in block
+		block_max,		// Maximum number of lines in block
+		block_left,		// Left-most inked byte in block
+		block_right;		// Right-most inked byte in block
+} lprint_epl2_t;
+
+
 //
 // Local globals...
 //
@@ -121,6 +150,9 @@ static const char * const lprint_epl2_4inch_media[] =
 // Local functions...
 //
 
+static bool	lprint_epl2_add_line(pappl_device_t *device, lprint_epl2_t *epl2, unsigned y, const unsigned char *line);
+static void	lprint_epl2_delete_graphic(int slot, void *cbdata);
+static bool	lprint_epl2_flush(pappl_device_t *device, lprint_epl2_t *epl2);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_epl2_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
 #else
@@ -132,6 +164,7 @@ static bool	lprint_epl2_rstartjob(pappl_job_t *job, pappl_pr_options_t *options,
 static bool	lprint_epl2_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_epl2_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
 static bool	lprint_epl2_status(pappl_printer_t *printer);
+static bool	lprint_epl2_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
 
 
 //
@@ -225,6 +258,118 @@ lprintEPL2(
 }
 
 
+//
+// 'lprint_epl2_add_line()' - Add a line to the current graphics block.
+//
+// Consecutive non-blank lines are collected into a single GW block that only
+// covers the inked bytes of those lines.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_epl2_add_line(
+    pappl_device_t      *device,	// I - Output device
+    lprint_epl2_t       *epl2,		// I - EPL2 driver data
+    unsigned            y,		// I - Line number
+    const unsigned char *line)		// I - Line bitmap
+{
+  unsigned	left,			// Left-most inked byte
+		right,			// Right-most inked byte
+		out_width = epl2->dither.out_width;
+					// Width of a line in bytes
+  unsigned char	white = epl2->dither.out_white;
+					// White byte value
+
+
+  // Find the inked bytes...
+  for (left = 0; left < out_width && line[left] == white; left ++);
+
+  if (left >= out_width)
+  {
+    // Blank line, send the current block...
+    return (lprint_epl2_flush(device, epl2));
+  }
+
+  for (right = out_width - 1; right > left && line[right] == white; right --);
+
+  // Add the line to the current block...
+  if (epl2->block_lines >= epl2->block_max && !lprint_epl2_flush(device, epl2))
+    return (false);
+
+  if (epl2->block_lines == 0)
+  {
+    epl2->block_y     = y;
+    epl2->block_left  = left;
+    epl2->block_right = right;
+  }
+  else
+  {
+    if (left < epl2->block_left)
+      epl2->block_left = left;
+    if (right > epl2->block_right)
+      epl2->block_right = right;
+  }
+
+  memcpy(epl2->block + epl2->block_lines * out_width, line, out_width);
+  epl2->block_lines ++;
+
+  return (true);
+}
+
+
+//
+// 'lprint_epl2_delete_graphic()' - Delete a stored graphic from printer memory.
+//
+
+static void
+lprint_epl2_delete_graphic(
+    int  slot,				// I - Graphic slot
+    void *cbdata)			// I - Output device
+{
+  papplDevicePrintf((pappl_device_t *)cbdata, "GK\"LPRINT%02d\"\n", slot);
+}
+
+
+//
+// 'lprint_epl2_flush()' - Send the current graphics block.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_epl2_flush(
+    pappl_device_t *device,		// I - Output device
+    lprint_epl2_t  *epl2)		// I - EPL2 driver data
+{
+  unsigned	i,			// Looping var
+		lines = epl2->block_lines,
+					// Number of lines in block
+		width,			// Width of block in bytes
+		out_width = epl2->dither.out_width;
+					// Width of a line in bytes
+
+
+  if (lines == 0)
+    return (true);
+
+  epl2->block_lines = 0;
+
+  // Crop each line in place to the inked bytes of the block...
+  width = epl2->block_right - epl2->block_left + 1;
+
+  if (width < out_width)
+  {
+    for (i = 0; i < lines; i ++)
+      memmove(epl2->block + i * width, epl2->block + i * out_width + epl2->block_left, width);
+  }
+
+  // Then send a single GW command for all of the lines...
+  papplDevicePrintf(device, "GW%u,%u,%u,%u\n", 8 * epl2->block_left, epl2->block_y, width, lines);
+
+  if (papplDeviceWrite(device, epl2->block, (size_t)width * lines) < 0)
+    return (false);
+
+  return (papplDevicePuts(device, "\n") > 0);
+}
+
+
 //
 // 'lprint_epl2_print()' - Print a file.
 //
@@ -286,14 +431,18 @@ lprint_epl2_rendjob(
     pappl_pr_options_t *options,	// I - Job options
     pappl_device_t     *device)		// I - Output device
 {
-  lprint_dither_t *dither = (lprint_dither_t *)papplJobGetData(job);
-					// Dither buffer
+  lprint_epl2_t	*epl2 = (lprint_epl2_t *)papplJobGetData(job);
+					// EPL2 driver data
 
 
   (void)options;
   (void)device;
 
-  free(dither);
+  free(epl2->page);
+  free(epl2->pcx);
+  free(epl2->block);
+  free(epl2);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -311,23 +460,85 @@ lprint_epl2_rendpage(
     pappl_device_t     *device,		// I - Output device
     unsigned           page)		// I - Page number
 {
-  lprint_dither_t *dither = (lprint_dither_t *)papplJobGetData(job);
-					// Dither buffer
+  lprint_epl2_t	*epl2 = (lprint_epl2_t *)papplJobGetData(job);
+					// EPL2 driver data
+  pappl_printer_t *printer = papplJobGetPrinter(job);
+					// Printer
+  unsigned	y,			// Current line
+		out_width = epl2->dither.out_width;
+					// Width of a line in bytes
+  const unsigned char *line;		// Current line
+  uint64_t	hash;			// Hash of page bitmap
+  int		slot;			// Stored graphic slot
+  bool		repeated;		// Has this page been printed before?
+  size_t	pcx_size;		// Size of PCX image
+  bool		ret;			// Return value
 
 
   (void)page;
 
-  lprint_epl2_rwriteline(job, options, device, options->header.cupsHeight, NULL);
+  // Write the last line and send the last graphics block...
+  ret = lprint_epl2_rwriteline(job, options, device, options->header.cupsHeight, NULL) && lprint_epl2_flush(device, epl2);
 
-  papplDevicePuts(device, "P1\n");
+  if (ret && epl2->store)
+  {
+    // Find the first inked line...
+    for (y = 0, line = epl2->page; y < epl2->page_height; y ++, line += out_width)
+    {
+      if (line[0] != epl2->dither.out_white || memcmp(line, line + 1, out_width - 1))
+        break;
+    }
+
+    if (y < epl2->page_height)
+    {
+      // Recall the page from printer memory if it has been stored, or store it
+      // as a PCX image when it is printed again or compression is forced...
+      hash = lprintGraphicsHash(epl2->page, out_width, epl2->page_height);
+
+      if ((slot = lprintGraphicsFind(printer, hash, &repeated)) < 0 && (repeated || lprintCompression() == LPRINT_COMPRESSION_ALWAYS) && (pcx_size = lprintPCXEncode(epl2->pcx, epl2->pcx_size, epl2->page, out_width, epl2->page_height, options->header.HWResolution[0])) > 0 && (slot = lprintGraphicsStore(printer, hash, pcx_size, LPRINT_EPL2_MAX_STORED, lprint_epl2_delete_graphic, device)) >= 0)
+      {
+        papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Storing %u byte graphic LPRINT%02d.", (unsigned)pcx_size, slot);
+
+        lprint_epl2_delete_graphic(slot, device);
+
+        if (papplDevicePrintf(device, "GM\"LPRINT%02d\"%u\n", slot, (unsigned)pcx_size) < 0 || papplDeviceWrite(device, epl2->pcx, pcx_size) < 0 || papplDevicePuts(device, "\n") < 0)
+        {
+          // The graphic may not be in printer memory, forget it...
+          lprintGraphicsClear(printer);
+          ret = false;
+        }
+      }
+
+      if (ret && slot >= 0)
+      {
+        ret = papplDevicePrintf(device, "GG0,0,\"LPRINT%02d\"\n", slot) >= 0;
+      }
+      else if (ret)
+      {
+        // Send the inked lines as GW blocks...
+        for (; ret && y < epl2->page_height; y ++, line += out_width)
+          ret = lprint_epl2_add_line(device, epl2, y, line);
+
+        if (ret)
+          ret = lprint_epl2_flush(device, epl2);
+      }
+    }
+  }
 
-  if (options->finishings & PAPPL_FINISHINGS_TRIM)
-    papplDevicePuts(device, "C\n");
+  if (ret && papplDevicePuts(device, "P1\n") < 0)
+    ret = false;
+
+  if (ret && (options->finishings & PAPPL_FINISHINGS_TRIM) && papplDevicePuts(device, "C\n") < 0)
+    ret = false;
+
+  // Answer a queued status request between labels...
+  if (ret && lprintSessionStatusQueued(job))
+    lprint_epl2_update_reasons(papplJobGetPrinter(job), job, device);
 
   // Free memory and return...
-  lprintDitherFree(dither);
+  lprintDitherFree(&epl2->dither);
 
-  return (true);
+  return (ret);
 }
 
 
@@ -341,15 +552,16 @@ lprint_epl2_rstartjob(
     pappl_pr_options_t *options,	// I - Job options
     pappl_device_t     *device)		// I - Output device
 {
-  lprint_dither_t *dither = (lprint_dither_t *)calloc(1, sizeof(lprint_dither_t));
-					// Dither buffer
+  lprint_epl2_t	*epl2 = (lprint_epl2_t *)calloc(1, sizeof(lprint_epl2_t));
+					// EPL2 driver data
 
 
   (void)options;
   (void)device;
 
-  // Save dither buffer for job...
-  papplJobSetData(job, dither);
+  // Save driver data for job...
+  papplJobSetData(job, epl2);
+  lprintSessionBegin(job, device);
 
   return (true);
 }
@@ -367,10 +579,14 @@ lprint_epl2_rstartpage(
     unsigned           page)		// I - Page number
 {
   int		ips;			// Inches per second
-  lprint_dither_t *dither = (lprint_dither_t *)papplJobGetData(job);
+  lprint_epl2_t	*epl2 = (lprint_epl2_t *)papplJobGetData(job);
+					// EPL2 driver data
+  lprint_dither_t *dither = &epl2->dither;
 					// Dither buffer
   int		darkness;		// Composite darkness value
   double	out_gamma = 1.0;	// Output gamma correction
+  unsigned	block_max;		// Maximum lines in a graphics block
+  size_t	raw_size;		// Size of page bitmap
 
 
   (void)page;
@@ -382,6 +598,53 @@ lprint_epl2_rstartpage(
   if (!lprintDitherAlloc(dither, job, options, /*head_width*/0, CUPS_CSPACE_W, out_gamma, /*out_mirror*/false))
     return (false);
 
+  // Allocate the graphics block buffer...
+  if ((block_max = LPRINT_EPL2_MAX_BLOCK / dither->out_width) < 1)
+    block_max = 1;
+
+  if (block_max != epl2->block_max)
+  {
+    free(epl2->block);
+
+    if ((epl2->block = malloc(block_max * dither->out_width)) == NULL)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate graphics block buffer.");
+      epl2->block_max = 0;
+      return (false);
+    }
+
+    epl2->block_max = block_max;
+  }
+
+  epl2->block_lines = 0;
+
+  // Allocate the page bitmap and PCX buffers when graphics can be stored in
+  // printer memory, otherwise the lines are streamed as GW blocks.  Stored
+  // graphics are only used when they are smaller than the page bitmap...
+  free(epl2->page);
+  free(epl2->pcx);
+
+  epl2->page  = NULL;
+  epl2->pcx   = NULL;
+  epl2->store = lprintGraphicsEnabled() && lprintCompression() != LPRINT_COMPRESSION_NONE;
+
+  if (epl2->store)
+  {
+    // Dithered lines are sent at positions 1 through cupsHeight, the same as
+    // the GW blocks...
+    epl2->page_height = options->header.cupsHeight + 1;
+    raw_size          = (size_t)dither->out_width * epl2->page_height;
+    epl2->pcx_size    = LPRINT_PCX_HEADER + raw_size;
+
+    if ((epl2->page = malloc(raw_size)) == NULL || (epl2->pcx = malloc(epl2->pcx_size)) == NULL)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate page buffers.");
+      return (false);
+    }
+
+    memset(epl2->page, dither->out_white, raw_size);
+  }
+
   // Start a new label...
   papplDevicePuts(device, "\nN\n");
 
@@ -416,22 +679,26 @@ lprint_epl2_rwriteline(
     unsigned            y,		// I - Line number
     const unsigned char *line)		// I - Line
 {
-  lprint_dither_t *dither = (lprint_dither_t *)papplJobGetData(job);
-					// Dither buffer
+  lprint_epl2_t		*epl2 = (lprint_epl2_t *)papplJobGetData(job);
+					// EPL2 driver data
+
 
+  (void)options;
 
-  if (!lprintDitherLine(dither, y, line))
+  if (!lprintDitherLine(&epl2->dither, y, line))
     return (true);
 
-  if (dither->output[0] || memcmp(dither->output, dither->output + 1, dither->out_width - 1))
+  if (epl2->store)
   {
-    // Not a blank line
-    papplDevicePrintf(device, "GW0,%u,%u,1\n", y, dither->out_width);
-    papplDeviceWrite(device, dither->output, dither->out_width);
-    papplDevicePuts(device, "\n");
+    // Save the line for the stored graphic...
+    if (y < epl2->page_height)
+      memcpy(epl2->page + y * epl2->dither.out_width, epl2->dither.output, epl2->dither.out_width);
+
+    return (true);
   }
 
-  return (true);
+  // Add the line to the current graphics block...
+  return (lprint_epl2_add_line(device, epl2, y, epl2->dither.output));
 }
 
 
@@ -443,7 +710,139 @@ static bool				// O - `true` on success, `false` on failure
 lprint_epl2_status(
     pappl_printer_t *printer)		// I - Printer
 {
-  (void)printer;
+  pappl_device_t	*device;	// Connection to printer
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+
+
+  // See if the status checks need to be suspended...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata->status_disabled || extdata->status_time >= time(NULL))
+    return (true);
+
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
+  // No, try talking to the printer...
+  if ((device = papplPrinterOpenDevice(printer)) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to open device for status.");
+    goto done;
+  }
+
+  // Get the printer status...
+  ret = lprint_epl2_update_reasons(printer, NULL, device);
+
+  done:
+
+  papplPrinterCloseDevice(printer);
+
+  if (!ret)
+  {
+    // Don't try doing status updates for 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+    ret = true;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'lprint_epl2_update_reasons()' - Update "printer-state-reasons" values.
+//
+// The UQ command returns several lines with the printer configuration,
+// including the current label length ("Qlength,gap"), and the ^ee command
+// returns the current error code as a line with two digits.  Both are sent
+// together so that the error code marks the end of the response.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_epl2_update_reasons(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    pappl_device_t  *device)		// I - Connection to device
+{
+  char			buffer[2049],	// Response from printer
+			*bufptr,	// Pointer into response
+			*lineptr,	// Current line
+			*eol;		// End of line
+  ssize_t		bytes;		// Bytes read
+  int			length = 0,	// Label length in dots
+			error = -1;	// Error code
+  pappl_preason_t	reasons;	// "printer-state-reasons" values
+  pappl_pr_driver_data_t data;		// Driver data
+
+
+  // Query the configuration and error status...
+  if (papplDevicePuts(device, "\nUQ\n^ee\n") < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send status commands.");
+    return (false);
+  }
+
+  // Read lines until the error code arrives...
+  for (bufptr = buffer, lineptr = buffer; error < 0;)
+  {
+    if (bufptr >= (buffer + sizeof(buffer) - 1))
+    {
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Status response too long.");
+      return (false);
+    }
+
+    if ((bytes = papplDeviceRead(device, bufptr, sizeof(buffer) - 1 - (size_t)(bufptr - buffer))) <= 0)
+    {
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read status response.");
+      return (false);
+    }
+
+    bufptr  += bytes;
+    *bufptr = '\0';
+
+    for (; (eol = strchr(lineptr, '\n')) != NULL; lineptr = eol + 1)
+    {
+      if (isdigit(lineptr[0] & 255) && isdigit(lineptr[1] & 255) && (lineptr[2] == '\r' || lineptr[2] == '\n'))
+      {
+        error = atoi(lineptr);
+        *lineptr = '\0';
+        break;
+      }
+    }
+  }
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "UQ returned '%s'.", buffer);
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Error status is %02d.", error);
+
+  if (!job && (lineptr = strstr(buffer, " Q")) != NULL && sscanf(lineptr + 2, "%d", &length) == 1 && length > 11)
+  {
+    // Auto-detect label length for ready media...
+    // Round the length to the nearest dot and snap to the nearest 1/4"...
+    papplPrinterGetDriverData(printer, &data);
+
+    length = (2540 * length + data.y_resolution[0] / 2) / data.y_resolution[0];
+
+    if ((length % 635) <= 100)
+      length += length % 635;
+    else if ((length % 635) >= 535)
+      length += 635 - (length % 635);
+
+    // Lookup size
+    lprintMediaMatch(printer, 0, 0, length);
+  }
+
+  reasons = PAPPL_PREASON_NONE;
+
+  if (error == 7)
+    reasons |= PAPPL_PREASON_MEDIA_EMPTY;	// Paper or ribbon empty
+
+  if (job && (reasons & PAPPL_PREASON_MEDIA_EMPTY))
+    reasons |= PAPPL_PREASON_MEDIA_NEEDED;
+
+  papplPrinterSetReasons(printer, reasons, PAPPL_PREASON_MEDIA_EMPTY | PAPPL_PREASON_MEDIA_NEEDED);
 
   return (true);
 }
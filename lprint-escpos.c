@@ -10,6 +10,17 @@
 #include "lprint.h"
 
 
+//
+// Constants...
+//
+
+#define LPRINT_ESCPOS_BLOCK_SIZE 32768	// Size of each graphics buffer
+#define LPRINT_ESCPOS_BLOCK_TIME 0.25	// Target time for sending a graphics block in seconds
+#define LPRINT_ESCPOS_HEADER_LINES 203	// Number of lines in the page header block (1")
+#define LPRINT_ESCPOS_MAX_STORED 65536	// Maximum NV memory for stored graphics
+#define LPRINT_ESCPOS_MIN_LINES	24	// Minimum number of lines in a graphics block
+
+
 //
 // Local types...
 //
@@ -18,11 +29,26 @@ typedef struct lprint_escpos_s		// ESC/POS driver data
 {
   int		max_width;		// Roll width in hundredths of millimeters
   lprint_dither_t dither;		// Dithering buffer
+  bool		asb;			// Is automatic status back enabled?
   bool		marked;			// Did we print anything yet?
+  bool		header;			// Is the next block the page header?
   int		feed;			// Accumulated feed
+  int		header_blank;		// Trailing blank lines in the page header
   int		num_lines,		// Number of lines in buffer
-		max_lines;		// Maximum number of lines that can fit
-  unsigned char	buffer[32768];		// Graphics buffer
+		max_lines;		// Maximum number of lines in a block
+  unsigned char	*buffer;		// Graphics buffer being filled
+  unsigned char	buffers[2][LPRINT_ESCPOS_BLOCK_SIZE];
+					// Graphics buffers
+  pthread_t	writer;			// Background writer thread
+  bool		writer_running;		// Is the writer thread running?
+  pthread_mutex_t writer_mutex;		// Mutex for writer state
+  pthread_cond_t writer_cond;		// Condition for writer state changes
+  pappl_device_t *writer_device;	// Output device for writer
+  const unsigned char *writer_data;	// Block being written, if any
+  size_t	writer_bytes;		// Size of block being written
+  bool		writer_ok;		// Did all writes succeed?
+  bool		writer_stop;		// Stop the writer thread?
+  double	write_rate;		// Measured write rate in bytes per second
 } lprint_escpos_t;
 
 
@@ -30,6 +56,9 @@ typedef struct lprint_escpos_s		// ESC/POS driver data
 // Local globals...
 //
 
+static pthread_mutex_t	lprint_escpos_asb_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for automatic status back support
+
 static const char * const lprint_escpos_58mm[] =
 {					// Supported media sizes for receipts
   "oe_2.25-receipt_58x1000mm",
@@ -50,19 +79,29 @@ static const char * const lprint_escpos_80mm[] =
 // Local functions...
 //
 
+static bool	lprint_escpos_asb_update(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
+static int	lprint_escpos_block_lines(lprint_escpos_t *escpos);
+static void	lprint_escpos_delete_graphic(int slot, void *cbdata);
+static void	lprint_escpos_free(pappl_job_t *job, lprint_escpos_t *escpos);
 static void	lprint_escpos_init(pappl_job_t *job, lprint_escpos_t *escpos);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_escpos_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
 #else
 static bool	lprint_escpos_printfile(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 #endif // PAPPL_API_VERSION_MAJOR
+static bool	lprint_escpos_query_status(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device, lprint_extdata_t *extdata, bool *asb);
+static bool	lprint_escpos_recall(pappl_job_t *job, pappl_device_t *device, lprint_escpos_t *escpos);
 static bool	lprint_escpos_rendjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_escpos_rendpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_escpos_rstartjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_escpos_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_escpos_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
+static bool	lprint_escpos_start(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_escpos_status(pappl_printer_t *printer);
 static bool	lprint_escpos_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
+static bool	lprint_escpos_wait(lprint_escpos_t *escpos);
+static void	lprint_escpos_write(lprint_escpos_t *escpos, pappl_device_t *device, size_t bytes);
+static void	*lprint_escpos_writer(lprint_escpos_t *escpos);
 
 
 //
@@ -144,6 +183,173 @@ lprintESCPOS(
 }
 
 
+//
+// 'lprint_escpos_asb_update()' - Update "printer-state-reasons" from automatic status back.
+//
+// Sending "GS a" enables ASB and makes the printer send its current status
+// once all previous data has been processed.  Any status blocks the printer
+// pushed since the last update are read at the same time.  Jobs call this
+// after each page and when a status request is queued, so changes during a
+// job (like running out of paper mid-receipt) are noticed by the next page.
+//
+// Each status block is 4 bytes:
+//
+//   Byte 1: 0xx1xx00 - bit 3 is offline, bit 5 is cover open
+//   Byte 2: 0xx0xxxx - bit 2 is mechanical error, bit 3 is cutter error,
+//                      bit 5 is unrecoverable error, bit 6 is auto-recoverable
+//                      error
+//   Byte 3: 0xx0xxxx - bits 0-1 are paper near-end, bits 2-3 are paper end
+//   Byte 4: 0xx0xxxx - reserved
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_escpos_asb_update(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    pappl_device_t  *device)		// I - Connection to device
+{
+  unsigned char		buffer[256],	// Status blocks
+			*bufptr,	// Pointer into buffer
+			*bufend,	// End of buffer
+			*status = NULL;	// Current status block
+  ssize_t		bytes;		// Bytes read
+  pappl_preason_t	reasons;	// "printer-state-reasons" values
+
+
+  // Enable ASB for drawer, online/offline, error, and paper sensor status...
+  if (papplDeviceWrite(device, "\035a\017", 3) < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send automatic status back command.");
+    return (false);
+  }
+
+  if ((bytes = papplDeviceRead(device, buffer, sizeof(buffer))) < 4)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read automatic status back response.");
+    return (false);
+  }
+
+  // Scan the status blocks, the last one is the current status...
+  for (bufptr = buffer, bufend = buffer + bytes - 3; bufptr < bufend;)
+  {
+    if ((bufptr[0] & 0x93) == 0x10 && !(bufptr[1] & 0x90) && !(bufptr[2] & 0x90) && !(bufptr[3] & 0x90))
+    {
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Automatic status back is %02X %02X %02X %02X.", bufptr[0], bufptr[1], bufptr[2], bufptr[3]);
+
+      status = bufptr;
+      bufptr += 4;
+    }
+    else
+    {
+      bufptr ++;
+    }
+  }
+
+  if (!status)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Bad automatic status back response.");
+    return (false);
+  }
+
+  reasons = PAPPL_PREASON_NONE;
+
+  if (status[0] & 0x08)
+    reasons |= PAPPL_PREASON_OFFLINE;
+  if (status[0] & 0x20)
+    reasons |= PAPPL_PREASON_COVER_OPEN;
+  if (status[1] & 0x6c)
+    reasons |= PAPPL_PREASON_OTHER;
+  if ((status[2] & 0x03) == 0x03)
+    reasons |= PAPPL_PREASON_MEDIA_LOW;
+  if ((status[2] & 0x0c) == 0x0c)
+    reasons |= PAPPL_PREASON_MEDIA_EMPTY;
+
+  if (job && (reasons & PAPPL_PREASON_MEDIA_EMPTY))
+    reasons |= PAPPL_PREASON_MEDIA_NEEDED;
+
+  papplPrinterSetReasons(printer, reasons, PAPPL_PREASON_COVER_OPEN | PAPPL_PREASON_MEDIA_EMPTY | PAPPL_PREASON_MEDIA_LOW | PAPPL_PREASON_MEDIA_NEEDED | PAPPL_PREASON_OFFLINE | PAPPL_PREASON_OTHER);
+
+  return (true);
+}
+
+
+//
+// 'lprint_escpos_block_lines()' - Get the number of lines for the next graphics block.
+//
+// Blocks are sized to take about 1/4 second to send at the measured write
+// rate, so slow (serial) printers start printing sooner and fast (USB or
+// network) printers get fewer, larger blocks.  The first block of a job uses
+// the minimum size.
+//
+
+static int				// O - Maximum number of lines
+lprint_escpos_block_lines(
+    lprint_escpos_t *escpos)		// I - ESC/POS driver data
+{
+  int	lines,				// Number of lines
+	max_lines = LPRINT_ESCPOS_BLOCK_SIZE / (int)escpos->dither.out_width;
+					// Maximum number of lines that fit
+
+
+  pthread_mutex_lock(&escpos->writer_mutex);
+  lines = (int)(escpos->write_rate * LPRINT_ESCPOS_BLOCK_TIME / escpos->dither.out_width);
+  pthread_mutex_unlock(&escpos->writer_mutex);
+
+  if (lines < LPRINT_ESCPOS_MIN_LINES)
+    lines = LPRINT_ESCPOS_MIN_LINES;
+  if (lines > max_lines)
+    lines = max_lines;
+
+  return (lines);
+}
+
+
+//
+// 'lprint_escpos_delete_graphic()' - Delete a stored graphic from NV memory.
+//
+
+static void
+lprint_escpos_delete_graphic(
+    int  slot,				// I - Graphic slot
+    void *cbdata)			// I - Output device
+{
+  unsigned char	command[9];		// Delete command ("GS ( L" function 66)
+
+
+  command[0] = 0x1d;
+  command[1] = '(';
+  command[2] = 'L';
+  command[3] = 4;
+  command[4] = 0;
+  command[5] = 48;
+  command[6] = 66;
+  command[7] = 'L';
+  command[8] = (unsigned char)('A' + slot);
+
+  papplDeviceWrite((pappl_device_t *)cbdata, command, sizeof(command));
+}
+
+
+//
+// 'lprint_escpos_free()' - Free ESC/POS driver data and end the device session.
+//
+// The background writer must be stopped first.
+//
+
+static void
+lprint_escpos_free(
+    pappl_job_t     *job,		// I - Job
+    lprint_escpos_t *escpos)		// I - ESC/POS driver data
+{
+  pthread_mutex_destroy(&escpos->writer_mutex);
+  pthread_cond_destroy(&escpos->writer_cond);
+
+  free(escpos);
+  lprintSessionEnd(job);
+  papplJobSetData(job, NULL);
+}
+
+
 //
 // 'lprint_escpos_init()' - Initialize ESC/POS driver data based on the driver name...
 //
@@ -160,6 +366,12 @@ lprint_escpos_init(
   // Clear the ESC/POS data...
   memset(escpos, 0, sizeof(lprint_escpos_t));
 
+  escpos->buffer    = escpos->buffers[0];
+  escpos->writer_ok = true;
+
+  pthread_mutex_init(&escpos->writer_mutex, NULL);
+  pthread_cond_init(&escpos->writer_cond, NULL);
+
   // Get the maximum width of the print head from the driver name ("escpos_MAXWIDTHmm")...
   escpos->max_width = (int)(100 * strtol(driver_name + 7, NULL, 10));
 }
@@ -182,17 +394,19 @@ lprint_escpos_printfile(
   int		fd;			// Input file
   ssize_t	bytes;			// Bytes read/written
   char		buffer[65536];		// Read/write buffer
-  lprint_escpos_t escpos;		// Driver data
+  lprint_escpos_t *escpos;		// Driver data
 
 
-  // Initialize driver data...
-  lprint_escpos_init(job, &escpos);
+  // Reset the printer and initialize driver data, without a background writer
+  // since raw files are copied directly...
+  if (!lprint_escpos_start(job, options, device))
+    return (false);
 
-  // Reset the printer...
-  lprint_escpos_rstartjob(job, options, device);
+  escpos = (lprint_escpos_t *)papplJobGetData(job);
 
   // Update status...
-  lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
+  if (!escpos->asb)
+    lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
 
   // Copy the raw file...
   papplJobSetImpressions(job, 1);
@@ -206,6 +420,7 @@ lprint_escpos_printfile(
   if ((fd  = open(filename, O_RDONLY)) < 0)
   {
     papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to open print file '%s': %s", filename, strerror(errno));
+    lprint_escpos_rendjob(job, options, device);
     return (false);
   }
 
@@ -215,16 +430,19 @@ lprint_escpos_printfile(
     {
       papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to send %d bytes to printer.", (int)bytes);
       close(fd);
+      lprint_escpos_rendjob(job, options, device);
       return (false);
     }
   }
   close(fd);
 
   // Update status...
-  lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
+  if (!escpos->asb)
+    lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
 
   // Reset the printer at the end of the job...
-  lprint_escpos_rendjob(job, options, device);
+  if (!lprint_escpos_rendjob(job, options, device))
+    return (false);
 
   papplJobSetImpressionsCompleted(job, 1);
 
@@ -232,6 +450,157 @@ lprint_escpos_printfile(
 }
 
 
+//
+// 'lprint_escpos_query_status()' - Query the printer status.
+//
+// Automatic status back is probed once per printer and the result is kept in
+// the extension data.  When the printer does not answer "GS a", the paper
+// sensor is queried right away with "ESC v" instead of waiting out another
+// read timeout, and a printer that answers "ESC v" but not "GS a" is never
+// asked for automatic status back again.  When neither query is answered the
+// printer is probably busy or off, so support stays unknown and is probed
+// again next time.
+//
+// On success "asb" is `true` if automatic status back is now enabled.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_escpos_query_status(
+    pappl_printer_t  *printer,		// I - Printer
+    pappl_job_t      *job,		// I - Current job or `NULL` if none
+    pappl_device_t   *device,		// I - Connection to device
+    lprint_extdata_t *extdata,		// I - Driver extension data
+    bool             *asb)		// O - Is automatic status back enabled?
+{
+  lprint_asb_t	support;		// Automatic status back support
+
+
+  pthread_mutex_lock(&lprint_escpos_asb_mutex);
+  support = extdata->asb;
+  pthread_mutex_unlock(&lprint_escpos_asb_mutex);
+
+  *asb = false;
+
+  if (support != LPRINT_ASB_UNSUPPORTED)
+  {
+    if (lprint_escpos_asb_update(printer, job, device))
+    {
+      if (support == LPRINT_ASB_UNKNOWN)
+      {
+        pthread_mutex_lock(&lprint_escpos_asb_mutex);
+        extdata->asb = LPRINT_ASB_SUPPORTED;
+        pthread_mutex_unlock(&lprint_escpos_asb_mutex);
+      }
+
+      *asb = true;
+      return (true);
+    }
+
+    // Turn off automatic status back in case the printer enabled it...
+    papplDeviceWrite(device, "\035a\000", 3);
+  }
+
+  if (!lprint_escpos_update_reasons(printer, job, device))
+    return (false);
+
+  if (support == LPRINT_ASB_UNKNOWN)
+  {
+    // Printer answers the paper sensor query but not automatic status back...
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Printer does not support automatic status back.");
+
+    pthread_mutex_lock(&lprint_escpos_asb_mutex);
+    extdata->asb = LPRINT_ASB_UNSUPPORTED;
+    pthread_mutex_unlock(&lprint_escpos_asb_mutex);
+  }
+
+  return (true);
+}
+
+
+//
+// 'lprint_escpos_recall()' - Print the current block from NV memory.
+//
+// The page header, usually a store logo and address, is sent as a single block
+// of `LPRINT_ESCPOS_HEADER_LINES` lines starting at the first inked line, so
+// its hash does not depend on the size of the other blocks.  If the same
+// header was printed before it is stored as an NV graphic with the key "L" +
+// slot letter ("GS ( L" function 67) so that later receipts only need to send
+// the print command ("GS ( L" function 69).  The commands are sent with
+// papplDeviceWrite since their parameters contain nul bytes.
+//
+
+static bool				// O - `true` if printed from NV memory, `false` to send raster data
+lprint_escpos_recall(
+    pappl_job_t     *job,		// I - Job
+    pappl_device_t  *device,		// I - Output device
+    lprint_escpos_t *escpos)		// I - ESC/POS driver data
+{
+  pappl_printer_t *printer = papplJobGetPrinter(job);
+					// Printer
+  unsigned	width = escpos->dither.out_width,
+					// Width of block in bytes
+		height = (unsigned)escpos->num_lines;
+					// Height of block in lines
+  size_t	size = (size_t)width * height;
+					// Size of block
+  uint64_t	hash;			// Hash of block
+  int		slot;			// Stored graphic slot
+  bool		repeated;		// Has this block been printed before?
+  unsigned char	command[16];		// Define/print command
+
+
+  hash = lprintGraphicsHash(escpos->buffer, width, height);
+
+  if ((slot = lprintGraphicsFind(printer, hash, &repeated)) < 0)
+  {
+    if (!repeated || (slot = lprintGraphicsStore(printer, hash, size, LPRINT_ESCPOS_MAX_STORED, lprint_escpos_delete_graphic, device)) < 0)
+      return (false);
+
+    // Define the NV graphic (p = 11 + data bytes)...
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Storing %ux%u NV graphic L%c.", 8 * width, height, 'A' + slot);
+
+    lprint_escpos_delete_graphic(slot, device);
+
+    command[0]  = 0x1d;
+    command[1]  = '(';
+    command[2]  = 'L';
+    command[3]  = (unsigned char)((size + 11) & 255);
+    command[4]  = (unsigned char)((size + 11) >> 8);
+    command[5]  = 48;
+    command[6]  = 67;
+    command[7]  = 48;
+    command[8]  = 'L';
+    command[9]  = (unsigned char)('A' + slot);
+    command[10] = 1;
+    command[11] = (unsigned char)((8 * width) & 255);
+    command[12] = (unsigned char)((8 * width) >> 8);
+    command[13] = (unsigned char)(height & 255);
+    command[14] = (unsigned char)(height >> 8);
+    command[15] = 49;
+
+    if (papplDeviceWrite(device, command, 16) < 0 || papplDeviceWrite(device, escpos->buffer, size) < 0)
+      return (false);
+  }
+
+  // Print the NV graphic at normal size...
+  papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Printing NV graphic L%c.", 'A' + slot);
+
+  command[0]  = 0x1d;
+  command[1]  = '(';
+  command[2]  = 'L';
+  command[3]  = 6;
+  command[4]  = 0;
+  command[5]  = 48;
+  command[6]  = 69;
+  command[7]  = 'L';
+  command[8]  = (unsigned char)('A' + slot);
+  command[9]  = 1;
+  command[10] = 1;
+
+  return (papplDeviceWrite(device, command, 11) > 0);
+}
+
+
 //
 // 'lprint_escpos_rend()' - End a job.
 //
@@ -249,8 +618,25 @@ lprint_escpos_rendjob(
 
   (void)options;
 
-  free(escpos);
-  papplJobSetData(job, NULL);
+  // Finish sending graphics and stop the background writer...
+  if (escpos->writer_running)
+  {
+    pthread_mutex_lock(&escpos->writer_mutex);
+    escpos->writer_stop = true;
+    pthread_cond_broadcast(&escpos->writer_cond);
+    pthread_mutex_unlock(&escpos->writer_mutex);
+
+    pthread_join(escpos->writer, NULL);
+  }
+
+  if (escpos->asb)
+  {
+    // Collect status pushed during the job, then disable ASB...
+    lprint_escpos_asb_update(papplJobGetPrinter(job), job, device);
+    papplDeviceWrite(device, "\035a\000", 3);
+  }
+
+  lprint_escpos_free(job, escpos);
 
   // Reset the printer...
   ret = papplDevicePuts(device, "\033@") > 0;
@@ -272,14 +658,31 @@ lprint_escpos_rendpage(
 {
   lprint_escpos_t *escpos = (lprint_escpos_t *)papplJobGetData(job);
 					// ESC/POS driver data
+  int		feed;			// Feed after the last line
 
 
   (void)page;
 
   lprint_escpos_rwriteline(job, options, device, options->header.cupsHeight, NULL);
+  lprint_escpos_wait(escpos);
+
+  // Feed 1" to the cutter, or the auto-length margin if that is longer since
+  // trailing blank lines are never sent...
+  feed = 203;
+
+  if (lprintAutoLengthEnabled())
+  {
+    int margin = (int)(lprintAutoLength(options, options->header.cupsHeight - (unsigned)escpos->feed) + (unsigned)escpos->feed - options->header.cupsHeight);
+					// Margin after the last inked line
+
+    if (margin > feed)
+      feed = margin;
+  }
+
+  for (; feed > 255; feed -= 255)
+    papplDevicePrintf(device, "\033J%c", 255);
 
-  // Feed 1"...
-  papplDevicePrintf(device, "\033J%c", 203);
+  papplDevicePrintf(device, "\033J%c", feed);
 
   if (options->finishings & PAPPL_FINISHINGS_TRIM)
   {
@@ -290,8 +693,11 @@ lprint_escpos_rendpage(
   // Free memory and return...
   lprintDitherFree(&escpos->dither);
 
-  // Update status...
-  lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
+  // Update status, collecting any status the printer sent during the page...
+  if (escpos->asb)
+    lprint_escpos_asb_update(papplJobGetPrinter(job), job, device);
+  else
+    lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
 
   return (true);
 }
@@ -307,29 +713,25 @@ lprint_escpos_rstartjob(
     pappl_pr_options_t *options,	// I - Job options
     pappl_device_t     *device)		// I - Output device
 {
-  lprint_escpos_t *escpos = (lprint_escpos_t *)calloc(1, sizeof(lprint_escpos_t));
-					// ESC/POS driver data
-  int		left_margin;		// Left margin in dots
-
-
-  (void)options;
-
-  // Initialize driver data...
-  lprint_escpos_init(job, escpos);
+  lprint_escpos_t *escpos;		// ESC/POS driver data
+  int		error;			// Thread creation error
 
-  papplJobSetData(job, escpos);
 
-  // Reset the printer...
-  if (papplDevicePuts(device, "\033@") < 0)
+  // Reset the printer and initialize driver data...
+  if (!lprint_escpos_start(job, options, device))
     return (false);
 
-  // Set the left margin based on the difference in the media width and the
-  // maximum supported by the printer (the roll is centered)...
-  left_margin = options->printer_resolution[0] * (escpos->max_width - options->media.size_width) / 2540 / 2;
-  if (left_margin < 0)
-    left_margin = 0;
+  // Start the background writer for graphics blocks, falling back on
+  // writing each block directly...
+  escpos                = (lprint_escpos_t *)papplJobGetData(job);
+  escpos->writer_device = device;
+
+  if ((error = pthread_create(&escpos->writer, NULL, (void *(*)(void *))lprint_escpos_writer, escpos)) != 0)
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Unable to create writer thread: %s", strerror(error));
+  else
+    escpos->writer_running = true;
 
-  return (papplDevicePrintf(device, "\035L%c%c", left_margin & 255, left_margin >> 8) > 0);
+  return (true);
 }
 
 
@@ -350,17 +752,31 @@ lprint_escpos_rstartpage(
 
   (void)page;
 
-  // Update status...
-  lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
+  // Update status, unless the printer is sending it to us...
+  if (!escpos->asb)
+    lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
 
   // Setup dithering buffer...
   if (!lprintDitherAlloc(&escpos->dither, job, options, /*head_width*/0, CUPS_CSPACE_K, 1.0, /*out_mirror*/false))
     return (false);
 
-  escpos->marked    = false;
-  escpos->feed      = 0;
-  escpos->max_lines = (int)(sizeof(escpos->buffer) / escpos->dither.out_width);
-  escpos->num_lines = 0;
+  // Printers that support automatic status back also support NV graphics, so
+  // send a fixed-size page header that can be recalled from NV memory...
+  escpos->marked       = false;
+  escpos->header       = escpos->asb && lprintGraphicsEnabled();
+  escpos->header_blank = 0;
+  escpos->feed         = 0;
+  escpos->num_lines    = 0;
+
+  if (escpos->header)
+  {
+    if ((escpos->max_lines = LPRINT_ESCPOS_BLOCK_SIZE / (int)escpos->dither.out_width) > LPRINT_ESCPOS_HEADER_LINES)
+      escpos->max_lines = LPRINT_ESCPOS_HEADER_LINES;
+  }
+  else
+  {
+    escpos->max_lines = lprint_escpos_block_lines(escpos);
+  }
 
   return (true);
 }
@@ -381,31 +797,57 @@ lprint_escpos_rwriteline(
   lprint_escpos_t	*escpos = (lprint_escpos_t *)papplJobGetData(job);
 					// ESC/POS driver data
   bool			ret = true;	// Return value
-  bool			blank;		// Is the current line blank?
+  bool			blank,		// Is the current line blank?
+			buffered = false;
+					// Is the current line in the buffer?
+  int			trailing = 0;	// Blank lines to feed after the block
+  unsigned char		command[8];	// Raster graphics command
 
 
   if (!lprintDitherLine(&escpos->dither, y, line))
+  {
     blank = true;
+  }
   else
+  {
     blank = !escpos->dither.output[0] && !memcmp(escpos->dither.output, escpos->dither.output + 1, escpos->dither.out_width - 1);
 
-  if (!blank)
-  {
-    // Not a blank line, print it...
-    if (!escpos->marked)
+    if (!blank || (escpos->header && escpos->marked))
     {
-      // Don't keep whitespace at the "top" of the receipt...
-      escpos->marked = true;
-      escpos->feed   = 0;
-    }
+      // Not a blank line or part of the page header, print it...
+      if (!escpos->marked)
+      {
+        // Don't keep whitespace at the "top" of the receipt...
+        escpos->marked = true;
+        escpos->feed   = 0;
+      }
 
-    memcpy(escpos->buffer + escpos->num_lines * escpos->dither.out_width, escpos->dither.output, escpos->dither.out_width);
-    escpos->num_lines ++;
+      memcpy(escpos->buffer + escpos->num_lines * escpos->dither.out_width, escpos->dither.output, escpos->dither.out_width);
+      escpos->num_lines ++;
+
+      if (blank)
+        escpos->header_blank ++;
+      else
+        escpos->header_blank = 0;
+
+      buffered = true;
+    }
   }
 
-  if ((blank && escpos->num_lines > 0) || escpos->num_lines >= escpos->max_lines || (y == options->header.cupsHeight && escpos->num_lines > 0))
+  if ((blank && !escpos->header && escpos->num_lines > 0) || escpos->num_lines >= escpos->max_lines || (y == options->header.cupsHeight && escpos->num_lines > 0))
   {
-    // Output current block of graphics...
+    if (escpos->header && y == options->header.cupsHeight)
+    {
+      // Page ended in the header, feed the trailing blank lines instead...
+      trailing             = escpos->header_blank;
+      escpos->num_lines    -= trailing;
+      escpos->header_blank = 0;
+    }
+
+    // Wait for the previous block to be sent, then output the current block
+    // of graphics...
+    ret &= lprint_escpos_wait(escpos);
+
     papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Writing %ux%d block with feed %d.", escpos->dither.out_width, escpos->num_lines, escpos->feed);
 
     while (escpos->feed > 0)
@@ -422,14 +864,43 @@ lprint_escpos_rwriteline(
       }
     }
 
-    ret &= papplDevicePrintf(device, "\035v00%c%c%c%c", escpos->dither.out_width & 255, (escpos->dither.out_width >> 8) & 255, escpos->num_lines & 255, (escpos->num_lines >> 8) & 255) > 0;
-
-    ret &= papplDeviceWrite(device, escpos->buffer, escpos->num_lines * escpos->dither.out_width) > 0;
+    // Recall the page header from NV memory when possible...
+    if (!escpos->header || !lprint_escpos_recall(job, device, escpos))
+    {
+      // Send the raster header with papplDeviceWrite since the sizes can
+      // contain nul bytes...
+      command[0] = 0x1d;
+      command[1] = 'v';
+      command[2] = '0';
+      command[3] = '0';
+      command[4] = (unsigned char)(escpos->dither.out_width & 255);
+      command[5] = (unsigned char)((escpos->dither.out_width >> 8) & 255);
+      command[6] = (unsigned char)(escpos->num_lines & 255);
+      command[7] = (unsigned char)((escpos->num_lines >> 8) & 255);
+
+      ret &= papplDeviceWrite(device, command, sizeof(command)) > 0;
+
+      lprint_escpos_write(escpos, device, (size_t)(escpos->num_lines * escpos->dither.out_width));
+    }
 
+    escpos->header    = false;
+    escpos->feed      = trailing;
     escpos->num_lines = 0;
+    escpos->max_lines = lprint_escpos_block_lines(escpos);
+
+    if (lprintSessionStatusQueued(job))
+    {
+      // Answer a queued status request between blocks...
+      ret &= lprint_escpos_wait(escpos);
+
+      if (escpos->asb)
+        lprint_escpos_asb_update(papplJobGetPrinter(job), job, device);
+      else
+        lprint_escpos_update_reasons(papplJobGetPrinter(job), job, device);
+    }
   }
 
-  if (blank)
+  if (blank && !buffered)
   {
     // Blank line, accumulate the feed...
     escpos->feed ++;
@@ -439,6 +910,80 @@ lprint_escpos_rwriteline(
 }
 
 
+//
+// 'lprint_escpos_start()' - Reset the printer and initialize driver data for a job.
+//
+// On failure the driver data is freed and the device session is ended.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_escpos_start(
+    pappl_job_t        *job,		// I - Job
+    pappl_pr_options_t *options,	// I - Job options
+    pappl_device_t     *device)		// I - Output device
+{
+  lprint_escpos_t *escpos;		// ESC/POS driver data
+  pappl_printer_t *printer = papplJobGetPrinter(job);
+					// Printer
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t *extdata;		// Driver extension data
+  int		left_margin;		// Left margin in dots
+  unsigned char	command[4];		// Left margin command
+
+
+  // Initialize driver data...
+  if ((escpos = (lprint_escpos_t *)calloc(1, sizeof(lprint_escpos_t))) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate memory for driver data: %s", strerror(errno));
+    return (false);
+  }
+
+  lprint_escpos_init(job, escpos);
+
+  papplJobSetData(job, escpos);
+
+  // Reset the printer...
+  if (papplDevicePuts(device, "\033@") < 0)
+  {
+    lprint_escpos_free(job, escpos);
+    return (false);
+  }
+
+  lprintSessionBegin(job, device);
+
+  // Enable automatic status back for the job, if supported...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata && !extdata->status_disabled)
+  {
+    if (!lprint_escpos_query_status(printer, job, device, extdata, &escpos->asb))
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "No status response from printer.");
+    else if (!escpos->asb)
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "No automatic status back response, polling paper sensor.");
+  }
+
+  // Set the left margin based on the difference in the media width and the
+  // maximum supported by the printer (the roll is centered)...
+  left_margin = options->printer_resolution[0] * (escpos->max_width - options->media.size_width) / 2540 / 2;
+  if (left_margin < 0)
+    left_margin = 0;
+
+  command[0] = 0x1d;
+  command[1] = 'L';
+  command[2] = (unsigned char)(left_margin & 255);
+  command[3] = (unsigned char)(left_margin >> 8);
+
+  if (papplDeviceWrite(device, command, sizeof(command)) < 0)
+  {
+    lprint_escpos_free(job, escpos);
+    return (false);
+  }
+
+  return (true);
+}
+
+
 //
 // 'lprint_escpos_status()' - Get current printer status.
 //
@@ -448,7 +993,8 @@ lprint_escpos_status(
     pappl_printer_t *printer)		// I - Printer
 {
   pappl_device_t	*device;	// Connection to printer
-  bool			ret;		// Return value
+  bool			ret,		// Return value
+			asb;		// Automatic status back enabled?
   pappl_pr_driver_data_t data;		// Driver data
   lprint_extdata_t	*extdata;	// Driver extension data
 
@@ -460,6 +1006,10 @@ lprint_escpos_status(
   if (extdata->status_disabled || extdata->status_time >= time(NULL))
     return (true);
 
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
   // No, try talking to the printer...
   if ((device = papplPrinterOpenDevice(printer)) == NULL)
   {
@@ -468,7 +1018,11 @@ lprint_escpos_status(
   }
 
   // Get the printer status...
-  ret = lprint_escpos_update_reasons(printer, NULL, device);
+  if ((ret = lprint_escpos_query_status(printer, NULL, device, extdata, &asb)) == true && asb)
+  {
+    // Disable automatic status back until the next update...
+    ret = papplDeviceWrite(device, "\035a\000", 3) > 0;
+  }
 
   papplPrinterCloseDevice(printer);
 
@@ -535,3 +1089,118 @@ lprint_escpos_update_reasons(
 
   return (true);
 }
+
+
+//
+// 'lprint_escpos_wait()' - Wait for the background writer to send the current block.
+//
+
+static bool				// O - `true` if all writes succeeded, `false` otherwise
+lprint_escpos_wait(
+    lprint_escpos_t *escpos)		// I - ESC/POS driver data
+{
+  bool	ret;				// Return value
+
+
+  pthread_mutex_lock(&escpos->writer_mutex);
+  while (escpos->writer_data)
+    pthread_cond_wait(&escpos->writer_cond, &escpos->writer_mutex);
+  ret = escpos->writer_ok;
+  pthread_mutex_unlock(&escpos->writer_mutex);
+
+  return (ret);
+}
+
+
+//
+// 'lprint_escpos_write()' - Send the current graphics buffer.
+//
+// The buffer is handed to the background writer and the other buffer is used
+// for the next block.  Call @link lprint_escpos_wait@ before writing anything
+// else to the device.
+//
+
+static void
+lprint_escpos_write(
+    lprint_escpos_t *escpos,		// I - ESC/POS driver data
+    pappl_device_t  *device,		// I - Output device
+    size_t          bytes)		// I - Number of bytes
+{
+  if (!escpos->writer_running)
+  {
+    // No writer thread, send it now...
+    if (papplDeviceWrite(device, escpos->buffer, bytes) < 0)
+      escpos->writer_ok = false;
+    return;
+  }
+
+  pthread_mutex_lock(&escpos->writer_mutex);
+  escpos->writer_data  = escpos->buffer;
+  escpos->writer_bytes = bytes;
+  pthread_cond_broadcast(&escpos->writer_cond);
+  pthread_mutex_unlock(&escpos->writer_mutex);
+
+  escpos->buffer = escpos->buffer == escpos->buffers[0] ? escpos->buffers[1] : escpos->buffers[0];
+}
+
+
+//
+// 'lprint_escpos_writer()' - Send graphics blocks in the background.
+//
+// The time taken for each block is used to update the write rate for
+// @link lprint_escpos_block_lines@.
+//
+
+static void *				// O - Thread exit status (not used)
+lprint_escpos_writer(
+    lprint_escpos_t *escpos)		// I - ESC/POS driver data
+{
+  const unsigned char	*data;		// Block to write
+  size_t		bytes;		// Size of block
+  bool			ok;		// Did the write succeed?
+  struct timeval	start,		// Start time
+			end;		// End time
+  double		secs;		// Elapsed time in seconds
+
+
+  pthread_mutex_lock(&escpos->writer_mutex);
+
+  for (;;)
+  {
+    while (!escpos->writer_data && !escpos->writer_stop)
+      pthread_cond_wait(&escpos->writer_cond, &escpos->writer_mutex);
+
+    if (!escpos->writer_data)
+      break;
+
+    data  = escpos->writer_data;
+    bytes = escpos->writer_bytes;
+
+    pthread_mutex_unlock(&escpos->writer_mutex);
+
+    gettimeofday(&start, NULL);
+    ok = papplDeviceWrite(escpos->writer_device, data, bytes) >= 0;
+    papplDeviceFlush(escpos->writer_device);
+    gettimeofday(&end, NULL);
+
+    secs = (end.tv_sec - start.tv_sec) + 0.000001 * (end.tv_usec - start.tv_usec);
+
+    pthread_mutex_lock(&escpos->writer_mutex);
+
+    if (ok && secs > 0.0)
+    {
+      if (escpos->write_rate > 0.0)
+        escpos->write_rate = 0.5 * (escpos->write_rate + bytes / secs);
+      else
+        escpos->write_rate = bytes / secs;
+    }
+
+    escpos->writer_ok   &= ok;
+    escpos->writer_data = NULL;
+    pthread_cond_broadcast(&escpos->writer_cond);
+  }
+
+  pthread_mutex_unlock(&escpos->writer_mutex);
+
+  return (NULL);
+}
@@ -10,6 +10,13 @@
 #include "lprint.h"
 
 
+//
+// Constants...
+//
+
+#define LPRINT_SLP_MAX_LINE	255	// Maximum bytes per PRINT/PRINTRLE command
+
+
 //
 // Local types...
 //
@@ -38,11 +45,25 @@ enum lprint_slp_cmd_e
   LPRINT_SLP_CMD_CHECK = 0xA5
 };
 
+enum lprint_slp_status_e		// STATUS command response bits
+{
+  LPRINT_SLP_STATUS_PAPER_OUT = 0x01,	// Out of labels
+  LPRINT_SLP_STATUS_HEAD_OPEN = 0x02,	// Print head/cover open
+  LPRINT_SLP_STATUS_HEAD_HOT = 0x04,	// Print head overheated
+  LPRINT_SLP_STATUS_ERROR = 0x08	// Hardware error
+};
+
 typedef struct lprint_sii_s		// SII driver data
 {
   unsigned	max_width;		// Maximum width in dots
   int		blanks;			// Blank lines
+  int		repeat;			// Number of times to repeat the last line
+  bool		have_last;		// Is the last line valid?
   lprint_dither_t dither;		// Dither buffer
+  unsigned char	last[LPRINT_SLP_MAX_LINE],
+					// Last line sent
+		rle[LPRINT_SLP_MAX_LINE];
+					// Run-length encoded line
 } lprint_sii_t;
 
 
@@ -87,7 +108,7 @@ static const char * const lprint_sii_media[] =
 //
 
 static unsigned	lprint_sii_get_max_width(const char *driver_name);
-static void	lprint_sii_init(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, lprint_sii_t *siidata);
+static void	lprint_sii_init(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, lprint_sii_t *siidata, bool new_session);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_sii_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
 #else
@@ -95,9 +116,15 @@ static bool	lprint_sii_printfile(pappl_job_t *job, pappl_pr_options_t *options,
 #endif // PAPPL_API_VERSION_MAJOR
 static bool	lprint_sii_rendjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_sii_rendpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
+static size_t	lprint_sii_rle_encode(lprint_sii_t *siidata);
 static bool	lprint_sii_rstartjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_sii_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_sii_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
+static void	lprint_sii_set_reasons(pappl_printer_t *printer, pappl_job_t *job, unsigned char status);
+static bool	lprint_sii_status(pappl_printer_t *printer);
+static bool	lprint_sii_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
+static bool	lprint_sii_wait_ready(pappl_job_t *job, pappl_device_t *device);
+static void	lprint_sii_write_repeat(pappl_device_t *device, lprint_sii_t *siidata);
 
 
 //
@@ -121,6 +148,7 @@ lprintSII(
   data->rstartjob_cb  = lprint_sii_rstartjob;
   data->rstartpage_cb = lprint_sii_rstartpage;
   data->rwriteline_cb = lprint_sii_rwriteline;
+  data->status_cb     = lprint_sii_status;
 
   // Vendor-specific format...
   data->format = LPRINT_SLP_MIMETYPE;
@@ -198,7 +226,8 @@ lprint_sii_init(
     pappl_job_t        *job,		// I - Job
     pappl_pr_options_t *options,	// I - Job options
     pappl_device_t     *device,		// I - Output device
-    lprint_sii_t       *siidata)	// O - Driver data
+    lprint_sii_t       *siidata,	// O - Driver data
+    bool               new_session)	// I - New device session?
 {
   const char	*driver_name = papplPrinterGetDriverName(papplJobGetPrinter(job));
 					// Driver name
@@ -212,10 +241,16 @@ lprint_sii_init(
   {
     case 100 :
     case 410 :
-	// Reset printer...
+        if (!new_session && lprint_sii_update_reasons(papplJobGetPrinter(job), job, device))
+        {
+          // Continuing a session with a ready printer, no reset needed...
+          break;
+        }
+
+	// Reset printer and wait for it to answer again...
 	papplDevicePrintf(device, "%c", LPRINT_SLP_CMD_RESET);
 	papplDeviceFlush(device);
-	sleep(3);
+	lprint_sii_wait_ready(job, device);
 	break;
 
     default :
@@ -248,7 +283,11 @@ lprint_sii_printfile(
 
 
   // Initialize driver data...
-  lprint_sii_init(job, options, device, &siidata);
+  lprint_sii_init(job, options, device, &siidata, /*new_session*/true);
+
+  // Raw data may leave the printer in any state, so the next job needs to
+  // reset it...
+  lprintSessionReset(papplJobGetPrinter(job));
 
   // Copy the raw file...
   papplJobSetImpressions(job, 1);
@@ -298,6 +337,7 @@ lprint_sii_rendjob(
   (void)options;
 
   free(siidata);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -323,11 +363,16 @@ lprint_sii_rendpage(
 
   // Write last line
   lprint_sii_rwriteline(job, options, device, options->header.cupsHeight, NULL);
+  lprint_sii_write_repeat(device, siidata);
 
   // Eject
   papplDevicePrintf(device, "%c", LPRINT_SLP_CMD_FORMFEED);
   papplDeviceFlush(device);
 
+  // Answer a queued status request between labels...
+  if (lprintSessionStatusQueued(job))
+    lprint_sii_update_reasons(papplJobGetPrinter(job), job, device);
+
   // Free memory and return...
   lprintDitherFree(&siidata->dither);
 
@@ -335,6 +380,55 @@ lprint_sii_rendpage(
 }
 
 
+//
+// 'lprint_sii_rle_encode()' - Run-length encode the current line.
+//
+// Each PRINTRLE byte holds a run of 1 to 127 dots, with the high bit set for
+// black dots.  Returns `0` if the encoded line would not be smaller than the
+// raw line.
+//
+
+static size_t				// O - Length of encoded line or `0` to use raw data
+lprint_sii_rle_encode(
+    lprint_sii_t *siidata)		// I - Driver data
+{
+  const unsigned char	*line = siidata->dither.output;
+					// Line to encode
+  unsigned		width = siidata->dither.out_width,
+					// Width in bytes
+			x,		// Current dot
+			count,		// Dots in current run
+			dots = 8 * width;
+					// Width in dots
+  unsigned char		*rleptr = siidata->rle,
+					// Pointer into encoded line
+			*rleend = siidata->rle + width - 1,
+					// End of encoded line
+			black,		// Color of current run (0x80 = black)
+			bit;		// Current bit
+
+
+  for (x = 0; x < dots;)
+  {
+    black = (line[x / 8] & (0x80 >> (x & 7))) ? 0x80 : 0x00;
+
+    for (count = 1, x ++; x < dots && count < 127; count ++, x ++)
+    {
+      bit = (line[x / 8] & (0x80 >> (x & 7))) ? 0x80 : 0x00;
+      if (bit != black)
+        break;
+    }
+
+    if (rleptr >= rleend)
+      return (0);			// Not smaller than raw data
+
+    *rleptr++ = black | (unsigned char)count;
+  }
+
+  return ((size_t)(rleptr - siidata->rle));
+}
+
+
 //
 // 'lprint_sii_rstartjob()' - Start a job.
 //
@@ -352,7 +446,7 @@ lprint_sii_rstartjob(
   (void)options;
 
   // Initialize driver data...
-  lprint_sii_init(job, options, device, siidata);
+  lprint_sii_init(job, options, device, siidata, lprintSessionBegin(job, device));
 
   return (true);
 }
@@ -383,9 +477,17 @@ lprint_sii_rstartpage(
   if (!lprintDitherAlloc(&siidata->dither, job, options, /*head_width*/0, CUPS_CSPACE_K, options->header.HWResolution[0] == 300 ? 1.2 : 1.0, /*out_mirror*/false))
     return (false);
 
+  if (siidata->dither.out_width > LPRINT_SLP_MAX_LINE)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Raster width %u is too large for printer.", options->header.cupsWidth);
+    return (false);
+  }
+
   papplDevicePrintf(device, "%c%c", LPRINT_SLP_CMD_MARGIN, (int)(12.7 * (lprint_sii_get_max_width(driver_name) - options->header.cupsWidth) / options->header.HWResolution[0]));
 
-  siidata->blanks = 0;
+  siidata->blanks    = 0;
+  siidata->repeat    = 0;
+  siidata->have_last = false;
 
   // Set darkness...
   if ((darkness = options->darkness_configured + options->print_darkness) < 0)
@@ -430,6 +532,9 @@ lprint_sii_rwriteline(
 {
   lprint_sii_t		*siidata = (lprint_sii_t *)papplJobGetData(job);
 					// SII driver data
+  unsigned		width = siidata->dither.out_width;
+					// Width of line in bytes
+  size_t		rle_bytes;	// Length of run-length encoded line
 
 
   // Dither...
@@ -443,6 +548,15 @@ lprint_sii_rwriteline(
     return (true);
   }
 
+  if (siidata->have_last && !siidata->blanks && !memcmp(siidata->dither.output, siidata->last, width))
+  {
+    // Same as the last line, repeat it...
+    siidata->repeat ++;
+    return (true);
+  }
+
+  lprint_sii_write_repeat(device, siidata);
+
   // Feed past any blank lines...
   while (siidata->blanks > 0)
   {
@@ -463,9 +577,178 @@ lprint_sii_rwriteline(
     }
   }
 
-  // Output bitmap data...
-  papplDevicePrintf(device, "%c%c", LPRINT_SLP_CMD_PRINT, (char)siidata->dither.out_width);
-  papplDeviceWrite(device, siidata->dither.output, siidata->dither.out_width);
+  // Output bitmap data using whichever encoding is smaller...
+  if (lprintCompression() != LPRINT_COMPRESSION_NONE && (rle_bytes = lprint_sii_rle_encode(siidata)) > 0)
+  {
+    papplDevicePrintf(device, "%c%c", LPRINT_SLP_CMD_PRINTRLE, (char)rle_bytes);
+    papplDeviceWrite(device, siidata->rle, rle_bytes);
+  }
+  else
+  {
+    papplDevicePrintf(device, "%c%c", LPRINT_SLP_CMD_PRINT, (char)width);
+    papplDeviceWrite(device, siidata->dither.output, width);
+  }
+
+  memcpy(siidata->last, siidata->dither.output, width);
+  siidata->have_last = true;
 
   return (true);
 }
+
+
+//
+// 'lprint_sii_set_reasons()' - Set "printer-state-reasons" from a status byte.
+//
+
+static void
+lprint_sii_set_reasons(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    unsigned char   status)		// I - Status byte
+{
+  pappl_preason_t	reasons;	// "printer-state-reasons" values
+
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Status is 0x%02X.", status);
+
+  reasons = PAPPL_PREASON_NONE;
+
+  if (status & LPRINT_SLP_STATUS_PAPER_OUT)
+    reasons |= PAPPL_PREASON_MEDIA_EMPTY;
+  if (status & LPRINT_SLP_STATUS_HEAD_OPEN)
+    reasons |= PAPPL_PREASON_COVER_OPEN;
+  if (status & (LPRINT_SLP_STATUS_HEAD_HOT | LPRINT_SLP_STATUS_ERROR))
+    reasons |= PAPPL_PREASON_OTHER;
+
+  if (job && (reasons & PAPPL_PREASON_MEDIA_EMPTY))
+    reasons |= PAPPL_PREASON_MEDIA_NEEDED;
+
+  papplPrinterSetReasons(printer, reasons, ~reasons);
+}
+
+
+//
+// 'lprint_sii_status()' - Get current printer status.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_sii_status(
+    pappl_printer_t *printer)		// I - Printer
+{
+  pappl_device_t	*device;	// Connection to printer
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+
+
+  // See if the status checks need to be suspended...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata->status_disabled || extdata->status_time >= time(NULL))
+    return (true);
+
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
+  // No, try talking to the printer...
+  if ((device = papplPrinterOpenDevice(printer)) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to open device for status.");
+    goto done;
+  }
+
+  // Get the printer status...
+  ret = lprint_sii_update_reasons(printer, NULL, device);
+
+  done:
+
+  papplPrinterCloseDevice(printer);
+
+  if (!ret)
+  {
+    // Don't try doing status updates for 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+    ret = true;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'lprint_sii_update_reasons()' - Update "printer-state-reasons" values.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_sii_update_reasons(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    pappl_device_t  *device)		// I - Connection to device
+{
+  unsigned char		status;		// Status byte
+
+
+  // Get the printer status...
+  if (papplDevicePrintf(device, "%c", LPRINT_SLP_CMD_STATUS) < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send status command.");
+    return (false);
+  }
+
+  if (papplDeviceRead(device, &status, 1) < 1)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read status response.");
+    return (false);
+  }
+
+  lprint_sii_set_reasons(printer, job, status);
+
+  return (true);
+}
+
+
+//
+// 'lprint_sii_wait_ready()' - Wait for the printer to finish a reset.
+//
+// The printer answers the STATUS command once the reset is complete, so a
+// single blocking status query waits for it.
+//
+
+static bool				// O - `true` if ready, `false` on timeout
+lprint_sii_wait_ready(
+    pappl_job_t    *job,		// I - Job
+    pappl_device_t *device)		// I - Output device
+{
+  if (lprint_sii_update_reasons(papplJobGetPrinter(job), job, device))
+    return (true);
+
+  if (!papplJobIsCanceled(job))
+    papplLogJob(job, PAPPL_LOGLEVEL_WARN, "Printer did not respond after reset, continuing.");
+
+  return (false);
+}
+
+
+//
+// 'lprint_sii_write_repeat()' - Send any pending repeats of the last line.
+//
+
+static void
+lprint_sii_write_repeat(
+    pappl_device_t *device,		// I - Output device
+    lprint_sii_t   *siidata)		// I - Driver data
+{
+  int	count;				// Repeat count for this command
+
+
+  while (siidata->repeat > 0)
+  {
+    if ((count = siidata->repeat) > 255)
+      count = 255;
+
+    papplDevicePrintf(device, "%c%c", LPRINT_SLP_CMD_REPEAT, (char)count);
+    siidata->repeat -= count;
+  }
+}
@@ -10,6 +10,14 @@
 #include "lprint.h"
 
 
+//
+// Constants...
+//
+
+#define LPRINT_TSPL_PCX_NAME	"LPRINT.PCX"
+					// Name of downloaded page image
+
+
 //
 // Local types...
 //
@@ -17,6 +25,10 @@
 typedef struct lprint_tspl_s		// TSPL driver data
 {
   lprint_dither_t dither;		// Dither buffer
+  unsigned char	*page;			// Page bitmap
+  unsigned	page_height;		// Height of page bitmap in lines
+  unsigned char	*pcx;			// PCX image buffer
+  size_t	pcx_size;		// Size of PCX image buffer
 } lprint_tspl_t;
 
 
@@ -92,6 +104,7 @@ static const char * const lprint_tspl_media[] =
 // Local functions...
 //
 
+static size_t	lprint_tspl_bitmap(pappl_device_t *device, lprint_tspl_t *tspl);
 #ifdef PAPPL_API_VERSION_MAJOR
 static bool	lprint_tspl_printfile(pappl_job_t *job, int doc_number, pappl_pr_options_t *options, pappl_device_t *device);
 #else
@@ -103,6 +116,7 @@ static bool	lprint_tspl_rstartjob(pappl_job_t *job, pappl_pr_options_t *options,
 static bool	lprint_tspl_rstartpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_tspl_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
 static bool	lprint_tspl_status(pappl_printer_t *printer);
+static bool	lprint_tspl_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
 
 
 //
@@ -174,6 +188,82 @@ lprintTSPL(
 }
 
 
+//
+// 'lprint_tspl_bitmap()' - Send the inked regions of the page bitmap.
+//
+// Each band of consecutive non-blank lines is sent as a BITMAP command that
+// is cropped to the inked bytes of the band.  Pass `NULL` for the device to
+// get the number of bytes that would be sent.
+//
+
+static size_t				// O - Number of bytes
+lprint_tspl_bitmap(
+    pappl_device_t *device,		// I - Output device or `NULL` to measure
+    lprint_tspl_t  *tspl)		// I - TSPL driver data
+{
+  unsigned	y,			// Current line
+		band_y,			// First line in band
+		band_left,		// Left-most inked byte in band
+		band_right,		// Right-most inked byte in band
+		left,			// Left-most inked byte in line
+		right,			// Right-most inked byte in line
+		out_width = tspl->dither.out_width;
+					// Width of page bitmap in bytes
+  unsigned char	white = tspl->dither.out_white;
+					// White byte value
+  const unsigned char *line;		// Current line in page bitmap
+  char		command[256];		// BITMAP command
+  int		cmdlen;			// Length of BITMAP command
+  size_t	total = 0;		// Total bytes
+
+
+  for (y = 0, line = tspl->page; y < tspl->page_height;)
+  {
+    // Skip blank lines...
+    for (left = 0; left < out_width && line[left] == white; left ++);
+
+    if (left >= out_width)
+    {
+      y ++;
+      line += out_width;
+      continue;
+    }
+
+    // Find the extent of this band...
+    for (band_y = y, band_left = out_width, band_right = 0; y < tspl->page_height; y ++, line += out_width)
+    {
+      for (left = 0; left < out_width && line[left] == white; left ++);
+
+      if (left >= out_width)
+        break;
+
+      for (right = out_width - 1; right > left && line[right] == white; right --);
+
+      if (left < band_left)
+        band_left = left;
+      if (right > band_right)
+        band_right = right;
+    }
+
+    // Send the band...
+    cmdlen = snprintf(command, sizeof(command), "BITMAP %u,%u,%u,%u,1,", 8 * band_left, band_y, band_right - band_left + 1, y - band_y);
+    total += (size_t)cmdlen + (size_t)(band_right - band_left + 1) * (y - band_y);
+
+    if (device)
+    {
+      const unsigned char *bandline;	// Current line in band
+
+      papplDeviceWrite(device, command, (size_t)cmdlen);
+
+      for (bandline = tspl->page + band_y * out_width; bandline < line; bandline += out_width)
+        papplDeviceWrite(device, bandline + band_left, band_right - band_left + 1);
+    }
+  }
+
+  return (total);
+}
+
+
 //
 // 'lprint_tspl_printfile()' - Print a file.
 //
@@ -241,7 +331,10 @@ lprint_tspl_rendjob(
   (void)options;
   (void)device;
 
+  free(tspl->page);
+  free(tspl->pcx);
   free(tspl);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -261,6 +354,11 @@ lprint_tspl_rendpage(
 {
   lprint_tspl_t	*tspl = (lprint_tspl_t *)papplJobGetData(job);
 					// TSPL driver data
+  size_t	bitmap_size,		// Size of BITMAP commands
+		pcx_limit,		// Maximum size of PCX image
+		pcx_size = 0;		// Size of PCX image
+  lprint_compression_t compression = lprintCompression();
+					// Graphics compression
 
 
   (void)page;
@@ -268,13 +366,53 @@ lprint_tspl_rendpage(
   // Write last line
   lprint_tspl_rwriteline(job, options, device, options->header.cupsHeight, NULL);
 
+  // Send the page image as a PCX download if that is smaller, otherwise use
+  // uncompressed BITMAP commands for the inked regions...
+  bitmap_size = lprint_tspl_bitmap(NULL, tspl);
+  pcx_limit   = tspl->pcx_size;
+
+  if (compression == LPRINT_COMPRESSION_AUTO)
+  {
+    // The PCX image also needs the DOWNLOAD, PUTPCX, and KILL commands...
+    size_t pcx_overhead = (size_t)snprintf(NULL, 0, "DOWNLOAD \"" LPRINT_TSPL_PCX_NAME "\",%u,", (unsigned)bitmap_size) + sizeof("\nPUTPCX 0,0,\"" LPRINT_TSPL_PCX_NAME "\"\n") - 1 + sizeof("KILL \"" LPRINT_TSPL_PCX_NAME "\"\n") - 1;
+					// Size of PCX commands
+
+    if (bitmap_size <= pcx_overhead)
+      pcx_limit = 0;
+    else if ((bitmap_size - pcx_overhead) < pcx_limit)
+      pcx_limit = bitmap_size - pcx_overhead;
+  }
+
+  if (compression != LPRINT_COMPRESSION_NONE && pcx_limit > 0 && (pcx_size = lprintPCXEncode(tspl->pcx, pcx_limit, tspl->page, tspl->dither.out_width, tspl->page_height, options->header.HWResolution[0])) > 0)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Sending %u byte PCX image.", (unsigned)pcx_size);
+
+    papplDevicePrintf(device, "DOWNLOAD \"" LPRINT_TSPL_PCX_NAME "\",%u,", (unsigned)pcx_size);
+    papplDeviceWrite(device, tspl->pcx, pcx_size);
+    papplDevicePuts(device, "\nPUTPCX 0,0,\"" LPRINT_TSPL_PCX_NAME "\"\n");
+  }
+  else
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Sending %u bytes of BITMAP images.", (unsigned)bitmap_size);
+
+    lprint_tspl_bitmap(device, tspl);
+  }
+
   // Eject
   if (options->header.NumCopies)
     papplDevicePrintf(device, "PRINT %u,1\n", options->header.NumCopies);
   else
     papplDevicePuts(device, "PRINT 1,1\n");
+
+  if (pcx_size > 0)
+    papplDevicePuts(device, "KILL \"" LPRINT_TSPL_PCX_NAME "\"\n");
+
   papplDeviceFlush(device);
 
+  // Answer a queued status request between labels...
+  if (lprintSessionStatusQueued(job))
+    lprint_tspl_update_reasons(papplJobGetPrinter(job), job, device);
+
   // Free memory and return...
   lprintDitherFree(&tspl->dither);
 
@@ -301,6 +439,7 @@ lprint_tspl_rstartjob(
 
   // Save driver data...
   papplJobSetData(job, tspl);
+  lprintSessionBegin(job, device);
 
   return (true);
 }
@@ -321,6 +460,7 @@ lprint_tspl_rstartpage(
 					// TSPL driver data
   int		darkness,		// Combined density
 		speed;			// Print speed
+  size_t	raw_size;		// Size of page bitmap
 
 
   (void)page;
@@ -329,6 +469,23 @@ lprint_tspl_rstartpage(
   if (!lprintDitherAlloc(&tspl->dither, job, options, /*head_width*/0, CUPS_CSPACE_W, options->header.HWResolution[0] == 300 ? 1.2 : 1.0, /*out_mirror*/false))
     return (false);
 
+  // Allocate the page bitmap and PCX buffers - PCX images are only used when
+  // they are smaller than the page bitmap...
+  free(tspl->page);
+  free(tspl->pcx);
+
+  tspl->page_height = options->header.cupsHeight;
+  raw_size          = (size_t)tspl->dither.out_width * tspl->page_height;
+  tspl->pcx_size    = LPRINT_PCX_HEADER + raw_size;
+
+  if ((tspl->page = malloc(raw_size)) == NULL || (tspl->pcx = malloc(tspl->pcx_size)) == NULL)
+  {
+    papplLogJob(job, PAPPL_LOGLEVEL_ERROR, "Unable to allocate page buffers.");
+    return (false);
+  }
+
+  memset(tspl->page, tspl->dither.out_white, raw_size);
+
   // Initialize the printer...
   if ((darkness = options->darkness_configured + options->print_darkness) < 0)
     darkness = 0;
@@ -376,9 +533,8 @@ lprint_tspl_rstartpage(
   if ((speed = options->print_speed / 2540) > 0)
     papplDevicePrintf(device, "SPEED %d\n", speed);
 
-  // Start the page image...
+  // Clear the image buffer, the page image is sent by lprint_tspl_rendpage...
   papplDevicePuts(device, "CLS\n");
-  papplDevicePrintf(device, "BITMAP 0,0,%u,%u,1,", tspl->dither.out_width, options->header.cupsHeight);
 
   return (true);
 }
@@ -401,10 +557,11 @@ lprint_tspl_rwriteline(
 
 
   (void)options;
+  (void)device;
 
-  // Dither and write the line...
-  if (lprintDitherLine(&tspl->dither, y, line))
-    papplDeviceWrite(device, tspl->dither.output, tspl->dither.out_width);
+  // Dither and save the line...
+  if (lprintDitherLine(&tspl->dither, y, line) && y > 0 && y <= tspl->page_height)
+    memcpy(tspl->page + (y - 1) * tspl->dither.out_width, tspl->dither.output, tspl->dither.out_width);
 
   return (true);
 }
@@ -418,7 +575,106 @@ static bool				// O - `true` on success, `false` on failure
 lprint_tspl_status(
     pappl_printer_t *printer)		// I - Printer
 {
-  (void)printer;
+  pappl_device_t	*device;	// Connection to printer
+  bool			ret = false;	// Return value
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+
+
+  // See if the status checks need to be suspended...
+  papplPrinterGetDriverData(printer, &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  if (extdata->status_disabled || extdata->status_time >= time(NULL))
+    return (true);
+
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
+  // No, try talking to the printer...
+  if ((device = papplPrinterOpenDevice(printer)) == NULL)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to open device for status.");
+    goto done;
+  }
+
+  // Get the printer status...
+  ret = lprint_tspl_update_reasons(printer, NULL, device);
+
+  done:
+
+  papplPrinterCloseDevice(printer);
+
+  if (!ret)
+  {
+    // Don't try doing status updates for 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+    ret = true;
+  }
+
+  return (ret);
+}
+
+
+//
+// 'lprint_tspl_update_reasons()' - Update "printer-state-reasons" values.
+//
+// The <ESC>!? command returns a single status byte:
+//
+//   0x01 - Head opened
+//   0x02 - Paper jam
+//   0x04 - Out of paper
+//   0x08 - Out of ribbon
+//   0x10 - Pause
+//   0x20 - Printing
+//   0x80 - Other error
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_tspl_update_reasons(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_job_t     *job,		// I - Current job or `NULL` if none
+    pappl_device_t  *device)		// I - Connection to device
+{
+  unsigned char		status;		// Status byte
+  pappl_preason_t	reasons;	// "printer-state-reasons" values
+
+
+  // Get the printer status...
+  if (papplDevicePuts(device, "\033!?") < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send status command.");
+    return (false);
+  }
+
+  if (papplDeviceRead(device, &status, 1) < 1)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read status response.");
+    return (false);
+  }
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Status is 0x%02X.", status);
+
+  reasons = PAPPL_PREASON_NONE;
+
+  if (status & 0x01)
+    reasons |= PAPPL_PREASON_COVER_OPEN;
+  if (status & 0x02)
+    reasons |= PAPPL_PREASON_MEDIA_JAM;
+  if (status & 0x04)
+    reasons |= PAPPL_PREASON_MEDIA_EMPTY;
+  if (status & 0x08)
+    reasons |= PAPPL_PREASON_MARKER_SUPPLY_EMPTY;
+  if (status & 0x10)
+    reasons |= PAPPL_PREASON_OFFLINE;
+  if (status & 0x80)
+    reasons |= PAPPL_PREASON_OTHER;
+
+  if (job && (reasons & PAPPL_PREASON_MEDIA_EMPTY))
+    reasons |= PAPPL_PREASON_MEDIA_NEEDED;
+
+  papplPrinterSetReasons(printer, reasons, ~reasons);
 
   return (true);
 }
@@ -10,6 +10,12 @@
 //
 
 #include "lprint.h"
+#ifndef _WIN32
+#  include <netdb.h>
+#  include <netinet/in.h>
+#  include <poll.h>
+#  include <sys/socket.h>
+#endif // !_WIN32
 
 
 // Define to 1 to use run-length encoding, 0 for uncompressed
@@ -42,6 +48,15 @@
 #define ZPL_WARNING_IN_RETRACT		0x00000400
 #define ZPL_WARNING_AT_BIN		0x00000800
 
+// Flow control settings
+#define ZPL_MAX_FORMATS			2	// Maximum formats queued in printer before we wait
+#define ZPL_MAX_WAIT			60	// Maximum time to wait for the receive buffer in seconds
+
+// Alert listener settings
+#define ZPL_ALERT_CODES			"ABEJRS"// ^SX condition types to report
+#define ZPL_MAX_ALERT_CLIENTS		32	// Maximum number of alert connections
+#define ZPL_MAX_ALERT_IDLE		60	// Maximum idle time for alert connections in seconds
+
 
 //
 // Local types...
@@ -53,13 +68,76 @@ typedef struct lprint_zpl_s		// ZPL driver data
   unsigned char	*comp_buffer;		// Compression buffer
   unsigned char *last_buffer;		// Last line
   int		last_buffer_set;	// Is the last line set?
+  unsigned	last_line;		// Number of lines through the last inked line
+  bool		flow_control;		// Use host status for flow control?
 } lprint_zpl_t;
 
+#ifndef _WIN32
+typedef struct lprint_zpl_alert_s	// ZPL alert connection
+{
+  int		fd;			// Socket
+  time_t	last_time;		// Time of last activity
+  char		addr[256];		// Numeric address of printer
+  char		buffer[1024];		// Line buffer
+  size_t	used;			// Bytes in line buffer
+} lprint_zpl_alert_t;
+
+typedef struct lprint_zpl_sender_s	// ZPL alert sender
+{
+  int		printer_id;		// Printer ID
+  char		addr[256];		// Numeric address of printer
+} lprint_zpl_sender_t;
+#endif // !_WIN32
+
+typedef struct lprint_zpl_hs_s		// ZPL host status
+{
+  int		length;			// Label length in dots
+  int		num_formats;		// Number of formats in receive buffer
+  bool		buffer_full;		// Is the receive buffer full?
+} lprint_zpl_hs_t;
+
 
 //
 // Local globals...
 //
 
+static char		lprint_zpl_alert_host[256] = "";
+					// Address printers send alerts to
+static int		lprint_zpl_alert_port = 0;
+					// Port printers send alerts to
+#ifndef _WIN32
+static pappl_system_t	*lprint_zpl_alert_system = NULL;
+					// System for alerts
+static int		lprint_zpl_alert_fds[2] = { -1, -1 };
+					// Alert listener sockets
+static int		lprint_zpl_num_alert_fds = 0;
+					// Number of alert listener sockets
+static pthread_mutex_t	lprint_zpl_sender_mutex = PTHREAD_MUTEX_INITIALIZER;
+					// Mutex for alert senders
+static size_t		lprint_zpl_num_senders = 0,
+					// Number of alert senders
+			lprint_zpl_alloc_senders = 0;
+					// Allocated alert senders
+static lprint_zpl_sender_t *lprint_zpl_senders = NULL;
+					// Alert senders
+
+static const struct
+{
+  const char		*keyword;	// Keyword in alert message
+  pappl_preason_t	reason;		// "printer-state-reasons" value
+} lprint_zpl_alerts[] =
+{					// Alert keywords and reasons
+  { "PAPER OUT",	PAPPL_PREASON_MEDIA_EMPTY },
+  { "MEDIA OUT",	PAPPL_PREASON_MEDIA_EMPTY },
+  { "RIBBON OUT",	PAPPL_PREASON_MARKER_SUPPLY_EMPTY },
+  { "HEAD OPEN",	PAPPL_PREASON_OTHER },
+  { "PAUSED",		PAPPL_PREASON_OFFLINE },
+  { "MEDIA LOW",	PAPPL_PREASON_MEDIA_LOW },
+  { "PAPER LOW",	PAPPL_PREASON_MEDIA_LOW },
+  { "RIBBON LOW",	PAPPL_PREASON_MARKER_SUPPLY_LOW }
+};
+#endif // !_WIN32
+
 static const char * const lprint_zpl_2inch_media[] =
 {					// Supported 2 inch media sizes
   "oe_1.25x0.25-label_1.25x0.25in",
@@ -173,6 +251,13 @@ static const char * const lprint_zpl_4inch_media[] =
 // Local functions...
 //
 
+#ifndef _WIN32
+static void	lprint_zpl_alert_printer(pappl_printer_t *printer, const char *message);
+static void	lprint_zpl_alert_process(lprint_zpl_alert_t *client, char *message);
+static void	*lprint_zpl_alert_run(void *data);
+static void	lprint_zpl_alert_sender(pappl_printer_t *printer, const char *uri);
+#endif // !_WIN32
+static bool	lprint_zpl_alert_setup(pappl_printer_t *printer, pappl_device_t *device);
 #if ZPL_COMPRESSION
 static bool	lprint_zpl_compress(pappl_device_t *device, unsigned char ch, unsigned count);
 #endif // ZPL_COMPRESSION
@@ -181,6 +266,7 @@ static bool	lprint_zpl_printfile(pappl_job_t *job, int doc_number, pappl_pr_opti
 #else
 static bool	lprint_zpl_printfile(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 #endif // PAPPL_API_VERSION_MAJOR
+static bool	lprint_zpl_host_status(pappl_printer_t *printer, pappl_device_t *device, lprint_zpl_hs_t *hs);
 static bool	lprint_zpl_rendjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
 static bool	lprint_zpl_rendpage(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned page);
 static bool	lprint_zpl_rstartjob(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device);
@@ -188,6 +274,7 @@ static bool	lprint_zpl_rstartpage(pappl_job_t *job, pappl_pr_options_t *options,
 static bool	lprint_zpl_rwriteline(pappl_job_t *job, pappl_pr_options_t *options, pappl_device_t *device, unsigned y, const unsigned char *line);
 static bool	lprint_zpl_status(pappl_printer_t *printer);
 static bool	lprint_zpl_update_reasons(pappl_printer_t *printer, pappl_job_t *job, pappl_device_t *device);
+static bool	lprint_zpl_wait_buffer(pappl_job_t *job, pappl_device_t *device);
 
 
 //
@@ -373,6 +460,453 @@ lprintZPLQueryDriver(
 }
 
 
+//
+// 'lprintZPLStartAlerts()' - Start listening for unsolicited ZPL alerts.
+//
+// Network ZPL printers are configured with the ^SX command to send alert
+// messages to "hostname:port".  The listener maps each alert to the printer
+// with a matching "socket" device URI and updates its "printer-state-reasons"
+// immediately.  Printer addresses are looked up when the printer is configured
+// to send alerts, so alerts from other hosts are ignored without any lookups.
+//
+
+bool					// O - `true` on success, `false` on error
+lprintZPLStartAlerts(
+    pappl_system_t *system,		// I - System
+    const char     *hostname,		// I - Address printers send alerts to
+    int            port)		// I - Port number
+{
+#ifdef _WIN32
+  (void)hostname;
+  (void)port;
+
+  papplLog(system, PAPPL_LOGLEVEL_ERROR, "ZPL alerts are not supported on this platform.");
+
+  return (false);
+
+#else
+  struct addrinfo	hints,		// Address lookup hints
+			*addrlist,	// List of addresses
+			*addr;		// Current address
+  char			portname[32];	// Port number string
+  int			fd,		// Listener socket
+			on = 1;		// Socket option value
+  pthread_t		tid;		// Listener thread ID
+  int			error;		// Thread creation error
+
+
+  // Create listener sockets for the wildcard addresses...
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_flags    = AI_PASSIVE;
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  snprintf(portname, sizeof(portname), "%d", port);
+
+  if (getaddrinfo(NULL, portname, &hints, &addrlist))
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to lookup ZPL alert port %d.", port);
+    return (false);
+  }
+
+  for (addr = addrlist; addr && lprint_zpl_num_alert_fds < (int)(sizeof(lprint_zpl_alert_fds) / sizeof(lprint_zpl_alert_fds[0])); addr = addr->ai_next)
+  {
+    if ((fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+      continue;
+
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#  ifdef IPV6_V6ONLY
+    if (addr->ai_family == AF_INET6)
+      setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+#  endif // IPV6_V6ONLY
+
+    if (bind(fd, addr->ai_addr, addr->ai_addrlen) || listen(fd, 16))
+    {
+      close(fd);
+      continue;
+    }
+
+    lprint_zpl_alert_fds[lprint_zpl_num_alert_fds ++] = fd;
+  }
+
+  freeaddrinfo(addrlist);
+
+  if (lprint_zpl_num_alert_fds == 0)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to listen for ZPL alerts on port %d: %s", port, strerror(errno));
+    return (false);
+  }
+
+  lprint_zpl_alert_system = system;
+  lprint_zpl_alert_port   = port;
+
+  if (hostname)
+    cupsCopyString(lprint_zpl_alert_host, hostname, sizeof(lprint_zpl_alert_host));
+  else
+    papplSystemGetHostName(system, lprint_zpl_alert_host, sizeof(lprint_zpl_alert_host));
+
+  // Start the listener thread...
+  if ((error = pthread_create(&tid, NULL, lprint_zpl_alert_run, NULL)) != 0)
+  {
+    papplLog(system, PAPPL_LOGLEVEL_ERROR, "Unable to create ZPL alert thread: %s", strerror(error));
+    lprint_zpl_alert_port = 0;
+    return (false);
+  }
+
+  pthread_detach(tid);
+
+  papplLog(system, PAPPL_LOGLEVEL_INFO, "Listening for ZPL alerts on port %d, printers will send to '%s'.", port, lprint_zpl_alert_host);
+
+  return (true);
+#endif // _WIN32
+}
+
+
+#ifndef _WIN32
+//
+// 'lprint_zpl_alert_printer()' - Apply an alert to a printer.
+//
+
+static void
+lprint_zpl_alert_printer(
+    pappl_printer_t *printer,		// I - Printer
+    const char      *message)		// I - Alert message
+{
+  size_t	i;			// Looping var
+
+
+  // Map the alert to "printer-state-reasons"...
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_INFO, "Alert: %s", message);
+
+  for (i = 0; i < (sizeof(lprint_zpl_alerts) / sizeof(lprint_zpl_alerts[0])); i ++)
+  {
+    if (!strstr(message, lprint_zpl_alerts[i].keyword))
+      continue;
+
+    if (strstr(message, "CLEAR"))
+      papplPrinterSetReasons(printer, PAPPL_PREASON_NONE, lprint_zpl_alerts[i].reason);
+    else
+      papplPrinterSetReasons(printer, lprint_zpl_alerts[i].reason, PAPPL_PREASON_NONE);
+  }
+}
+
+
+//
+// 'lprint_zpl_alert_process()' - Process an alert message.
+//
+
+static void
+lprint_zpl_alert_process(
+    lprint_zpl_alert_t *client,		// I - Alert connection
+    char               *message)	// I - Alert message
+{
+  char			*ptr;		// Pointer into message
+  size_t		i;		// Looping var
+  int			ids[16],	// IDs of printers at this address
+			num_ids = 0;	// Number of printer IDs
+  pappl_printer_t	*printer;	// Printer
+
+
+  // Find the printers at the sender's address, ignoring alerts from other
+  // hosts...
+  pthread_mutex_lock(&lprint_zpl_sender_mutex);
+  for (i = 0; i < lprint_zpl_num_senders && num_ids < (int)(sizeof(ids) / sizeof(ids[0])); i ++)
+  {
+    if (!strcmp(lprint_zpl_senders[i].addr, client->addr))
+      ids[num_ids ++] = lprint_zpl_senders[i].printer_id;
+  }
+  pthread_mutex_unlock(&lprint_zpl_sender_mutex);
+
+  if (num_ids == 0)
+    return;
+
+  // Alert messages are normally uppercase, but don't depend on it...
+  for (ptr = message; *ptr; ptr ++)
+    *ptr = (char)toupper(*ptr & 255);
+
+  papplLog(lprint_zpl_alert_system, PAPPL_LOGLEVEL_DEBUG, "ZPL alert from %s: %s", client->addr, message);
+
+  for (i = 0; i < (size_t)num_ids; i ++)
+  {
+    if ((printer = papplSystemFindPrinter(lprint_zpl_alert_system, NULL, ids[i], NULL)) != NULL)
+      lprint_zpl_alert_printer(printer, message);
+  }
+}
+
+
+//
+// 'lprint_zpl_alert_run()' - Listen for alert messages from printers.
+//
+
+static void *				// O - Thread exit status
+lprint_zpl_alert_run(void *data)	// I - Thread data (not used)
+{
+  int			i,		// Looping var
+			nfds;		// Number of poll entries
+  struct pollfd		pfds[2 + ZPL_MAX_ALERT_CLIENTS];
+					// Poll entries
+  lprint_zpl_alert_t	clients[ZPL_MAX_ALERT_CLIENTS],
+					// Alert connections
+			*client;	// Current connection
+  int			num_clients = 0;// Number of connections
+  struct sockaddr_storage addr;		// Peer address
+  socklen_t		addrlen;	// Length of peer address
+  int			fd;		// New connection
+  ssize_t		bytes;		// Bytes read
+  char			*start,		// Start of line
+			*end;		// End of line
+  time_t		curtime;	// Current time
+
+
+  (void)data;
+
+  // Wait for the system to start...
+  while (!papplSystemIsRunning(lprint_zpl_alert_system))
+    sleep(1);
+
+  while (papplSystemIsRunning(lprint_zpl_alert_system))
+  {
+    // Wait for new connections or alert data...
+    for (nfds = 0; nfds < lprint_zpl_num_alert_fds; nfds ++)
+    {
+      pfds[nfds].fd     = lprint_zpl_alert_fds[nfds];
+      pfds[nfds].events = POLLIN;
+    }
+
+    for (i = 0; i < num_clients; i ++, nfds ++)
+    {
+      pfds[nfds].fd     = clients[i].fd;
+      pfds[nfds].events = POLLIN;
+    }
+
+    if (poll(pfds, (nfds_t)nfds, 1000) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      papplLog(lprint_zpl_alert_system, PAPPL_LOGLEVEL_ERROR, "Unable to poll ZPL alert connections: %s", strerror(errno));
+      break;
+    }
+
+    curtime = time(NULL);
+
+    // Read alert data, working backwards so we can remove closed connections...
+    for (i = num_clients - 1; i >= 0; i --)
+    {
+      client = clients + i;
+
+      if (pfds[lprint_zpl_num_alert_fds + i].revents)
+      {
+        if ((bytes = recv(client->fd, client->buffer + client->used, sizeof(client->buffer) - client->used - 1, 0)) > 0)
+        {
+          client->used      += (size_t)bytes;
+          client->last_time = curtime;
+          client->buffer[client->used] = '\0';
+
+          // Process each complete line...
+          for (start = client->buffer; (end = strpbrk(start, "\r\n")) != NULL; start = end + 1)
+          {
+            *end = '\0';
+
+            if (*start)
+              lprint_zpl_alert_process(client, start);
+          }
+
+          if (start == client->buffer && client->used == (sizeof(client->buffer) - 1))
+          {
+            // Line too long, process what we have...
+            lprint_zpl_alert_process(client, start);
+            client->used = 0;
+          }
+          else
+          {
+            client->used -= (size_t)(start - client->buffer);
+            memmove(client->buffer, start, client->used);
+          }
+          continue;
+        }
+      }
+      else if ((curtime - client->last_time) < ZPL_MAX_ALERT_IDLE)
+      {
+        continue;
+      }
+
+      // Closed, errored, or idle connection, process any partial alert...
+      if (client->used > 0)
+      {
+        client->buffer[client->used] = '\0';
+        lprint_zpl_alert_process(client, client->buffer);
+      }
+
+      close(client->fd);
+
+      num_clients --;
+      if (i < num_clients)
+        memmove(client, client + 1, (size_t)(num_clients - i) * sizeof(lprint_zpl_alert_t));
+    }
+
+    // Accept new connections...
+    for (i = 0; i < lprint_zpl_num_alert_fds; i ++)
+    {
+      if (!(pfds[i].revents & POLLIN))
+        continue;
+
+      addrlen = sizeof(addr);
+      if ((fd = accept(lprint_zpl_alert_fds[i], (struct sockaddr *)&addr, &addrlen)) < 0)
+        continue;
+
+      if (num_clients >= ZPL_MAX_ALERT_CLIENTS)
+      {
+        papplLog(lprint_zpl_alert_system, PAPPL_LOGLEVEL_WARN, "Too many ZPL alert connections.");
+        close(fd);
+        continue;
+      }
+
+      client = clients + num_clients;
+
+      if (getnameinfo((struct sockaddr *)&addr, addrlen, client->addr, sizeof(client->addr), NULL, 0, NI_NUMERICHOST))
+      {
+        close(fd);
+        continue;
+      }
+
+      client->fd        = fd;
+      client->last_time = curtime;
+      client->used      = 0;
+
+      num_clients ++;
+    }
+  }
+
+  // Close all connections...
+  for (i = 0; i < num_clients; i ++)
+    close(clients[i].fd);
+
+  return (NULL);
+}
+
+
+//
+// 'lprint_zpl_alert_sender()' - Update the alert sender addresses for a printer.
+//
+// The printer's addresses are only looked up again when its device URI
+// changes.
+//
+
+static void
+lprint_zpl_alert_sender(
+    pappl_printer_t *printer,		// I - Printer
+    const char      *uri)		// I - Device URI
+{
+  pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
+  char			scheme[32],	// URI scheme
+			userpass[256],	// URI username:password
+			host[256],	// URI hostname
+			resource[256];	// URI resource
+  int			port;		// URI port number
+  struct addrinfo	hints,		// Address lookup hints
+			*addrlist,	// List of addresses
+			*addr;		// Current address
+  int			printer_id = papplPrinterGetID(printer);
+					// Printer ID
+  size_t		i, j;		// Looping vars
+  lprint_zpl_sender_t	*senders;	// New alert senders
+
+
+  papplPrinterGetDriverData(printer, &data);
+  if ((extdata = (lprint_extdata_t *)data.extension) == NULL || !strcmp(extdata->alert_uri, uri))
+    return;
+
+  // Look up the printer's addresses...
+  if (httpSeparateURI(HTTP_URI_CODING_ALL, uri, scheme, sizeof(scheme), userpass, sizeof(userpass), host, sizeof(host), &port, resource, sizeof(resource)) < HTTP_URI_STATUS_OK)
+    return;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host, NULL, &hints, &addrlist))
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to lookup alert address for '%s'.", host);
+    return;
+  }
+
+  pthread_mutex_lock(&lprint_zpl_sender_mutex);
+
+  // Remove the old addresses...
+  for (i = 0, j = 0; i < lprint_zpl_num_senders; i ++)
+  {
+    if (lprint_zpl_senders[i].printer_id != printer_id)
+      lprint_zpl_senders[j ++] = lprint_zpl_senders[i];
+  }
+
+  lprint_zpl_num_senders = j;
+
+  // Then add the new ones...
+  for (addr = addrlist; addr; addr = addr->ai_next)
+  {
+    if (lprint_zpl_num_senders >= lprint_zpl_alloc_senders)
+    {
+      if ((senders = realloc(lprint_zpl_senders, (lprint_zpl_alloc_senders + 16) * sizeof(lprint_zpl_sender_t))) == NULL)
+        break;
+
+      lprint_zpl_senders       = senders;
+      lprint_zpl_alloc_senders += 16;
+    }
+
+    if (!getnameinfo(addr->ai_addr, addr->ai_addrlen, lprint_zpl_senders[lprint_zpl_num_senders].addr, sizeof(lprint_zpl_senders[0].addr), NULL, 0, NI_NUMERICHOST))
+    {
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Accepting alerts from %s.", lprint_zpl_senders[lprint_zpl_num_senders].addr);
+      lprint_zpl_senders[lprint_zpl_num_senders ++].printer_id = printer_id;
+    }
+  }
+
+  pthread_mutex_unlock(&lprint_zpl_sender_mutex);
+
+  freeaddrinfo(addrlist);
+
+  cupsCopyString(extdata->alert_uri, uri, sizeof(extdata->alert_uri));
+}
+#endif // !_WIN32
+
+
+//
+// 'lprint_zpl_alert_setup()' - Configure a network printer to send alerts.
+//
+// The ^SX settings are not saved, so they are re-sent on each status update
+// to cover printers that were power-cycled.
+//
+
+static bool				// O - `true` if alerts are enabled, `false` otherwise
+lprint_zpl_alert_setup(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_device_t  *device)		// I - Connection to device
+{
+  const char	*uri = papplPrinterGetDeviceURI(printer);
+					// Device URI
+  const char	*code;			// Current condition type
+
+
+  // Only network printers can send alerts...
+  if (!lprint_zpl_alert_port || !uri || strncmp(uri, "socket://", 9))
+    return (false);
+
+#ifndef _WIN32
+  // Accept alerts from the printer's address...
+  lprint_zpl_alert_sender(printer, uri);
+#endif // !_WIN32
+
+  // Send alerts via TCP for each condition on set and clear...
+  papplDevicePuts(device, "^XA\n");
+  for (code = ZPL_ALERT_CODES; *code; code ++)
+    papplDevicePrintf(device, "^SX%c,D,Y,Y,%s,%d\n", *code, lprint_zpl_alert_host, lprint_zpl_alert_port);
+  papplDevicePuts(device, "^XZ\n");
+
+  return (true);
+}
+
+
 #if ZPL_COMPRESSION
 //
 // 'lprint_zpl_compress()' - Output a RLE run...
@@ -426,6 +960,86 @@ lprint_zpl_compress(
 #endif // ZPL_COMPRESSION
 
 
+//
+// 'lprint_zpl_host_status()' - Query the host status of the printer.
+//
+// The first line of the ~HS response looks like:
+//
+//   <STX>aaa,b,c,dddd,eee,f,g,h,iii,j,k,l<ETX>
+//
+// where "dddd" is the label length in dots, "eee" is the number of formats in
+// the receive buffer, and "f" is the receive buffer full flag.  The label
+// length is returned when the response is short or partial, however all three
+// fields are needed for flow control so `false` is returned.
+//
+
+static bool				// O - `true` on success, `false` on failure
+lprint_zpl_host_status(
+    pappl_printer_t *printer,		// I - Printer
+    pappl_device_t  *device,		// I - Connection to device
+    lprint_zpl_hs_t *hs)		// O - Host status
+{
+  char		buffer[1025],		// Response from printer
+		*bufptr,		// Pointer into response
+		*bufend,		// End of response buffer
+		*ptr,			// Pointer into new data
+		*line;			// First line of response
+  ssize_t	bytes;			// Bytes read
+  int		groups = 0,		// Number of complete lines
+		fields = 0,		// Number of fields in first line
+		buffer_full = 0;	// Buffer full flag
+
+
+  memset(hs, 0, sizeof(lprint_zpl_hs_t));
+
+  if (papplDevicePuts(device, "~HS\n") < 0)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send HS status command.");
+    return (false);
+  }
+
+  // The response is three <STX>...<ETX> lines that may arrive in any number
+  // of reads...
+  for (bufptr = buffer, bufend = buffer + sizeof(buffer) - 1; groups < 3 && bufptr < bufend; bufptr += bytes)
+  {
+    if ((bytes = papplDeviceRead(device, bufptr, (size_t)(bufend - bufptr))) <= 0)
+    {
+      papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read HS status response.");
+
+      if (bufptr == buffer)
+        return (false);
+
+      // Use what we have so far...
+      break;
+    }
+
+    for (ptr = bufptr; ptr < (bufptr + bytes); ptr ++)
+    {
+      if (*ptr == 0x03)
+        groups ++;
+    }
+  }
+
+  *bufptr = '\0';
+
+  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "HS returned '%s'.", buffer);
+
+  if ((line = strchr(buffer, 0x02)) != NULL)
+    fields = sscanf(line + 1, "%*d,%*d,%*d,%d,%d,%d", &hs->length, &hs->num_formats, &buffer_full);
+
+  hs->buffer_full = buffer_full != 0;
+
+  // All of the fields used for flow control are required...
+  if (groups < 3 || fields != 3)
+  {
+    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Bad HS status response.");
+    return (false);
+  }
+
+  return (true);
+}
+
+
 //
 // 'lprint_zpl_print()' - Print a file.
 //
@@ -501,6 +1115,7 @@ lprint_zpl_rendjob(
   (void)options;
 
   free(zpl);
+  lprintSessionEnd(job);
   papplJobSetData(job, NULL);
 
   return (true);
@@ -537,7 +1152,7 @@ lprint_zpl_rendpage(
   if (options->media.tracking)
   {
     if (options->media.tracking == PAPPL_MEDIA_TRACKING_CONTINUOUS)
-      papplDevicePrintf(device, "^LL%u\n^MNN\n", options->header.cupsHeight);
+      papplDevicePrintf(device, "^LL%u\n^MNN\n", lprintAutoLength(options, zpl->last_line));
     else if (options->media.tracking == PAPPL_MEDIA_TRACKING_WEB)
       papplDevicePuts(device, "^MNY\n");
     else
@@ -556,7 +1171,8 @@ lprint_zpl_rendpage(
   if (options->finishings & PAPPL_FINISHINGS_TRIM)
     papplDevicePuts(device, "^CN1\n");
 
-  // Update status...
+  // Update status, which also answers any queued status request...
+  lprintSessionStatusQueued(job);
   lprint_zpl_update_reasons(papplJobGetPrinter(job), job, device);
 
   // Free memory and return...
@@ -580,6 +1196,7 @@ lprint_zpl_rstartjob(
     pappl_device_t     *device)		// I - Output device
 {
   pappl_pr_driver_data_t data;		// Driver data
+  lprint_extdata_t	*extdata;	// Driver extension data
   int			darkness;	// Composite darkness value
   lprint_zpl_t		*zpl = (lprint_zpl_t *)calloc(1, sizeof(lprint_zpl_t));
 					// ZPL driver data
@@ -587,8 +1204,13 @@ lprint_zpl_rstartjob(
 
   // Initialize driver data...
   papplJobSetData(job, zpl);
+  lprintSessionBegin(job, device);
 
   papplPrinterGetDriverData(papplJobGetPrinter(job), &data);
+  extdata = (lprint_extdata_t *)data.extension;
+
+  // Only use host status for flow control if the printer supports it...
+  zpl->flow_control = !extdata->status_disabled;
 
   // label-mode-configured
   switch (data.mode_configured)
@@ -658,11 +1280,13 @@ lprint_zpl_rstartpage(
   double	out_gamma = 1.0;	// Output gamma correction
 
 
-  (void)page;
-
   // Update status...
   lprint_zpl_update_reasons(papplJobGetPrinter(job), job, device);
 
+  // Wait for the printer to work through previous labels...
+  if (page > 0 && !lprint_zpl_wait_buffer(job, device))
+    return (false);
+
   // Setup dither buffer...
   if (options->header.HWResolution[0] == 300)
     out_gamma = 1.2;
@@ -683,6 +1307,7 @@ lprint_zpl_rstartpage(
   zpl->comp_buffer     = malloc(2 * zpl->dither.out_width + 1);
   zpl->last_buffer     = malloc(zpl->dither.out_width);
   zpl->last_buffer_set = 0;
+  zpl->last_line       = 0;
 
   if (!zpl->comp_buffer || !zpl->last_buffer)
   {
@@ -722,9 +1347,13 @@ lprint_zpl_rwriteline(
   if (!lprintDitherLine(&zpl->dither, y, line))
     return (true);
 
+  // Track the last inked line (output line y - 1) for auto-length...
+  if (zpl->dither.output[0] || memcmp(zpl->dither.output, zpl->dither.output + 1, zpl->dither.out_width - 1))
+    zpl->last_line = y;
+
   // Determine whether this row is the same as the previous line.
   // If so, output a ':' and return...
-  if (zpl->last_buffer_set && !memcmp(zpl->dither.output, zpl->last_buffer, zpl->dither.out_width))
+  if (zpl->last_buffer_set && lprintCompression() != LPRINT_COMPRESSION_NONE && !memcmp(zpl->dither.output, zpl->last_buffer, zpl->dither.out_width))
   {
     papplDeviceWrite(device, ":", 1);
     return (true);
@@ -738,43 +1367,47 @@ lprint_zpl_rwriteline(
   }
 
 #if ZPL_COMPRESSION
-  // Send run-length compressed HEX data...
-  *compptr = '\0';
-
-  // Run-length compress the graphics...
-  for (compptr = zpl->comp_buffer + 1, repeat_char = zpl->comp_buffer[0], repeat_count = 1; *compptr; compptr ++)
+  if (lprintCompression() != LPRINT_COMPRESSION_NONE)
   {
-    if (*compptr == repeat_char)
-    {
-      repeat_count ++;
-    }
-    else
+    // Send run-length compressed HEX data...
+    *compptr = '\0';
+
+    // Run-length compress the graphics...
+    for (compptr = zpl->comp_buffer + 1, repeat_char = zpl->comp_buffer[0], repeat_count = 1; *compptr; compptr ++)
     {
-      lprint_zpl_compress(device, repeat_char, repeat_count);
-      repeat_char  = *compptr;
-      repeat_count = 1;
+      if (*compptr == repeat_char)
+      {
+        repeat_count ++;
+      }
+      else
+      {
+        lprint_zpl_compress(device, repeat_char, repeat_count);
+        repeat_char  = *compptr;
+        repeat_count = 1;
+      }
     }
-  }
 
-  if (repeat_char == '0')
-  {
-    // Handle 0's on the end of the line...
-    if (repeat_count & 1)
+    if (repeat_char == '0')
     {
-      repeat_count --;
-      papplDevicePuts(device, "0");
-    }
+      // Handle 0's on the end of the line...
+      if (repeat_count & 1)
+      {
+        repeat_count --;
+        papplDevicePuts(device, "0");
+      }
 
-    if (repeat_count > 0)
-      papplDevicePuts(device, ",");
+      if (repeat_count > 0)
+        papplDevicePuts(device, ",");
+    }
+    else
+      lprint_zpl_compress(device, repeat_char, repeat_count);
   }
   else
-    lprint_zpl_compress(device, repeat_char, repeat_count);
-
-#else
-  // Send uncompressed HEX data...
-  papplDeviceWrite(device, zpl->comp_buffer, compptr - zpl->comp_buffer);
 #endif // ZPL_COMPRESSION
+  {
+    // Send uncompressed HEX data...
+    papplDeviceWrite(device, zpl->comp_buffer, (size_t)(compptr - zpl->comp_buffer));
+  }
 
   // Save this line for the next round...
   memcpy(zpl->last_buffer, zpl->dither.output, zpl->dither.out_width);
@@ -793,9 +1426,9 @@ lprint_zpl_status(
     pappl_printer_t *printer)		// I - Printer
 {
   pappl_device_t	*device;	// Connection to printer
-  char			line[1025];	// Line from printer
-  ssize_t		bytes;		// Bytes read
-  int			length = 0;	// Label length
+  lprint_zpl_hs_t	hs;		// Host status
+  int			length;		// Label length
+  bool			alerts = false;	// Are alerts enabled?
   bool			ret = false;	// Return value
   pappl_pr_driver_data_t data;		// Driver data
   lprint_extdata_t	*extdata;	// Driver extension data
@@ -808,6 +1441,10 @@ lprint_zpl_status(
   if (extdata->status_disabled || extdata->status_time >= time(NULL))
     return (true);
 
+  // Let the current job answer if it is using the printer...
+  if (lprintSessionQueueStatus(printer))
+    return (true);
+
   // No, try talking to the printer...
   if ((device = papplPrinterOpenDevice(printer)) == NULL)
   {
@@ -819,24 +1456,14 @@ lprint_zpl_status(
   if (!lprint_zpl_update_reasons(printer, NULL, device))
     goto done;
 
-  // Query host status...
-  if (papplDevicePuts(device, "~HS\n") < 0)
-  {
-    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to send HS status command.");
-    goto done;
-  }
-
-  if ((bytes = papplDeviceRead(device, line, sizeof(line) - 1)) < 0)
-  {
-    papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "Unable to read HS status response.");
-    goto done;
-  }
-
-  line[bytes] = '\0';
+  // Make sure the printer is sending alerts to us, if enabled...
+  alerts = lprint_zpl_alert_setup(printer, device);
 
-  papplLogPrinter(printer, PAPPL_LOGLEVEL_DEBUG, "HS returned '%s'.", line);
+  // Query host status - the label length is optional so a short or partial
+  // response is not an error...
+  lprint_zpl_host_status(printer, device, &hs);
 
-  if (sscanf(line + 1, "%*d,%*d,%*d,%d", &length) == 1 && length > 11)
+  if ((length = hs.length) > 11)
   {
     // Auto-detect label length for ready media...
     // Round the length to the nearest dot and snap to the nearest 1/4"...
@@ -863,6 +1490,11 @@ lprint_zpl_status(
     extdata->status_time = time(NULL) + 300;
     ret = true;
   }
+  else if (alerts)
+  {
+    // Alerts report state changes as they happen, so only poll every 5 minutes...
+    extdata->status_time = time(NULL) + 300;
+  }
 
   return (ret);
 }
@@ -1019,3 +1651,61 @@ lprint_zpl_update_reasons(
 
   return (ret);
 }
+
+
+//
+// 'lprint_zpl_wait_buffer()' - Wait for room in the printer's receive buffer.
+//
+// This function polls the host status until the printer has at most
+// `ZPL_MAX_FORMATS` formats queued, so that the next label is always ready
+// without blocking on a full receive buffer.  Cancellation is checked between
+// polls.
+//
+
+static bool				// O - `true` to continue, `false` if canceled
+lprint_zpl_wait_buffer(
+    pappl_job_t    *job,		// I - Job
+    pappl_device_t *device)		// I - Connection to device
+{
+  lprint_zpl_t	*zpl = (lprint_zpl_t *)papplJobGetData(job);
+					// ZPL driver data
+  pappl_printer_t *printer = papplJobGetPrinter(job);
+					// Printer
+  lprint_zpl_hs_t hs;			// Host status
+  time_t	end;			// End time
+  useconds_t	delay = 100000;		// Delay between polls
+
+
+  if (!zpl->flow_control)
+    return (true);
+
+  for (end = time(NULL) + ZPL_MAX_WAIT; !papplJobIsCanceled(job);)
+  {
+    if (!lprint_zpl_host_status(printer, device, &hs))
+    {
+      // Printer doesn't support host status, stop trying for this job...
+      papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Disabling flow control.");
+      zpl->flow_control = false;
+      return (true);
+    }
+
+    if (!hs.buffer_full && hs.num_formats <= ZPL_MAX_FORMATS)
+      return (true);
+
+    if (time(NULL) >= end)
+    {
+      papplLogJob(job, PAPPL_LOGLEVEL_WARN, "Printer receive buffer still has %d formats queued, continuing.", hs.num_formats);
+      return (true);
+    }
+
+    papplLogJob(job, PAPPL_LOGLEVEL_DEBUG, "Waiting for printer, %d formats queued%s.", hs.num_formats, hs.buffer_full ? " and buffer full" : "");
+
+    // Back off up to 1 second between polls...
+    usleep(delay);
+
+    if (delay < 1000000)
+      delay *= 2;
+  }
+
+  return (false);
+}
@@ -40,7 +40,6 @@ static lprint_device_t	*copy_cb(lprint_device_t *src);
 static void		create_cb(pappl_printer_t *printer, void *cbdata);
 static bool		driver_cb(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
 static void		free_cb(lprint_device_t *src);
-static int		match_id(pappl_len_t num_did, cups_option_t *did, const char *match_id);
 static const char	*mime_cb(const unsigned char *header, size_t headersize, void *data);
 static bool		printer_cb(const char *device_info, const char *device_uri, const char *device_id, cups_array_t *devices);
 static pappl_system_t	*system_cb(pappl_len_t num_options, cups_option_t *options, void *data);
@@ -63,6 +62,8 @@ static pappl_pr_driver_t	lprint_drivers[] =
 #include "lprint-tspl.h"
 #include "lprint-zpl.h"
 };
+static lprint_drivers_t		*lprint_index = NULL;
+					// Driver index
 static char			lprint_spooldir[1024],
 					// Spool directory
 				lprint_statefile[1024];
@@ -77,7 +78,17 @@ int					// O - Exit status
 main(int  argc,				// I - Number of command-line arguments
      char *argv[])			// I - Command-line arguments
 {
-  return (papplMainloop(argc, argv, LPRINT_VERSION, /*footer_html*/NULL, (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])), lprint_drivers, autoadd_cb, driver_cb, /*subcmd_name*/NULL, /*subcmd_cb*/NULL, system_cb, /*usage_cb*/NULL, /*data*/NULL));
+  int	ret;				// Exit status
+
+
+  // Index the driver list for driver lookups and matching...
+  lprint_index = lprintDriversNew(sizeof(lprint_drivers) / sizeof(lprint_drivers[0]), lprint_drivers);
+
+  ret = papplMainloop(argc, argv, LPRINT_VERSION, /*footer_html*/NULL, (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])), lprint_drivers, autoadd_cb, driver_cb, /*subcmd_name*/NULL, /*subcmd_cb*/NULL, system_cb, /*usage_cb*/NULL, /*data*/NULL);
+
+  lprintDriversDelete(lprint_index);
+
+  return (ret);
 }
 
 
@@ -91,13 +102,11 @@ autoadd_cb(const char *device_info,	// I - Device information/name (not used)
            const char *device_id,	// I - IEEE-1284 device ID
            void       *cbdata)		// I - Callback data (System)
 {
-  size_t	i;			// Looping var
   pappl_len_t	num_did;		// Number of device ID key/value pairs
   cups_option_t	*did;			// Device ID key/value pairs
-  int		score,			// Current driver match score
-	    	best_score = 0;		// Best score
+  const pappl_pr_driver_t *driver;	// Matching driver
   const char	*make,			// Manufacturer name
-		*best_name = NULL;	// Best driver
+		*best_name;		// Best driver
   char		name[1024] = "";	// Driver name to match
 
 
@@ -113,27 +122,12 @@ autoadd_cb(const char *device_info,	// I - Device information/name (not used)
   if (make && !strncasecmp(make, "Zebra", 5))
     lprintZPLQueryDriver((pappl_system_t *)cbdata, device_uri, name, sizeof(name));
 
-  // Then loop through the driver list to find the best match...
-  for (i = 0; i < (sizeof(lprint_drivers) / sizeof(lprint_drivers[0])); i ++)
-  {
-    if (!strcmp(name, lprint_drivers[i].name))
-    {
-      // Matching driver name always the best match...
-      best_name = lprint_drivers[i].name;
-      break;
-    }
-
-    if (lprint_drivers[i].device_id)
-    {
-      // See if we have a matching device ID...
-      score = match_id(num_did, did, lprint_drivers[i].device_id);
-      if (score > best_score)
-      {
-        best_score = score;
-        best_name  = lprint_drivers[i].name;
-      }
-    }
-  }
+  // Matching driver name always the best match, otherwise use the index to
+  // find the best matching device ID...
+  if ((driver = lprintDriversFind(lprint_index, name)) != NULL)
+    best_name = driver->name;
+  else
+    best_name = lprintDriversMatch(lprint_index, num_did, did);
 
   // Clean up and return...
   cupsFreeOptions(num_did, did);
@@ -216,17 +210,12 @@ driver_cb(
 {
   bool		ret = false;		// Return value
   size_t	i;			// Looping var
+  const pappl_pr_driver_t *driver;	// Driver
 
 
   // Copy make/model info...
-  for (i = 0; i < (sizeof(lprint_drivers) / sizeof(lprint_drivers[0])); i ++)
-  {
-    if (!strcmp(driver_name, lprint_drivers[i].name))
-    {
-      cupsCopyString(data->make_and_model, lprint_drivers[i].description, sizeof(data->make_and_model));
-      break;
-    }
-  }
+  if ((driver = lprintDriversFind(lprint_index, driver_name)) != NULL)
+    cupsCopyString(data->make_and_model, driver->description, sizeof(data->make_and_model));
 
   // AirPrint version...
   data->num_features = 1;
@@ -350,78 +339,6 @@ free_cb(lprint_device_t *dev)		// I - Device entry
 }
 
 
-//
-// 'match_id()' - Compare two IEEE-1284 device IDs and return a score.
-//
-// The score is 2 for each exact match and 1 for a partial match in a comma-
-// delimited field.  Any non-match results in a score of 0.
-//
-
-static int				// O - Score
-match_id(pappl_len_t   num_did,		// I - Number of device ID key/value pairs
-         cups_option_t *did,		// I - Device ID key/value pairs
-         const char    *match_id)	// I - Driver's device ID match string
-{
-  pappl_len_t	i,			// Looping var
-		num_mid;		// Number of match ID key/value pairs
-  int		score = 0;		// Score
-  cups_option_t	*mid,			// Match ID key/value pairs
-		*current;		// Current key/value pair
-  const char	*value,			// Device ID value
-		*valptr;		// Pointer into value
-
-
-  // Parse the matching device ID into key/value pairs...
-  if ((num_mid = papplDeviceParseID(match_id, &mid)) == 0)
-    return (0);
-
-  // Loop through the match pairs to find matches (or not)
-  for (i = num_mid, current = mid; i > 0; i --, current ++)
-  {
-    if ((value = cupsGetOption(current->name, (cups_len_t)num_did, did)) == NULL)
-    {
-      // No match
-      score = 0;
-      break;
-    }
-
-    if (!strcasecmp(current->value, value))
-    {
-      // Full match!
-      score += 2;
-    }
-    else if ((valptr = strstr(value, current->value)) != NULL)
-    {
-      // Possible substring match, check
-      size_t mlen = strlen(current->value);
-					// Length of match value
-
-      if ((valptr == value || valptr[-1] == ',') && (!valptr[mlen] || valptr[mlen] == ','))
-      {
-        // Partial match!
-        score ++;
-      }
-      else
-      {
-        // No match
-        score = 0;
-        break;
-      }
-    }
-    else
-    {
-      // No match
-      score = 0;
-      break;
-    }
-  }
-
-  cupsFreeOptions((cups_len_t)num_mid, mid);
-
-  return (score);
-}
-
-
 //
 // 'mime_cb()' - MIME typing callback...
 //
@@ -488,7 +405,8 @@ system_cb(
 			*system_name;	// System name, if any
   char			oldfile[1024];	// Old configuration filename
   pappl_loglevel_t	loglevel;	// Log level
-  int			port = 0;	// Port number, if any
+  int			port = 0,	// Port number, if any
+			alert_port = 0;	// ZPL alert port number, if any
   pappl_soptions_t	soptions = PAPPL_SOPTIONS_MULTI_QUEUE | PAPPL_SOPTIONS_WEB_INTERFACE | PAPPL_SOPTIONS_WEB_LOG | PAPPL_SOPTIONS_WEB_SECURITY | PAPPL_SOPTIONS_WEB_TLS;
 					// System options
   static pappl_version_t versions[1] =	// Software versions
@@ -561,6 +479,17 @@ system_cb(
   spooldir    = cupsGetOption("spool-directory", (cups_len_t)num_options, options);
   system_name = cupsGetOption("system-name", (cups_len_t)num_options, options);
 
+  if ((val = cupsGetOption("auto-length", (cups_len_t)num_options, options)) != NULL)
+  {
+    if (!isdigit(*val & 255))
+    {
+      fprintf(stderr, "lprint: Bad auto-length value '%s'.\n", val);
+      return (NULL);
+    }
+    else
+      lprintAutoLengthSetMargin(atoi(val));
+  }
+
   if ((val = cupsGetOption("server-port", (cups_len_t)num_options, options)) != NULL)
   {
     if (!isdigit(*val & 255))
@@ -572,6 +501,39 @@ system_cb(
       port = atoi(val);
   }
 
+  if ((val = cupsGetOption("session-timeout", (cups_len_t)num_options, options)) != NULL)
+  {
+    if (!isdigit(*val & 255))
+    {
+      fprintf(stderr, "lprint: Bad session-timeout value '%s'.\n", val);
+      return (NULL);
+    }
+    else
+      lprintSessionSetTimeout(atoi(val));
+  }
+
+  if ((val = cupsGetOption("stored-graphics", (cups_len_t)num_options, options)) != NULL)
+  {
+    if (strcmp(val, "yes") && strcmp(val, "no"))
+    {
+      fprintf(stderr, "lprint: Bad stored-graphics value '%s'.\n", val);
+      return (NULL);
+    }
+    else
+      lprintGraphicsSetEnabled(!strcmp(val, "yes"));
+  }
+
+  if ((val = cupsGetOption("zpl-alert-port", (cups_len_t)num_options, options)) != NULL)
+  {
+    if (!isdigit(*val & 255))
+    {
+      fprintf(stderr, "lprint: Bad zpl-alert-port value '%s'.\n", val);
+      return (NULL);
+    }
+    else
+      alert_port = atoi(val);
+  }
+
   // Spool directory and state file...
   if ((val = getenv("SNAP_DATA")) != NULL)
   {
@@ -668,6 +630,17 @@ system_cb(
   if ((val = cupsGetOption("admin-group", (cups_len_t)num_options, options)) != NULL)
     papplSystemSetAdminGroup(system, val);
 
+  lprintStatusStart(system);
+
+  if (alert_port > 0)
+  {
+    // Listen for unsolicited alerts from network ZPL printers...
+    if ((val = cupsGetOption("zpl-alert-hostname", (cups_len_t)num_options, options)) == NULL)
+      val = hostname;
+
+    lprintZPLStartAlerts(system, val, alert_port);
+  }
+
   papplSystemSetMIMECallback(system, mime_cb, NULL);
   papplSystemAddMIMEFilter(system, LPRINT_TESTPAGE_MIMETYPE, "image/pwg-raster", lprintTestFilterCB, NULL);
 
@@ -12,6 +12,7 @@
 #  include "config.h"
 #  include <pappl/pappl.h>
 #  include <math.h>
+#  include <stdint.h>
 
 
 //
@@ -121,6 +122,11 @@ typedef ipp_copycb_t ipp_copy_cb_t;
 // Constants...
 //
 
+#  define LPRINT_MAX_GRAPHICS		16
+					// Maximum number of graphics stored in a printer
+#  define LPRINT_PCX_HEADER		128
+					// Size of a PCX file header
+
 #  define LPRINT_TESTPAGE_MIMETYPE	"application/vnd.lprint-test"
 #  define LPRINT_TESTPAGE_HEADER	"T*E*S*T*P*A*G*E*"
 
@@ -140,6 +146,20 @@ typedef ipp_copycb_t ipp_copy_cb_t;
 // Types...
 //
 
+typedef enum lprint_compression_e	// Graphics compression
+{
+  LPRINT_COMPRESSION_AUTO,		// Use the driver's default
+  LPRINT_COMPRESSION_NONE,		// Send uncompressed graphics
+  LPRINT_COMPRESSION_ALWAYS		// Send compressed graphics when the printer supports them
+} lprint_compression_t;
+
+typedef enum lprint_asb_e		// ESC/POS automatic status back support
+{
+  LPRINT_ASB_UNKNOWN,			// Not probed yet
+  LPRINT_ASB_SUPPORTED,			// Printer answers automatic status back
+  LPRINT_ASB_UNSUPPORTED		// Printer only answers the paper sensor query
+} lprint_asb_t;
+
 typedef struct lprint_dither_s		// Dithering state
 {
   pappl_dither_t dither;		// Dither matrix to use
@@ -158,12 +178,55 @@ typedef struct lprint_dither_s		// Dithering state
 		out_width;		// Output width in bytes
 } lprint_dither_t;
 
+typedef struct lprint_drivers_s lprint_drivers_t;
+					// Driver index
+
+typedef void (*lprint_graphics_cb_t)(int slot, void *cbdata);
+					// Delete a stored graphic callback
+
+typedef struct lprint_graphic_s		// Graphic stored in printer memory
+{
+  uint64_t	hash;			// Hash of bitmap, 0 if slot is unused
+  size_t	size;			// Size in printer memory, 0 if not stored
+  unsigned	used;			// Last use
+} lprint_graphic_t;
+
+typedef struct lprint_msize_s		// Indexed media size
+{
+  int		width,			// Width in hundredths of millimeters
+		length,			// Length in hundredths of millimeters
+		order;			// Position in media list
+  bool		custom;			// Custom or roll size?
+  const char	*name;			// Media size name
+} lprint_msize_t;
+
 typedef struct lprint_extdata_s		// Per-printer extensions data
 {
   char		custom_name[PAPPL_MAX_SOURCE][128];
 					// Custom media size names per source
   bool		status_disabled;	// Have we given up on getting status updates?
+  lprint_asb_t	asb;			// Automatic status back support (ESC/POS)
   time_t	status_time;		// Time until the next status attempt
+  time_t	status_next;		// Time of the next scheduled status poll
+  bool		status_busy;		// Is a status poll running?
+  pappl_job_t	*session_job;		// Job that owns the device connection, if any
+  pappl_device_t *session_device;	// Device connection owned by the job
+  bool		status_queued;		// Status requested while a job owns the device?
+  bool		session_clean;		// Did the last job end cleanly?
+  time_t	session_used;		// Time the last job ended
+  char		alert_uri[1024];	// Device URI of the last alert sender lookup
+  lprint_graphic_t graphics[LPRINT_MAX_GRAPHICS];
+					// Graphics seen or stored in printer memory
+  size_t	graphics_size;		// Total size of stored graphics
+  unsigned	graphics_used;		// Use counter for graphics
+  int		media_count;		// Number of media sizes when indexed
+  const char	*media_names[PAPPL_MAX_MEDIA];
+					// Media sizes when indexed
+  int		num_sizes;		// Number of indexed media sizes
+  lprint_msize_t sizes_width[PAPPL_MAX_MEDIA],
+					// Media sizes sorted by width and length
+		sizes_length[PAPPL_MAX_MEDIA];
+					// Media sizes sorted by length
 } lprint_extdata_t;
 
 
@@ -171,19 +234,49 @@ typedef struct lprint_extdata_s		// Per-printer extensions data
 // Functions...
 //
 
+extern unsigned	lprintAutoLength(pappl_pr_options_t *options, unsigned lines);
+extern bool	lprintAutoLengthEnabled(void);
+extern void	lprintAutoLengthSetMargin(int margin);
+
+extern lprint_compression_t lprintCompression(void);
+extern void	lprintCompressionSetMode(lprint_compression_t compression);
+
 extern bool	lprintDitherAlloc(lprint_dither_t *dither, pappl_job_t *job, pappl_pr_options_t *options, unsigned head_width, cups_cspace_t out_cspace, double out_gamma, bool out_mirror);
 extern void	lprintDitherFree(lprint_dither_t *dither);
 extern bool	lprintDitherLine(lprint_dither_t *dither, unsigned y, const unsigned char *line);
 
+extern void	lprintDriversDelete(lprint_drivers_t *index);
+extern const pappl_pr_driver_t *lprintDriversFind(lprint_drivers_t *index, const char *name);
+extern const char *lprintDriversMatch(lprint_drivers_t *index, pappl_len_t num_did, cups_option_t *did);
+extern lprint_drivers_t *lprintDriversNew(size_t num_drivers, pappl_pr_driver_t *drivers);
+
+extern void	lprintGraphicsClear(pappl_printer_t *printer);
+extern bool	lprintGraphicsEnabled(void);
+extern int	lprintGraphicsFind(pappl_printer_t *printer, uint64_t hash, bool *repeated);
+extern uint64_t	lprintGraphicsHash(const unsigned char *bitmap, unsigned width, unsigned height);
+extern void	lprintGraphicsSetEnabled(bool enabled);
+extern int	lprintGraphicsStore(pappl_printer_t *printer, uint64_t hash, size_t size, size_t max_size, lprint_graphics_cb_t cb, void *cbdata);
+
 extern bool	lprintMediaLoad(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
 extern const char *lprintMediaMatch(pappl_printer_t *printer, int source, int width, int length);
 extern bool	lprintMediaSave(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
 extern bool	lprintMediaUI(pappl_client_t *client, pappl_printer_t *printer);
 extern void	lprintMediaUpdate(pappl_printer_t *printer, pappl_pr_driver_data_t *data);
 
+extern size_t	lprintPCXEncode(unsigned char *dst, size_t dstsize, const unsigned char *bitmap, unsigned width, unsigned height, unsigned resolution);
+
 extern unsigned char *lprintPackBitsAlloc(size_t len);
 extern size_t	lprintPackBitsCompress(unsigned char *dst, const unsigned char *src, size_t len);
 
+extern bool	lprintSessionBegin(pappl_job_t *job, pappl_device_t *device);
+extern void	lprintSessionEnd(pappl_job_t *job);
+extern bool	lprintSessionQueueStatus(pappl_printer_t *printer);
+extern void	lprintSessionReset(pappl_printer_t *printer);
+extern void	lprintSessionSetTimeout(int timeout);
+extern bool	lprintSessionStatusQueued(pappl_job_t *job);
+
+extern void	lprintStatusStart(pappl_system_t *system);
+
 #  ifdef LPRINT_EXPERIMENTAL
 extern bool	lprintBrother(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
 extern bool	lprintCPCL(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *driver_data, ipp_t **driver_attrs, void *cbdata);
@@ -201,6 +294,7 @@ extern const char *lprintTestPageCB(pappl_printer_t *printer, char *buffer, size
 extern bool	lprintTSPL(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
 extern bool	lprintZPL(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
 extern void	lprintZPLQueryDriver(pappl_system_t *system, const char *device_uri, char *name, size_t namesize);
+extern bool	lprintZPLStartAlerts(pappl_system_t *system, const char *hostname, int port);
 
 
 #endif // !LPRINT_H
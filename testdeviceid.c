@@ -0,0 +1,364 @@
+//
+// Driver matching unit test and benchmark program
+//
+// Usage:
+//
+//   ./testdeviceid [COUNT]
+//
+// Copyright © 2026 by Michael R Sweet
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+
+#include "lprint.h"
+#include "test.h"
+
+
+//
+// Local functions...
+//
+
+static const char *linear_match(pappl_len_t num_did, cups_option_t *did);
+static char	*make_device_id(unsigned n, char *buffer, size_t bufsize);
+static int	match_id(pappl_len_t num_did, cups_option_t *did, const char *match_id);
+static unsigned	next_rand(void);
+
+
+//
+// Local globals...
+//
+
+static pappl_pr_driver_t	lprint_drivers[] =
+{					// Driver list
+#ifdef LPRINT_EXPERIMENTAL
+#  include "lprint-brother.h"
+#  include "lprint-cpcl.h"
+#endif // LPRINT_EXPERIMENTAL
+#include "lprint-dymo.h"
+#include "lprint-epl2.h"
+#include "lprint-escpos.h"
+#include "lprint-sii.h"
+#include "lprint-tspl.h"
+#include "lprint-zpl.h"
+};
+static unsigned			rand_state = 1;
+					// Pseudo-random number state
+
+
+//
+// 'main()' - Main entry for test program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int		i,			// Looping var
+		num_ids;		// Number of device IDs
+  size_t	j,			// Looping var
+		num_drivers = sizeof(lprint_drivers) / sizeof(lprint_drivers[0]);
+					// Number of drivers
+  lprint_drivers_t *index;		// Driver index
+  char		**ids,			// Device IDs
+		buffer[1024];		// Device ID buffer
+  pappl_len_t	*num_dids;		// Number of key/value pairs for each device ID
+  cups_option_t	**dids;			// Key/value pairs for each device ID
+  const char	**names,		// Driver names from linear match
+		*name;			// Driver name from index
+  int		matched = 0;		// Number of matching device IDs
+  struct timeval start,			// Start time
+		end;			// End time
+  double	linear_secs,		// Elapsed seconds for linear matching
+		index_secs;		// Elapsed seconds for indexed matching
+
+
+  // See if the number of device IDs is on the command-line...
+  if (argc == 1)
+  {
+    num_ids = 10000;
+  }
+  else if (argc > 2 || (num_ids = atoi(argv[1])) < 1)
+  {
+    fputs("Usage: ./testdeviceid [COUNT]\n", stderr);
+    return (1);
+  }
+
+  // Create the index...
+  testBegin("lprintDriversNew(%u drivers)", (unsigned)num_drivers);
+  if ((index = lprintDriversNew(num_drivers, lprint_drivers)) != NULL)
+    testEnd(true);
+  else
+    testEndMessage(false, "%s", strerror(errno));
+
+  // Look up every driver by name...
+  testBegin("lprintDriversFind");
+  for (j = 0; j < num_drivers; j ++)
+  {
+    if (lprintDriversFind(index, lprint_drivers[j].name) != lprint_drivers + j)
+      break;
+  }
+
+  if (j < num_drivers)
+    testEndMessage(false, "unable to find '%s'", lprint_drivers[j].name);
+  else if (lprintDriversFind(index, "no-such-driver"))
+    testEndMessage(false, "found 'no-such-driver'");
+  else
+    testEnd(true);
+
+  // Generate synthetic device IDs...
+  ids      = (char **)calloc((size_t)num_ids, sizeof(char *));
+  num_dids = (pappl_len_t *)calloc((size_t)num_ids, sizeof(pappl_len_t));
+  dids     = (cups_option_t **)calloc((size_t)num_ids, sizeof(cups_option_t *));
+  names    = (const char **)calloc((size_t)num_ids, sizeof(const char *));
+
+  if (!ids || !num_dids || !dids || !names)
+  {
+    perror("testdeviceid");
+    return (1);
+  }
+
+  for (i = 0; i < num_ids; i ++)
+  {
+    ids[i]      = strdup(make_device_id((unsigned)i, buffer, sizeof(buffer)));
+    num_dids[i] = papplDeviceParseID(ids[i], dids + i);
+  }
+
+  // Match using a linear scan of the driver list...
+  testBegin("match_id(%d device IDs)", num_ids);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < num_ids; i ++)
+  {
+    if ((names[i] = linear_match(num_dids[i], dids[i])) != NULL)
+      matched ++;
+  }
+  gettimeofday(&end, NULL);
+
+  linear_secs = (double)(end.tv_sec - start.tv_sec) + 0.000001 * (double)(end.tv_usec - start.tv_usec);
+
+  testEndMessage(true, "%d matches, %.3f us/ID", matched, 1000000.0 * linear_secs / num_ids);
+
+  // Match using the index and compare...
+  testBegin("lprintDriversMatch(%d device IDs)", num_ids);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < num_ids; i ++)
+  {
+    if ((name = lprintDriversMatch(index, num_dids[i], dids[i])) != names[i])
+      break;
+  }
+  gettimeofday(&end, NULL);
+
+  index_secs = (double)(end.tv_sec - start.tv_sec) + 0.000001 * (double)(end.tv_usec - start.tv_usec);
+
+  if (i < num_ids)
+    testEndMessage(false, "got '%s', expected '%s' for \"%s\"", name ? name : "(null)", names[i] ? names[i] : "(null)", ids[i]);
+  else
+    testEndMessage(true, "%.3f us/ID, %.1fx faster", 1000000.0 * index_secs / num_ids, index_secs > 0.0 ? linear_secs / index_secs : 0.0);
+
+  // Clean up...
+  for (i = 0; i < num_ids; i ++)
+  {
+    cupsFreeOptions((cups_len_t)num_dids[i], dids[i]);
+    free(ids[i]);
+  }
+
+  free(ids);
+  free(num_dids);
+  free(dids);
+  free(names);
+
+  lprintDriversDelete(index);
+
+  return (testsPassed ? 0 : 1);
+}
+
+
+//
+// 'linear_match()' - Find the best driver using a linear scan of the driver list.
+//
+
+static const char *			// O - Driver name or `NULL` for none
+linear_match(pappl_len_t   num_did,	// I - Number of device ID key/value pairs
+             cups_option_t *did)	// I - Device ID key/value pairs
+{
+  size_t	i;			// Looping var
+  int		score,			// Current driver match score
+		best_score = 0;		// Best score
+  const char	*best_name = NULL;	// Best driver
+
+
+  for (i = 0; i < (sizeof(lprint_drivers) / sizeof(lprint_drivers[0])); i ++)
+  {
+    if (lprint_drivers[i].device_id)
+    {
+      score = match_id(num_did, did, lprint_drivers[i].device_id);
+      if (score > best_score)
+      {
+        best_score = score;
+        best_name  = lprint_drivers[i].name;
+      }
+    }
+  }
+
+  return (best_name);
+}
+
+
+//
+// 'make_device_id()' - Make a synthetic IEEE-1284 device ID.
+//
+// Most device IDs are based on a driver's match string, with the keys
+// reordered, extra keys and comma-delimited values added, or the model
+// changed so it no longer matches.  The rest are from other printers.
+//
+
+static char *				// O - Device ID
+make_device_id(unsigned n,		// I - Device ID number
+               char     *buffer,	// I - Buffer
+               size_t   bufsize)	// I - Size of buffer
+{
+  const char	*match;			// Driver's match string
+  pappl_len_t	i,			// Looping var
+		num_pairs;		// Number of key/value pairs
+  cups_option_t	*pairs;			// Key/value pairs
+  char		*bufptr,		// Pointer into buffer
+		*bufend = buffer + bufsize;
+					// End of buffer
+  unsigned	variant = next_rand() % 8;
+					// Kind of device ID
+  static const char * const others[] =	// Device IDs from other printers
+  {
+    "MFG:HP;MDL:LaserJet 4000;CMD:PCL,PJL,POSTSCRIPT;CLS:PRINTER;",
+    "MFG:EPSON;CMD:ESCPL2,BDC,D4,END4;MDL:ET-2850 Series;CLS:PRINTER;",
+    "MANUFACTURER:Brother;COMMAND SET:PJL,PCL,PCLXL,URF;MODEL:HL-L2350DW series;",
+    "MFG:Canon;CMD:URF,PDF,PWG;MDL:MF740C;CLS:PRINTER;",
+    "MFG:Generic;MDL:Label Printer %u;CMD:RAW;"
+  };
+
+
+  if (variant == 0)
+  {
+    // Another printer...
+    snprintf(buffer, bufsize, others[next_rand() % (sizeof(others) / sizeof(others[0]))], n);
+    return (buffer);
+  }
+
+  // Pick a driver with a match string...
+  do
+  {
+    match = lprint_drivers[next_rand() % (sizeof(lprint_drivers) / sizeof(lprint_drivers[0]))].device_id;
+  }
+  while (!match || !*match);
+
+  num_pairs = papplDeviceParseID(match, &pairs);
+
+  // Copy the key/value pairs, starting at a random pair...
+  *buffer = '\0';
+
+  for (i = 0, bufptr = buffer; i < num_pairs; i ++, bufptr += strlen(bufptr))
+  {
+    cups_option_t *pair = pairs + (variant == 1 ? (i + n) % num_pairs : i);
+					// Current pair
+
+    if (variant == 2 && (!strcasecmp(pair->name, "MDL") || !strcasecmp(pair->name, "MODEL")))
+      snprintf(bufptr, (size_t)(bufend - bufptr), "%s:%s-%u;", pair->name, pair->value, n);
+    else if (variant == 3 && (!strcasecmp(pair->name, "CMD") || !strcasecmp(pair->name, "COMMAND SET")))
+      snprintf(bufptr, (size_t)(bufend - bufptr), "%s:PJL,%s,RAW;", pair->name, pair->value);
+    else
+      snprintf(bufptr, (size_t)(bufend - bufptr), "%s:%s;", pair->name, pair->value);
+  }
+
+  if (variant == 4)
+    snprintf(bufptr, (size_t)(bufend - bufptr), "CLS:PRINTER;SN:%08u;", n);
+
+  cupsFreeOptions((cups_len_t)num_pairs, pairs);
+
+  return (buffer);
+}
+
+
+//
+// 'match_id()' - Compare two IEEE-1284 device IDs and return a score.
+//
+// This is the original matching code, which parses the driver's match string
+// every time.
+//
+
+static int				// O - Score
+match_id(pappl_len_t   num_did,		// I - Number of device ID key/value pairs
+         cups_option_t *did,		// I - Device ID key/value pairs
+         const char    *match_id)	// I - Driver's device ID match string
+{
+  pappl_len_t	i,			// Looping var
+		num_mid;		// Number of match ID key/value pairs
+  int		score = 0;		// Score
+  cups_option_t	*mid,			// Match ID key/value pairs
+		*current;		// Current key/value pair
+  const char	*value,			// Device ID value
+		*valptr;		// Pointer into value
+
+
+  // Parse the matching device ID into key/value pairs...
+  if ((num_mid = papplDeviceParseID(match_id, &mid)) == 0)
+    return (0);
+
+  // Loop through the match pairs to find matches (or not)
+  for (i = num_mid, current = mid; i > 0; i --, current ++)
+  {
+    if ((value = cupsGetOption(current->name, (cups_len_t)num_did, did)) == NULL)
+    {
+      // No match
+      score = 0;
+      break;
+    }
+
+    if (!strcasecmp(current->value, value))
+    {
+      // Full match!
+      score += 2;
+    }
+    else if ((valptr = strstr(value, current->value)) != NULL)
+    {
+      // Possible substring match, check
+      size_t mlen = strlen(current->value);
+					// Length of match value
+
+      if ((valptr == value || valptr[-1] == ',') && (!valptr[mlen] || valptr[mlen] == ','))
+      {
+        // Partial match!
+        score ++;
+      }
+      else
+      {
+        // No match
+        score = 0;
+        break;
+      }
+    }
+    else
+    {
+      // No match
+      score = 0;
+      break;
+    }
+  }
+
+  cupsFreeOptions((cups_len_t)num_mid, mid);
+
+  return (score);
+}
+
+
+//
+// 'next_rand()' - Return a repeatable pseudo-random number.
+//
+
+static unsigned				// O - Random number
+next_rand(void)
+{
+  rand_state = rand_state * 1103515245 + 12345;
+
+  return ((rand_state >> 16) & 0x7fff);
+}
@@ -0,0 +1,985 @@
+//
+// Driver benchmark program
+//
+// Copyright © 2026 by Michael R Sweet
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// Usage:
+//
+//   ./testdrivers [OPTIONS] [DRIVER-NAME ...] >RESULTS.csv
+//
+// Options:
+//
+//   --baseline RESULTS.csv       Compare against previous results
+//   --compression                Report the bytes sent for each graphics compression
+//   --count LABELS               Number of labels to print for each file (default 10)
+//   --device URI                 Send the output to URI instead of /dev/null
+//   --file INPUT.pwg             Use the specified PWG raster file (repeatable)
+//   --help                       Show program help
+//   --link NAME=BITS/SEC[:BITS]  Add a link for "--compression", with BITS per byte (default 8)
+//   --output DIRECTORY           Save the output of each driver in DIRECTORY
+//   --status                     Queue a status request before each label
+//   --threshold PERCENT          Allowed regression against the baseline (default 10)
+//
+// Each driver is run through its raster callbacks (rstartjob, rstartpage,
+// rwriteline, rendpage, and rendjob) at each of its resolutions, using the
+// first page of each input file scaled to the driver's default media size.
+// The results are written as CSV to the standard output.
+//
+// With "--status", each label is printed with a status request queued the way
+// the status poll scheduler does for a printer that is processing a job, and
+// drivers that do not answer it by the start of the next label fail.  A
+// request that is still queued after the last label is left for the next
+// status poll and is not counted.  Use "--device"
+// with the "testsimulator" program to see the answers, for example:
+//
+//   ./testsimulator --lang zpl --fault media-out --fault-after 2 &
+//   ./testdrivers --count 4 --device socket://127.0.0.1:9100 --status zpl_2inch-203dpi-dt
+//
+// With "--compression", each driver instead prints one label for each input
+// file and resolution with each graphics compression setting: "auto" for the
+// driver's own choice, "none" for uncompressed graphics, and "always" for
+// compressed graphics where the printer supports them.  An unreported label
+// is printed first to absorb any one-time printer setup.  For each label the
+// number of bytes, the compression ratio against the raw 1-bit bitmap, and the
+// estimated time to send the bytes over each link are reported.  The default
+// links are "serial-9600=9600:10" (8N1 framing), "usb-fs=12M", and
+// "wifi=20M".
+//
+
+#include "lprint.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+
+//
+// Local types...
+//
+
+typedef struct testfile_s		// Input file
+{
+  const char		*filename;	// Filename
+  cups_page_header_t	header;		// Page header
+  unsigned char		*pixels;	// Page pixels
+} testfile_t;
+
+typedef struct testlink_s		// Link for "--compression"
+{
+  const char	*name;			// Name
+  double	rate;			// Bits per second
+  int		bits;			// Bits per byte
+} testlink_t;
+
+typedef struct testresult_s		// Benchmark result
+{
+  char		driver[256];		// Driver name
+  int		xdpi,			// Horizontal resolution
+		ydpi;			// Vertical resolution
+  char		file[256];		// Input file basename
+  int		labels;			// Number of labels
+  double	labels_per_sec,		// Labels per second
+		ns_per_line;		// Nanoseconds per raster line
+  size_t	raw_bytes,		// Raw 1-bit bytes per label
+		bytes,			// Bytes written to the device
+		calls;			// Number of device writes
+  int		queued,			// Number of queued status requests
+		answered;		// Number of answered status requests
+} testresult_t;
+
+
+//
+// Local functions...
+//
+
+static void	create_cb(pappl_printer_t *printer, void *cbdata);
+static void	device_error_cb(const char *message, void *err_data);
+static bool	driver_cb(pappl_system_t *system, const char *driver_name, const char *device_uri, const char *device_id, pappl_pr_driver_data_t *data, ipp_t **attrs, void *cbdata);
+static bool	load_file(testfile_t *file);
+static int	load_results(const char *filename, testresult_t **results);
+static bool	run_compression(pappl_printer_t *printer, const char *jobfile, pappl_pr_driver_data_t *data, int num_files, testfile_t *files, int num_links, testlink_t *links);
+static bool	run_driver(pappl_printer_t *printer, pappl_job_t *job, pappl_pr_driver_data_t *data, int resolution, testfile_t *file, int labels, const char *device_uri, const char *outdir, bool status, testresult_t *result);
+static int	usage(int status);
+
+
+//
+// Local globals...
+//
+
+static pappl_pr_driver_t	lprint_drivers[] =
+{					// Driver list
+#ifdef LPRINT_EXPERIMENTAL
+#  include "lprint-brother.h"
+#  include "lprint-cpcl.h"
+#endif // LPRINT_EXPERIMENTAL
+#include "lprint-dymo.h"
+#include "lprint-epl2.h"
+#include "lprint-escpos.h"
+#include "lprint-sii.h"
+#include "lprint-tspl.h"
+#include "lprint-zpl.h"
+};
+
+static const struct
+{
+  const char		*name;		// Compression name
+  lprint_compression_t	compression;	// Graphics compression
+} compressions[] =
+{
+  { "auto",	LPRINT_COMPRESSION_AUTO },
+  { "none",	LPRINT_COMPRESSION_NONE },
+  { "always",	LPRINT_COMPRESSION_ALWAYS }
+};
+
+
+//
+// 'main()' - Main entry for test program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int		i,			// Looping var
+		j,			// Looping var
+		resolution,		// Current resolution
+		ret = 0;		// Exit status
+  int		labels = 10;		// Number of labels per file
+  double	threshold = 10.0;	// Regression threshold in percent
+  const char	*baseline = NULL,	// Baseline results file
+		*device_uri = NULL,	// Output device URI
+		*outdir = NULL;		// Output directory
+  bool		compression = false,	// Report the bytes sent for each compression?
+		status = false;		// Queue status requests?
+  int		num_names = 0;		// Number of driver names
+  const char	*names[sizeof(lprint_drivers) / sizeof(lprint_drivers[0])];
+					// Driver names
+  int		num_files = 0;		// Number of input files
+  testfile_t	files[16];		// Input files
+  int		num_links = 0;		// Number of links
+  testlink_t	links[16];		// Links
+  char		*ptr;			// Pointer into link
+  int		num_baselines = 0;	// Number of baseline results
+  testresult_t	*baselines = NULL,	// Baseline results
+		*base,			// Current baseline result
+		result;			// Current result
+  char		spooldir[1024],		// Spool directory
+		jobfile[1024];		// Job file
+  const char	*tmpdir;		// Temporary directory
+  int		fd;			// Job file descriptor
+  pappl_system_t *system;		// System
+  pappl_printer_t *printer;		// Printer
+  pappl_job_t	*job;			// Job
+  pappl_pr_driver_data_t data;		// Driver data
+
+
+  // Check command-line
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(0));
+    }
+    else if (!strcmp(argv[i], "--compression"))
+    {
+      compression = true;
+    }
+    else if (!strcmp(argv[i], "--status"))
+    {
+      status = true;
+    }
+    else if (!strcmp(argv[i], "--baseline") || !strcmp(argv[i], "--count") || !strcmp(argv[i], "--device") || !strcmp(argv[i], "--file") || !strcmp(argv[i], "--link") || !strcmp(argv[i], "--output") || !strcmp(argv[i], "--threshold"))
+    {
+      if ((i + 1) >= argc)
+      {
+        fprintf(stderr, "testdrivers: Missing value after '%s'.\n", argv[i]);
+        return (usage(1));
+      }
+
+      if (!strcmp(argv[i], "--baseline"))
+      {
+        baseline = argv[i + 1];
+      }
+      else if (!strcmp(argv[i], "--count"))
+      {
+        if ((labels = atoi(argv[i + 1])) < 1)
+        {
+          fprintf(stderr, "testdrivers: Bad label count '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--device"))
+      {
+        device_uri = argv[i + 1];
+      }
+      else if (!strcmp(argv[i], "--file"))
+      {
+        if (num_files >= (int)(sizeof(files) / sizeof(files[0])))
+        {
+          fputs("testdrivers: Too many input files.\n", stderr);
+          return (1);
+        }
+
+        files[num_files ++].filename = argv[i + 1];
+      }
+      else if (!strcmp(argv[i], "--link"))
+      {
+        if (num_links >= (int)(sizeof(links) / sizeof(links[0])))
+        {
+          fputs("testdrivers: Too many links.\n", stderr);
+          return (1);
+        }
+
+        // Parse NAME=BITS/SEC[:BITS]...
+        if ((ptr = strchr(argv[i + 1], '=')) == NULL || ptr == argv[i + 1])
+        {
+          fprintf(stderr, "testdrivers: Bad link '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+
+        *ptr++ = '\0';
+
+        links[num_links].name = argv[i + 1];
+        links[num_links].rate = strtod(ptr, &ptr);
+        links[num_links].bits = 8;
+
+        if (*ptr == 'k' || *ptr == 'K')
+        {
+          links[num_links].rate *= 1000.0;
+          ptr ++;
+        }
+        else if (*ptr == 'm' || *ptr == 'M')
+        {
+          links[num_links].rate *= 1000000.0;
+          ptr ++;
+        }
+
+        if (*ptr == ':')
+          links[num_links].bits = (int)strtol(ptr + 1, &ptr, 10);
+
+        if (*ptr || links[num_links].rate <= 0.0 || links[num_links].bits < 1)
+        {
+          fprintf(stderr, "testdrivers: Bad link '%s'.\n", links[num_links].name);
+          return (usage(1));
+        }
+
+        num_links ++;
+      }
+      else if (!strcmp(argv[i], "--output"))
+      {
+        outdir = argv[i + 1];
+      }
+      else if ((threshold = atof(argv[i + 1])) <= 0.0)
+      {
+        fprintf(stderr, "testdrivers: Bad threshold '%s'.\n", argv[i + 1]);
+        return (usage(1));
+      }
+
+      i ++;
+    }
+    else if (!strncmp(argv[i], "--", 2))
+    {
+      fprintf(stderr, "testdrivers: Unknown option '%s'.\n", argv[i]);
+      return (usage(1));
+    }
+    else
+    {
+      for (j = 0; j < (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])); j ++)
+      {
+        if (!strcmp(argv[i], lprint_drivers[j].name))
+          break;
+      }
+
+      if (j >= (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])))
+      {
+        fprintf(stderr, "testdrivers: Unknown driver '%s'.\n", argv[i]);
+        return (1);
+      }
+
+      names[num_names ++] = argv[i];
+    }
+  }
+
+  // Default to all drivers, the files in the test suite, and common links...
+  if (num_names == 0)
+  {
+    for (j = 0; j < (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])); j ++)
+      names[num_names ++] = lprint_drivers[j].name;
+  }
+
+  if (num_files == 0)
+  {
+    files[num_files ++].filename = "testsuite/sample-label.pwg";
+    files[num_files ++].filename = "testsuite/complex-label.pwg";
+    files[num_files ++].filename = "testsuite/bad-label.pwg";
+  }
+
+  if (num_links == 0)
+  {
+    links[num_links].name    = "serial-9600";
+    links[num_links].rate    = 9600.0;
+    links[num_links ++].bits = 10;
+
+    links[num_links].name    = "usb-fs";
+    links[num_links].rate    = 12000000.0;
+    links[num_links ++].bits = 8;
+
+    links[num_links].name    = "wifi";
+    links[num_links].rate    = 20000000.0;
+    links[num_links ++].bits = 8;
+  }
+
+  // Load the input files and baseline results...
+  for (i = 0; i < num_files; i ++)
+  {
+    if (!load_file(files + i))
+      return (1);
+  }
+
+  if (baseline && (num_baselines = load_results(baseline, &baselines)) < 0)
+    return (1);
+
+  // Create a system with a private spool directory...
+  if ((tmpdir = getenv("TMPDIR")) == NULL)
+    tmpdir = "/tmp";
+
+  snprintf(spooldir, sizeof(spooldir), "%s/testdrivers%d", tmpdir, (int)getpid());
+  if (mkdir(spooldir, 0700) && errno != EEXIST)
+  {
+    perror(spooldir);
+    return (1);
+  }
+
+  if ((system = papplSystemCreate(PAPPL_SOPTIONS_NONE, "testdrivers", 0, NULL, spooldir, "-", PAPPL_LOGLEVEL_ERROR, NULL, false)) == NULL)
+  {
+    fputs("testdrivers: Unable to create system.\n", stderr);
+    return (1);
+  }
+
+  papplSystemSetPrinterDrivers(system, (int)(sizeof(lprint_drivers) / sizeof(lprint_drivers[0])), lprint_drivers, /*autoadd_cb*/NULL, create_cb, driver_cb, /*data*/NULL);
+
+  // Jobs are only used to hold the driver state, so they just need a file...
+  snprintf(jobfile, sizeof(jobfile), "%s/testdrivers.pwg", spooldir);
+  if ((fd = open(jobfile, O_WRONLY | O_CREAT | O_TRUNC, 0600)) < 0)
+  {
+    perror(jobfile);
+    return (1);
+  }
+  close(fd);
+
+  // Run each driver...
+  if (compression)
+  {
+    fputs("driver,xdpi,ydpi,file,compression,raw_bytes,bytes,ratio", stdout);
+    for (j = 0; j < num_links; j ++)
+      printf(",%s_ms", links[j].name);
+    putchar('\n');
+  }
+  else
+  {
+    puts("driver,xdpi,ydpi,file,labels,labels_per_sec,ns_per_line,bytes,device_calls");
+  }
+
+  for (i = 0; i < num_names; i ++)
+  {
+    if ((printer = papplPrinterCreate(system, 0, names[i], names[i], "", "file:///dev/null")) == NULL)
+    {
+      fprintf(stderr, "testdrivers: Unable to create printer for '%s'.\n", names[i]);
+      ret = 1;
+      continue;
+    }
+
+    // Stop the printer so that it doesn't process the job...
+    papplPrinterPause(printer);
+    papplPrinterGetDriverData(printer, &data);
+
+    if (compression)
+    {
+      // Report the bytes sent for each compression setting...
+      if (!run_compression(printer, jobfile, &data, num_files, files, num_links, links))
+        ret = 1;
+
+      papplPrinterDelete(printer);
+      continue;
+    }
+
+    for (resolution = 0; resolution < data.num_resolution; resolution ++)
+    {
+      for (j = 0; j < num_files; j ++)
+      {
+        if ((job = papplJobCreateWithFile(printer, "testdrivers", "image/pwg-raster", files[j].filename, 0, NULL, jobfile)) == NULL)
+        {
+          fprintf(stderr, "testdrivers: Unable to create job for '%s'.\n", names[i]);
+          ret = 1;
+          continue;
+        }
+
+        if (!run_driver(printer, job, &data, resolution, files + j, labels, device_uri, outdir, status, &result))
+        {
+          fprintf(stderr, "testdrivers: '%s' failed at %dx%ddpi with '%s'.\n", result.driver, result.xdpi, result.ydpi, result.file);
+          papplJobCancel(job);
+          ret = 1;
+          continue;
+        }
+
+        papplJobCancel(job);
+
+        printf("%s,%d,%d,%s,%d,%.1f,%.1f,%lu,%lu\n", result.driver, result.xdpi, result.ydpi, result.file, result.labels, result.labels_per_sec, result.ns_per_line, (unsigned long)result.bytes, (unsigned long)result.calls);
+        fflush(stdout);
+
+        if (result.answered < result.queued)
+        {
+          fprintf(stderr, "testdrivers: '%s' at %dx%ddpi with '%s' answered %d of %d queued status requests.\n", result.driver, result.xdpi, result.ydpi, result.file, result.answered, result.queued);
+          ret = 1;
+        }
+
+        // Compare against the baseline...
+        for (base = baselines; base && base < (baselines + num_baselines); base ++)
+        {
+          if (!strcmp(base->driver, result.driver) && base->xdpi == result.xdpi && base->ydpi == result.ydpi && !strcmp(base->file, result.file))
+            break;
+        }
+
+        if (base && base < (baselines + num_baselines))
+        {
+          if (result.ns_per_line > base->ns_per_line * (1.0 + threshold / 100.0))
+          {
+            fprintf(stderr, "testdrivers: '%s' at %dx%ddpi with '%s' regressed from %.1f to %.1f ns/line.\n", result.driver, result.xdpi, result.ydpi, result.file, base->ns_per_line, result.ns_per_line);
+            ret = 1;
+          }
+
+          if (result.labels == base->labels && result.bytes > base->bytes * (1.0 + threshold / 100.0))
+          {
+            fprintf(stderr, "testdrivers: '%s' at %dx%ddpi with '%s' regressed from %lu to %lu bytes.\n", result.driver, result.xdpi, result.ydpi, result.file, (unsigned long)base->bytes, (unsigned long)result.bytes);
+            ret = 1;
+          }
+        }
+      }
+    }
+
+    papplPrinterDelete(printer);
+  }
+
+  // Clean up...
+  papplSystemDelete(system);
+
+  unlink(jobfile);
+  rmdir(spooldir);
+
+  for (i = 0; i < num_files; i ++)
+    free(files[i].pixels);
+
+  free(baselines);
+
+  return (ret);
+}
+
+
+//
+// 'create_cb()' - Printer creation callback.
+//
+
+static void
+create_cb(pappl_printer_t *printer,	// I - Printer
+          void            *cbdata)	// I - Callback data (not used)
+{
+  pappl_pr_driver_data_t data;		// Driver data
+
+
+  (void)cbdata;
+
+  // Add the extension data used by the drivers...
+  papplPrinterGetDriverData(printer, &data);
+  lprintMediaLoad(printer, &data);
+  lprintMediaUpdate(printer, &data);
+  papplPrinterSetDriverData(printer, &data, NULL);
+}
+
+
+//
+// 'device_error_cb()' - Show a device error.
+//
+
+static void
+device_error_cb(const char *message,	// I - Error message
+                void       *err_data)	// I - Callback data (not used)
+{
+  (void)err_data;
+
+  fprintf(stderr, "testdrivers: %s\n", message);
+}
+
+
+//
+// 'driver_cb()' - Driver callback.
+//
+
+static bool				// O - `true` on success, `false` on error
+driver_cb(
+    pappl_system_t         *system,	// I - System
+    const char             *driver_name,// I - Driver name
+    const char             *device_uri,	// I - Device URI
+    const char             *device_id,	// I - 1284 device ID
+    pappl_pr_driver_data_t *data,	// I - Pointer to driver data
+    ipp_t                  **attrs,	// O - Pointer to driver attributes
+    void                   *cbdata)	// I - Callback data (not used)
+{
+  bool		ret = false;		// Return value
+  int		i;			// Looping var
+
+
+  data->kind           = PAPPL_KIND_LABEL;
+  data->raster_types   = PAPPL_RASTER_TYPE_BLACK_1 | PAPPL_RASTER_TYPE_BLACK_8 | PAPPL_RASTER_TYPE_SGRAY_8;
+  data->color_supported = PAPPL_COLOR_MODE_MONOCHROME;
+  data->color_default  = PAPPL_COLOR_MODE_MONOCHROME;
+
+  // Use the corresponding sub-driver callback to set things up...
+#ifdef LPRINT_EXPERIMENTAL
+  if (!strncmp(driver_name, "brother_", 8))
+    ret = lprintBrother(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "cpcl_", 5))
+    ret = lprintCPCL(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else
+#endif // LPRINT_EXPERIMENTAL
+  if (!strncmp(driver_name, "dymo_", 5))
+    ret = lprintDYMO(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "epl2_", 5))
+    ret = lprintEPL2(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "escpos_", 7))
+    ret = lprintESCPOS(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "sii_", 4))
+    ret = lprintSII(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "tspl_", 5))
+    ret = lprintTSPL(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+  else if (!strncmp(driver_name, "zpl_", 4))
+    ret = lprintZPL(system, driver_name, device_uri, device_id, data, attrs, cbdata);
+
+  // Update the ready media...
+  for (i = 0; i < data->num_source; i ++)
+  {
+    pwg_media_t *pwg = pwgMediaForPWG(data->media_ready[i].size_name);
+
+    data->media_ready[i].bottom_margin = data->bottom_top;
+    data->media_ready[i].left_margin   = data->left_right;
+    data->media_ready[i].right_margin  = data->left_right;
+    data->media_ready[i].size_width    = pwg ? pwg->width : 0;
+    data->media_ready[i].size_length   = pwg ? pwg->length : 0;
+    data->media_ready[i].top_margin    = data->bottom_top;
+    cupsCopyString(data->media_ready[i].source, data->source[i], sizeof(data->media_ready[i].source));
+    if (!data->media_ready[i].type[0])
+      cupsCopyString(data->media_ready[i].type, data->type[0], sizeof(data->media_ready[i].type));
+  }
+
+  data->media_default = data->media_ready[0];
+
+  return (ret);
+}
+
+
+//
+// 'load_file()' - Load the first page of a PWG raster file.
+//
+
+static bool				// O - `true` on success, `false` on error
+load_file(testfile_t *file)		// I - Input file
+{
+  int		fd;			// File descriptor
+  cups_raster_t	*ras;			// Raster stream
+  unsigned	y;			// Current line
+  bool		ret = false;		// Return value
+
+
+  if ((fd = open(file->filename, O_RDONLY)) < 0)
+  {
+    perror(file->filename);
+    return (false);
+  }
+
+  if ((ras = cupsRasterOpen(fd, CUPS_RASTER_READ)) == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", file->filename, cupsGetErrorString());
+    close(fd);
+    return (false);
+  }
+
+  if (!cupsRasterReadHeader(ras, &file->header))
+  {
+    fprintf(stderr, "%s: No pages.\n", file->filename);
+  }
+  else if (file->header.cupsBitsPerPixel != 8 || (file->header.cupsColorSpace != CUPS_CSPACE_K && file->header.cupsColorSpace != CUPS_CSPACE_SW))
+  {
+    fprintf(stderr, "%s: Only 8-bit grayscale pages are supported.\n", file->filename);
+  }
+  else if ((file->pixels = malloc((size_t)file->header.cupsBytesPerLine * file->header.cupsHeight)) == NULL)
+  {
+    perror(file->filename);
+  }
+  else
+  {
+    for (y = 0; y < file->header.cupsHeight; y ++)
+    {
+      if (!cupsRasterReadPixels(ras, file->pixels + y * file->header.cupsBytesPerLine, file->header.cupsBytesPerLine))
+        break;
+    }
+
+    if (y < file->header.cupsHeight)
+      fprintf(stderr, "%s: Early end-of-file at line %u.\n", file->filename, y);
+    else
+      ret = true;
+  }
+
+  cupsRasterClose(ras);
+  close(fd);
+
+  return (ret);
+}
+
+
+//
+// 'load_results()' - Load baseline results.
+//
+
+static int				// O - Number of results or `-1` on error
+load_results(const char   *filename,	// I - Results file
+             testresult_t **results)	// O - Results
+{
+  FILE		*fp;			// Results file
+  char		line[1024];		// Line from file
+  int		num_results = 0,	// Number of results
+		alloc_results = 0;	// Allocated results
+  testresult_t	*temp,			// New results array
+		*result;		// Current result
+  unsigned long	bytes,			// Bytes written
+		calls;			// Device writes
+
+
+  *results = NULL;
+
+  if ((fp = fopen(filename, "r")) == NULL)
+  {
+    perror(filename);
+    return (-1);
+  }
+
+  while (fgets(line, sizeof(line), fp))
+  {
+    if (num_results >= alloc_results)
+    {
+      if ((temp = realloc(*results, (size_t)(alloc_results + 64) * sizeof(testresult_t))) == NULL)
+      {
+        perror(filename);
+        fclose(fp);
+        return (-1);
+      }
+
+      *results      = temp;
+      alloc_results += 64;
+    }
+
+    result = *results + num_results;
+
+    if (sscanf(line, "%255[^,],%d,%d,%255[^,],%d,%lf,%lf,%lu,%lu", result->driver, &result->xdpi, &result->ydpi, result->file, &result->labels, &result->labels_per_sec, &result->ns_per_line, &bytes, &calls) == 9)
+    {
+      result->bytes = (size_t)bytes;
+      result->calls = (size_t)calls;
+      num_results ++;
+    }
+  }
+
+  fclose(fp);
+
+  return (num_results);
+}
+
+
+//
+// 'run_compression()' - Report the bytes sent for each graphics compression setting.
+//
+
+static bool				// O - `true` on success, `false` on error
+run_compression(
+    pappl_printer_t        *printer,	// I - Printer
+    const char             *jobfile,	// I - Job file
+    pappl_pr_driver_data_t *data,	// I - Driver data
+    int                    num_files,	// I - Number of input files
+    testfile_t             *files,	// I - Input files
+    int                    num_links,	// I - Number of links
+    testlink_t             *links)	// I - Links
+{
+  bool		ret = true;		// Return value
+  int		resolution,		// Current resolution
+		i,			// Looping var
+		j,			// Looping var
+		k;			// Looping var
+  pappl_job_t	*job;			// Job
+  testresult_t	result;			// Current result
+
+
+  // Print an unreported label first so that one-time printer setup is not
+  // counted against the first compression setting...
+  if ((job = papplJobCreateWithFile(printer, "testdrivers", "image/pwg-raster", files[0].filename, 0, NULL, jobfile)) != NULL)
+  {
+    lprintCompressionSetMode(LPRINT_COMPRESSION_AUTO);
+    run_driver(printer, job, data, 0, files, 1, /*device_uri*/NULL, /*outdir*/NULL, /*status*/false, &result);
+    papplJobCancel(job);
+  }
+
+  for (resolution = 0; resolution < data->num_resolution; resolution ++)
+  {
+    for (i = 0; i < num_files; i ++)
+    {
+      for (j = 0; j < (int)(sizeof(compressions) / sizeof(compressions[0])); j ++)
+      {
+        if ((job = papplJobCreateWithFile(printer, "testdrivers", "image/pwg-raster", files[i].filename, 0, NULL, jobfile)) == NULL)
+        {
+          fprintf(stderr, "testdrivers: Unable to create job for '%s'.\n", papplPrinterGetDriverName(printer));
+          ret = false;
+          continue;
+        }
+
+        // Start each label with nothing stored in printer memory...
+        lprintGraphicsClear(printer);
+        lprintCompressionSetMode(compressions[j].compression);
+
+        if (!run_driver(printer, job, data, resolution, files + i, 1, /*device_uri*/NULL, /*outdir*/NULL, /*status*/false, &result))
+        {
+          fprintf(stderr, "testdrivers: '%s' failed at %dx%ddpi with '%s'.\n", result.driver, result.xdpi, result.ydpi, result.file);
+          papplJobCancel(job);
+          ret = false;
+          continue;
+        }
+
+        papplJobCancel(job);
+
+        printf("%s,%d,%d,%s,%s,%lu,%lu,%.2f", result.driver, result.xdpi, result.ydpi, result.file, compressions[j].name, (unsigned long)result.raw_bytes, (unsigned long)result.bytes, result.bytes > 0 ? (double)result.raw_bytes / (double)result.bytes : 0.0);
+        for (k = 0; k < num_links; k ++)
+          printf(",%.1f", 1000.0 * result.bytes * links[k].bits / links[k].rate);
+        putchar('\n');
+      }
+    }
+  }
+
+  lprintCompressionSetMode(LPRINT_COMPRESSION_AUTO);
+
+  return (ret);
+}
+
+
+//
+// 'run_driver()' - Run a driver's raster callbacks for one file and resolution.
+//
+
+static bool				// O - `true` on success, `false` on error
+run_driver(
+    pappl_printer_t        *printer,	// I - Printer
+    pappl_job_t            *job,	// I - Job
+    pappl_pr_driver_data_t *data,	// I - Driver data
+    int                    resolution,	// I - Resolution index
+    testfile_t             *file,	// I - Input file
+    int                    labels,	// I - Number of labels
+    const char             *device_uri,	// I - Output device URI or `NULL`
+    const char             *outdir,	// I - Output directory or `NULL`
+    bool                   status,	// I - Queue status requests?
+    testresult_t           *result)	// O - Result
+{
+  bool			ret = false;	// Return value
+  pappl_pr_options_t	*options;	// Print options
+  cups_page_header_t	*header;	// Page header
+  unsigned char		*pixels = NULL,	// Scaled page pixels
+			*line;		// Current line
+  unsigned		x,		// Current column
+			y,		// Current line
+			srcy;		// Input line
+  int			label;		// Current label
+  bool			queued,		// Was a status request queued?
+			deferred = false;
+					// Is a request waiting for the next label?
+  const char		*basename;	// Input file basename
+  char			uri[1024];	// Output device URI
+  pappl_device_t	*device = NULL;	// Output device
+  pappl_devmetrics_t	metrics;	// Device metrics
+  struct timeval	start,		// Start time
+			end,		// End time
+			lstart,		// Start time for lines
+			lend;		// End time for lines
+  double		secs,		// Elapsed seconds
+			lsecs = 0.0;	// Elapsed seconds for lines
+
+
+  // Initialize the result...
+  if ((basename = strrchr(file->filename, '/')) != NULL)
+    basename ++;
+  else
+    basename = file->filename;
+
+  memset(result, 0, sizeof(testresult_t));
+  cupsCopyString(result->driver, papplPrinterGetDriverName(printer), sizeof(result->driver));
+  cupsCopyString(result->file, basename, sizeof(result->file));
+  result->xdpi   = data->x_resolution[resolution];
+  result->ydpi   = data->y_resolution[resolution];
+  result->labels = labels;
+
+  // Setup the print options for the default media and current resolution...
+  if ((options = papplJobCreatePrintOptions(job, (unsigned)labels, false)) == NULL)
+    return (false);
+
+  options->printer_resolution[0] = result->xdpi;
+  options->printer_resolution[1] = result->ydpi;
+
+  header                   = &options->header;
+  *header                  = file->header;
+  header->HWResolution[0]  = (unsigned)result->xdpi;
+  header->HWResolution[1]  = (unsigned)result->ydpi;
+  header->cupsWidth        = (unsigned)(options->media.size_width * result->xdpi / 2540);
+  header->cupsBytesPerLine = header->cupsWidth;
+
+  if (options->media.size_length > 0)
+    header->cupsHeight = (unsigned)(options->media.size_length * result->ydpi / 2540);
+  else
+    header->cupsHeight = file->header.cupsHeight * (unsigned)result->ydpi / file->header.HWResolution[1];
+
+  header->cupsInteger[CUPS_RASTER_PWG_ImageBoxLeft]   = 0;
+  header->cupsInteger[CUPS_RASTER_PWG_ImageBoxTop]    = 0;
+  header->cupsInteger[CUPS_RASTER_PWG_ImageBoxRight]  = 0;
+  header->cupsInteger[CUPS_RASTER_PWG_ImageBoxBottom] = 0;
+
+  if (header->cupsWidth == 0 || header->cupsHeight == 0)
+  {
+    fprintf(stderr, "testdrivers: Bad media size for '%s'.\n", result->driver);
+    goto done;
+  }
+
+  result->raw_bytes = (size_t)(header->cupsWidth + 7) / 8 * header->cupsHeight;
+
+  // Scale the page to the media size and resolution...
+  if ((pixels = malloc((size_t)header->cupsBytesPerLine * header->cupsHeight)) == NULL)
+  {
+    perror("testdrivers");
+    goto done;
+  }
+
+  for (y = 0, line = pixels; y < header->cupsHeight; y ++, line += header->cupsBytesPerLine)
+  {
+    srcy = y * file->header.cupsHeight / header->cupsHeight;
+
+    for (x = 0; x < header->cupsWidth; x ++)
+      line[x] = file->pixels[srcy * file->header.cupsBytesPerLine + x * file->header.cupsWidth / header->cupsWidth];
+  }
+
+  // Open the output device...
+  if (device_uri)
+    cupsCopyString(uri, device_uri, sizeof(uri));
+  else if (outdir)
+    snprintf(uri, sizeof(uri), "file://%s/%s-%ddpi-%s.out", outdir, result->driver, result->ydpi, basename);
+  else
+    cupsCopyString(uri, "file:///dev/null", sizeof(uri));
+
+  if ((device = papplDeviceOpen(uri, "testdrivers", device_error_cb, NULL)) == NULL)
+    goto done;
+
+  // Run the callbacks...
+  gettimeofday(&start, NULL);
+
+  if (!(data->rstartjob_cb)(job, options, device))
+    goto done;
+
+  for (label = 0; label < labels; label ++)
+  {
+    if (!(data->rstartpage_cb)(job, options, device, (unsigned)label))
+      goto done;
+
+    // Drivers that cannot query status in the middle of a page answer the
+    // previous label's request once its print command has been sent...
+    if (deferred && !lprintSessionStatusQueued(job))
+      result->answered ++;
+
+    // Queue a status request for the job to answer, like the status poll
+    // scheduler does while the printer is processing a job...
+    queued   = status && lprintSessionQueueStatus(printer);
+    deferred = false;
+    if (queued)
+      result->queued ++;
+
+    gettimeofday(&lstart, NULL);
+
+    for (y = 0, line = pixels; y < header->cupsHeight; y ++, line += header->cupsBytesPerLine)
+    {
+      if (!(data->rwriteline_cb)(job, options, device, y, line))
+        goto done;
+    }
+
+    gettimeofday(&lend, NULL);
+    lsecs += (double)(lend.tv_sec - lstart.tv_sec) + 0.000001 * (double)(lend.tv_usec - lstart.tv_usec);
+
+    if (!(data->rendpage_cb)(job, options, device, (unsigned)label))
+      goto done;
+
+    // The request is cleared when the driver answers it, otherwise queue it
+    // again and give the driver until the start of the next label...
+    if (queued && !lprintSessionStatusQueued(job))
+      result->answered ++;
+    else if (queued)
+      deferred = lprintSessionQueueStatus(printer);
+  }
+
+  if (deferred)
+    result->queued --;
+
+  if (!(data->rendjob_cb)(job, options, device))
+    goto done;
+
+  papplDeviceFlush(device);
+
+  gettimeofday(&end, NULL);
+  secs = (double)(end.tv_sec - start.tv_sec) + 0.000001 * (double)(end.tv_usec - start.tv_usec);
+
+  // Save the results...
+  papplDeviceGetMetrics(device, &metrics);
+
+  result->labels_per_sec = secs > 0.0 ? labels / secs : 0.0;
+  result->ns_per_line    = 1000000000.0 * lsecs / ((double)labels * header->cupsHeight);
+  result->bytes          = metrics.write_bytes;
+  result->calls          = metrics.write_requests;
+
+  ret = true;
+
+  // Clean up and return...
+  done:
+
+  if (device)
+    papplDeviceClose(device);
+
+  papplJobDeletePrintOptions(options);
+  free(pixels);
+
+  return (ret);
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(int status)			// I - Exit status
+{
+  FILE	*fp = status ? stderr : stdout;	// Output file
+
+
+  fputs("Usage: ./testdrivers [OPTIONS] [DRIVER-NAME ...] >RESULTS.csv\n", fp);
+  fputs("Options:\n", fp);
+  fputs("  --baseline RESULTS.csv       Compare against previous results\n", fp);
+  fputs("  --compression                Report the bytes sent for each graphics compression\n", fp);
+  fputs("  --count LABELS               Number of labels to print for each file (default 10)\n", fp);
+  fputs("  --device URI                 Send the output to URI instead of /dev/null\n", fp);
+  fputs("  --file INPUT.pwg             Use the specified PWG raster file (repeatable)\n", fp);
+  fputs("  --help                       Show program help\n", fp);
+  fputs("  --link NAME=BITS/SEC[:BITS]  Add a link for \"--compression\", with BITS per byte (default 8)\n", fp);
+  fputs("  --output DIRECTORY           Save the output of each driver in DIRECTORY\n", fp);
+  fputs("  --status                     Queue a status request before each label\n", fp);
+  fputs("  --threshold PERCENT          Allowed regression against the baseline (default 10)\n", fp);
+
+  return (status);
+}
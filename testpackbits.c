@@ -4,6 +4,7 @@
 // Usage:
 //
 //   ./testpackbits [COUNT]
+//   ./testpackbits --throughput
 //
 // Copyright © 2024-2026 by Michael R Sweet
 //
@@ -30,6 +31,7 @@ typedef struct testdata_s
 //
 
 static unsigned get_rand(void);
+static int	run_throughput(void);
 static size_t	uncompress_packbits(unsigned char *dst, size_t dstsize, const unsigned char *src, size_t srclen);
 
 
@@ -79,6 +81,15 @@ main(int  argc,				// I - Number of command-line arguments
      130, "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
           "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"
           "ab", 5, "\201a\001ab"
+    },
+    {
+      40, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN", 41, "\047abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN"
+    },
+    {
+      53, "xyzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzz0123456789abcdefghij", 26, "\001xy\342z\0230123456789abcdefghij"
+    },
+    {
+      58, "0123456789abcdefghijkkkkkkkkkkkkkkkkkkkkkkkkkkkkkkkkklmnop", 29, "\0230123456789abcdefghij\340k\004lmnop"
     }
   };
 
@@ -88,9 +99,14 @@ main(int  argc,				// I - Number of command-line arguments
   {
     num_tests = 1000000;
   }
+  else if (argc == 2 && !strcmp(argv[1], "--throughput"))
+  {
+    return (run_throughput());
+  }
   else if (argc > 2 || (num_tests = atoi(argv[1])) < 1)
   {
     fputs("Usage: ./testpackbits [COUNT]\n", stderr);
+    fputs("       ./testpackbits --throughput\n", stderr);
     return (1);
   }
 
@@ -290,6 +306,90 @@ get_rand(void)
 }
 
 
+//
+// 'run_throughput()' - Measure compression throughput for typical label rows.
+//
+// Each pattern uses 104-byte (832 dot) rows and runs for about 1 second.
+//
+
+static int				// O - Exit status
+run_throughput(void)
+{
+  int		pattern,		// Current pattern
+		row;			// Current row
+  size_t	i;			// Looping var
+  unsigned char	rows[256][104],		// Rows to compress
+		*dst;			// Destination buffer
+  size_t	bytes;			// Number of bytes compressed
+  struct timeval start,			// Start time
+		end;			// End time
+  double	secs;			// Elapsed seconds
+  static const char * const patterns[] =
+  {					// Row patterns
+    "random",				// Random bytes (worst case)
+    "sparse",				// Mostly white with a few black dots
+    "dense"				// Alternating black/white runs with noise
+  };
+
+
+  if ((dst = lprintPackBitsAlloc(sizeof(rows[0]))) == NULL)
+  {
+    perror("lprintPackBitsAlloc");
+    return (1);
+  }
+
+  for (pattern = 0; pattern < (int)(sizeof(patterns) / sizeof(patterns[0])); pattern ++)
+  {
+    // Generate rows...
+    for (row = 0; row < 256; row ++)
+    {
+      for (i = 0; i < sizeof(rows[0]); i ++)
+      {
+        switch (pattern)
+        {
+          case 0 :
+              rows[row][i] = (unsigned char)get_rand();
+              break;
+          case 1 :
+              rows[row][i] = (get_rand() % 50) ? 0 : (unsigned char)get_rand();
+              break;
+          default :
+              if ((i / (size_t)(1 + row % 13)) & 1)
+                rows[row][i] = 0xff;
+              else
+                rows[row][i] = (get_rand() % 8) ? 0 : (unsigned char)get_rand();
+              break;
+        }
+      }
+    }
+
+    // Compress rows for about 1 second...
+    testBegin("lprintPackBitsCompress(%s rows)", patterns[pattern]);
+
+    gettimeofday(&start, NULL);
+    bytes = 0;
+
+    do
+    {
+      for (row = 0; row < 256; row ++)
+        lprintPackBitsCompress(dst, rows[row], sizeof(rows[0]));
+
+      bytes += sizeof(rows);
+
+      gettimeofday(&end, NULL);
+      secs = (double)(end.tv_sec - start.tv_sec) + 0.000001 * (double)(end.tv_usec - start.tv_usec);
+    }
+    while (secs < 1.0);
+
+    testEndMessage(true, "%.1f MB/s", (double)bytes / secs / 1000000.0);
+  }
+
+  free(dst);
+
+  return (0);
+}
+
+
 //
 // 'uncompress_packbits()' - Uncompress PackBits data.
 //
@@ -0,0 +1,2291 @@
+//
+// Label printer simulator for LPrint
+//
+// Copyright © 2026 by Michael R Sweet
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// This program stands in for a DYMO, EPL2, ESC/POS, SII, TSPL, or ZPL printer
+// on a "socket://" device URI.  The graphics in each label are decoded back into a
+// bitmap and status queries are answered, optionally with a delay, a slower
+// link, or a fault condition.  Add a printer with a device URI of
+// "socket://127.0.0.1:PORT" to test locally.
+//
+// Usage:
+//
+//   ./testsimulator [OPTIONS] [CAPTURE-FILE ...] >RESULTS.csv
+//
+// Options:
+//
+//   --bandwidth BITS/SEC  Simulate a slower link, for example "9600" or "10M"
+//   --compare INPUT.pwg   Compare labels with the first page of INPUT.pwg
+//   --count CONNECTIONS   Exit after CONNECTIONS connections (default 0 = never)
+//   --fault FAULT         Report "disconnect", "head-open", "jam", or "media-out"
+//   --fault-after LABELS  Start the fault after LABELS labels (default 0)
+//   --help                Show program help
+//   --lang LANGUAGE       Use "dymo", "epl2", "escpos", "sii", "tspl", or "zpl" (default)
+//   --latency MS          Delay status responses by MS milliseconds (default 0)
+//   --output DIRECTORY    Save each label as a PBM image in DIRECTORY
+//   --port PORT           Listen on PORT (default 9100)
+//   --resolution DPI      Printer resolution (default 203)
+//   --tolerance PERCENT   Allowed difference for --compare (default 5)
+//
+// Capture files (for example from "testdrivers --output") are decoded instead
+// of listening for connections.  Results are written as CSV to the standard
+// output, one line per connection or file.
+//
+// Labels are compared after aligning the inked areas, since drivers skip
+// leading blank lines and media offsets.  ESC/POS labels end with a cut or
+// reset, so pages that are not cut are reported as a single label.  SII
+// printers take SIM_SII_RESET_TIME to reset and answer any commands sent during
+// the reset afterwards.
+//
+
+#include "lprint.h"
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+//
+// Constants...
+//
+
+#define SIM_MAX_GRAPHICS	64	// Maximum number of stored graphics
+#define SIM_SII_RESET_TIME	1000	// Time for an SII reset in milliseconds
+
+
+//
+// Local types...
+//
+
+typedef enum sim_fault_e		// Simulated faults
+{
+  SIM_FAULT_NONE,			// No fault
+  SIM_FAULT_DISCONNECT,			// Close the connection
+  SIM_FAULT_HEAD_OPEN,			// Print head/cover open
+  SIM_FAULT_JAM,			// Paper jam
+  SIM_FAULT_MEDIA_OUT			// Out of media
+} sim_fault_t;
+
+typedef enum sim_lang_e			// Printer languages
+{
+  SIM_LANG_DYMO,			// DYMO LabelWriter/LabelManager
+  SIM_LANG_EPL2,			// Eltron Programming Language
+  SIM_LANG_ESCPOS,			// Epson ESC/POS
+  SIM_LANG_SII,				// Seiko Instruments SLP
+  SIM_LANG_TSPL,			// TSC Printer Language
+  SIM_LANG_ZPL				// Zebra Programming Language
+} sim_lang_t;
+
+typedef struct sim_bitmap_s		// Bitmap
+{
+  unsigned	width,			// Width in pixels
+		height,			// Height in pixels
+		alloc_height;		// Allocated height in pixels
+  unsigned char	*pixels;		// Pixels, 1 = black
+} sim_bitmap_t;
+
+typedef struct sim_graphic_s		// Stored graphic
+{
+  char		name[64];		// Graphic name
+  sim_bitmap_t	bitmap;			// Graphic bitmap
+} sim_graphic_t;
+
+typedef struct sim_s			// Simulator
+{
+  // Options...
+  sim_lang_t	lang;			// Printer language
+  int		resolution;		// Printer resolution
+  double	bandwidth;		// Link bandwidth in bits per second or `0`
+  int		latency;		// Status response delay in milliseconds
+  sim_fault_t	fault;			// Simulated fault
+  int		fault_after;		// Number of labels before the fault
+  bool		fault_active;		// Is the fault active?
+  const char	*outdir;		// Output directory or `NULL`
+  sim_bitmap_t	reference;		// Reference bitmap for --compare
+  double	tolerance;		// Allowed difference in percent
+
+  // Printer state...
+  sim_graphic_t	graphics[SIM_MAX_GRAPHICS];
+					// Stored graphics
+  int		total_labels;		// Labels since startup
+
+  // Connection state...
+  int		outfd;			// Response file descriptor or `-1`
+  unsigned char	*data;			// Unprocessed data
+  size_t	used,			// Bytes of unprocessed data
+		alloc;			// Allocated size of data
+  bool		disconnect;		// Close the connection?
+  sim_bitmap_t	page;			// Current label
+  bool		drawn;			// Has anything been drawn on the label?
+  unsigned	x,			// Current X position
+		y,			// Current Y position
+		width,			// Line width in bytes (DYMO) or dots (EPL2)
+		length,			// Label length in lines
+		copies;			// Number of copies (ZPL)
+  unsigned char	line[256];		// Last line (SII)
+  int		labels,			// Number of labels
+		queries,		// Number of status queries
+		errors;			// Number of decoding errors
+  double	max_diff,		// Maximum difference in percent
+		last_label;		// Time of last label
+} sim_t;
+
+
+//
+// Local functions...
+//
+
+static bool	bitmap_bounds(sim_bitmap_t *bitmap, unsigned *left, unsigned *top, unsigned *right, unsigned *bottom);
+static void	bitmap_clear(sim_bitmap_t *bitmap);
+static double	bitmap_compare(sim_bitmap_t *a, sim_bitmap_t *b);
+static void	bitmap_draw(sim_bitmap_t *dst, unsigned x, unsigned y, sim_bitmap_t *src);
+static void	bitmap_lines(sim_bitmap_t *bitmap, unsigned x, unsigned y, const unsigned char *data, unsigned bytes, unsigned lines, bool black);
+static bool	bitmap_resize(sim_bitmap_t *bitmap, unsigned width, unsigned height);
+static bool	bitmap_write(sim_bitmap_t *bitmap, const char *filename);
+static size_t	find_commas(const unsigned char *data, size_t len, int commas);
+static double	get_time(void);
+static void	graphic_delete(sim_t *sim, const char *name);
+static sim_bitmap_t *graphic_find(sim_t *sim, const char *name);
+static sim_bitmap_t *graphic_store(sim_t *sim, const char *name);
+static bool	load_reference(const char *filename, sim_bitmap_t *bitmap);
+static bool	pcx_decode(sim_bitmap_t *bitmap, const unsigned char *data, size_t size);
+static void	sim_dymo(sim_t *sim, size_t *used, bool eof);
+static void	sim_epl2(sim_t *sim, size_t *used, bool eof);
+static void	sim_escpos(sim_t *sim, size_t *used, bool eof);
+static void	sim_label(sim_t *sim, unsigned copies);
+static bool	sim_run(sim_t *sim, int infd, int outfd, const char *source);
+static void	sim_respond(sim_t *sim, const void *data, size_t bytes);
+static void	sim_sii(sim_t *sim, size_t *used, bool eof);
+static void	sim_tspl(sim_t *sim, size_t *used, bool eof);
+static void	sim_zpl(sim_t *sim, size_t *used, bool eof);
+static int	usage(int status);
+static size_t	zpl_decode(const unsigned char *data, size_t len, unsigned char *out, unsigned bpr, unsigned rows, unsigned *done);
+
+
+//
+// Local globals...
+//
+
+static const char * const sim_faults[] =// Fault names
+{
+  "none",
+  "disconnect",
+  "head-open",
+  "jam",
+  "media-out"
+};
+static const char * const sim_langs[] =	// Language names
+{
+  "dymo",
+  "epl2",
+  "escpos",
+  "sii",
+  "tspl",
+  "zpl"
+};
+
+
+//
+// 'main()' - Main entry for test program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int			i,		// Looping var
+			j,		// Looping var
+			ret = 0;	// Exit status
+  sim_t			sim;		// Simulator
+  const char		*compare = NULL;// Reference file
+  int			port = 9100,	// Port number
+			count = 0,	// Number of connections to accept
+			num_files = 0;	// Number of capture files
+  char			*ptr,		// Pointer into value
+			portname[32],	// Port number string
+			source[256];	// Connection source
+  struct addrinfo	hints,		// Address lookup hints
+			*addrlist,	// List of addresses
+			*addr;		// Current address
+  struct pollfd		pfds[4];	// Listener sockets
+  int			nfds = 0,	// Number of listener sockets
+			fd,		// Connection or file descriptor
+			on = 1;		// Socket option value
+  struct sockaddr_storage caddr;	// Client address
+  socklen_t		caddrlen;	// Length of client address
+
+
+  // Check command-line
+  memset(&sim, 0, sizeof(sim));
+
+  sim.lang       = SIM_LANG_ZPL;
+  sim.resolution = 203;
+  sim.tolerance  = 5.0;
+  sim.outfd      = -1;
+
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(0));
+    }
+    else if (!strcmp(argv[i], "--bandwidth") || !strcmp(argv[i], "--compare") || !strcmp(argv[i], "--count") || !strcmp(argv[i], "--fault") || !strcmp(argv[i], "--fault-after") || !strcmp(argv[i], "--lang") || !strcmp(argv[i], "--latency") || !strcmp(argv[i], "--output") || !strcmp(argv[i], "--port") || !strcmp(argv[i], "--resolution") || !strcmp(argv[i], "--tolerance"))
+    {
+      if ((i + 1) >= argc)
+      {
+        fprintf(stderr, "testsimulator: Missing value after '%s'.\n", argv[i]);
+        return (usage(1));
+      }
+
+      if (!strcmp(argv[i], "--bandwidth"))
+      {
+        sim.bandwidth = strtod(argv[i + 1], &ptr);
+        if (*ptr == 'k' || *ptr == 'K')
+          sim.bandwidth *= 1000.0;
+        else if (*ptr == 'm' || *ptr == 'M')
+          sim.bandwidth *= 1000000.0;
+
+        if (sim.bandwidth <= 0.0)
+        {
+          fprintf(stderr, "testsimulator: Bad bandwidth '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--compare"))
+      {
+        compare = argv[i + 1];
+      }
+      else if (!strcmp(argv[i], "--count"))
+      {
+        if ((count = atoi(argv[i + 1])) < 0)
+        {
+          fprintf(stderr, "testsimulator: Bad connection count '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--fault"))
+      {
+        for (sim.fault = SIM_FAULT_DISCONNECT; sim.fault <= SIM_FAULT_MEDIA_OUT; sim.fault ++)
+        {
+          if (!strcmp(argv[i + 1], sim_faults[sim.fault]))
+            break;
+        }
+
+        if (sim.fault > SIM_FAULT_MEDIA_OUT)
+        {
+          fprintf(stderr, "testsimulator: Unknown fault '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--fault-after"))
+      {
+        if ((sim.fault_after = atoi(argv[i + 1])) < 0)
+        {
+          fprintf(stderr, "testsimulator: Bad label count '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--lang"))
+      {
+        for (sim.lang = SIM_LANG_DYMO; sim.lang <= SIM_LANG_ZPL; sim.lang ++)
+        {
+          if (!strcmp(argv[i + 1], sim_langs[sim.lang]))
+            break;
+        }
+
+        if (sim.lang > SIM_LANG_ZPL)
+        {
+          fprintf(stderr, "testsimulator: Unknown language '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--latency"))
+      {
+        if ((sim.latency = atoi(argv[i + 1])) < 0)
+        {
+          fprintf(stderr, "testsimulator: Bad latency '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--output"))
+      {
+        sim.outdir = argv[i + 1];
+      }
+      else if (!strcmp(argv[i], "--port"))
+      {
+        if ((port = atoi(argv[i + 1])) < 1 || port > 65535)
+        {
+          fprintf(stderr, "testsimulator: Bad port number '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if (!strcmp(argv[i], "--resolution"))
+      {
+        if ((sim.resolution = atoi(argv[i + 1])) < 100 || sim.resolution > 600)
+        {
+          fprintf(stderr, "testsimulator: Bad resolution '%s'.\n", argv[i + 1]);
+          return (usage(1));
+        }
+      }
+      else if ((sim.tolerance = atof(argv[i + 1])) < 0.0)
+      {
+        fprintf(stderr, "testsimulator: Bad tolerance '%s'.\n", argv[i + 1]);
+        return (usage(1));
+      }
+
+      i ++;
+    }
+    else if (!strncmp(argv[i], "--", 2))
+    {
+      fprintf(stderr, "testsimulator: Unknown option '%s'.\n", argv[i]);
+      return (usage(1));
+    }
+    else
+    {
+      num_files ++;
+    }
+  }
+
+  if (compare && !load_reference(compare, &sim.reference))
+    return (1);
+
+  sim.fault_active = sim.fault != SIM_FAULT_NONE && sim.fault_after == 0;
+
+  signal(SIGPIPE, SIG_IGN);
+
+  puts("source,lang,bytes,seconds,labels,labels_per_min,status_queries,max_diff_percent,errors");
+  fflush(stdout);
+
+  if (num_files > 0)
+  {
+    // Decode capture files...
+    for (i = 1; i < argc; i ++)
+    {
+      if (!strncmp(argv[i], "--", 2))
+      {
+        i ++;
+        continue;
+      }
+
+      if ((fd = open(argv[i], O_RDONLY)) < 0)
+      {
+        perror(argv[i]);
+        ret = 1;
+        continue;
+      }
+
+      if (!sim_run(&sim, fd, -1, argv[i]))
+        ret = 1;
+
+      close(fd);
+    }
+  }
+  else
+  {
+    // Listen for connections on the wildcard addresses...
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_flags    = AI_PASSIVE;
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    snprintf(portname, sizeof(portname), "%d", port);
+
+    if (getaddrinfo(NULL, portname, &hints, &addrlist))
+    {
+      fprintf(stderr, "testsimulator: Unable to lookup port %d.\n", port);
+      return (1);
+    }
+
+    for (addr = addrlist; addr && nfds < (int)(sizeof(pfds) / sizeof(pfds[0])); addr = addr->ai_next)
+    {
+      if ((fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+        continue;
+
+      setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+#ifdef IPV6_V6ONLY
+      if (addr->ai_family == AF_INET6)
+        setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &on, sizeof(on));
+#endif // IPV6_V6ONLY
+
+      if (bind(fd, addr->ai_addr, addr->ai_addrlen) || listen(fd, 1))
+      {
+        close(fd);
+        continue;
+      }
+
+      pfds[nfds].fd     = fd;
+      pfds[nfds].events = POLLIN;
+      nfds ++;
+    }
+
+    freeaddrinfo(addrlist);
+
+    if (nfds == 0)
+    {
+      fprintf(stderr, "testsimulator: Unable to listen on port %d: %s\n", port, strerror(errno));
+      return (1);
+    }
+
+    fprintf(stderr, "testsimulator: Simulating a %s printer on port %d.\n", sim_langs[sim.lang], port);
+
+    // Accept one connection at a time, like a printer...
+    for (i = 0; count == 0 || i < count;)
+    {
+      if (poll(pfds, (nfds_t)nfds, -1) < 0)
+      {
+        if (errno == EINTR)
+          continue;
+
+        perror("testsimulator");
+        ret = 1;
+        break;
+      }
+
+      for (j = 0; j < nfds; j ++)
+      {
+        if (pfds[j].revents & POLLIN)
+          break;
+      }
+
+      if (j >= nfds)
+        continue;
+
+      caddrlen = sizeof(caddr);
+      if ((fd = accept(pfds[j].fd, (struct sockaddr *)&caddr, &caddrlen)) < 0)
+        continue;
+
+      if (getnameinfo((struct sockaddr *)&caddr, caddrlen, source, sizeof(source), NULL, 0, NI_NUMERICHOST))
+        cupsCopyString(source, "unknown", sizeof(source));
+
+      if (!sim_run(&sim, fd, fd, source))
+        ret = 1;
+
+      close(fd);
+      i ++;
+    }
+
+    for (j = 0; j < nfds; j ++)
+      close(pfds[j].fd);
+  }
+
+  // Clean up...
+  for (i = 0; i < SIM_MAX_GRAPHICS; i ++)
+    bitmap_clear(&sim.graphics[i].bitmap);
+
+  bitmap_clear(&sim.page);
+  bitmap_clear(&sim.reference);
+  free(sim.data);
+
+  return (ret);
+}
+
+
+//
+// 'bitmap_bounds()' - Get the bounding box of the black pixels in a bitmap.
+//
+
+static bool				// O - `true` if there are black pixels, `false` otherwise
+bitmap_bounds(sim_bitmap_t *bitmap,	// I - Bitmap
+              unsigned     *left,	// O - Left column
+              unsigned     *top,	// O - Top row
+              unsigned     *right,	// O - Right column
+              unsigned     *bottom)	// O - Bottom row
+{
+  unsigned		x,		// Current column
+			y;		// Current row
+  const unsigned char	*pixel;		// Current pixel
+
+
+  *left   = bitmap->width;
+  *top    = bitmap->height;
+  *right  = 0;
+  *bottom = 0;
+
+  for (y = 0, pixel = bitmap->pixels; y < bitmap->height; y ++)
+  {
+    for (x = 0; x < bitmap->width; x ++, pixel ++)
+    {
+      if (*pixel)
+      {
+        if (x < *left)
+          *left = x;
+        if (x > *right)
+          *right = x;
+        if (y < *top)
+          *top = y;
+        *bottom = y;
+      }
+    }
+  }
+
+  return (*left <= *right);
+}
+
+
+//
+// 'bitmap_clear()' - Free the pixels in a bitmap.
+//
+
+static void
+bitmap_clear(sim_bitmap_t *bitmap)	// I - Bitmap
+{
+  free(bitmap->pixels);
+  memset(bitmap, 0, sizeof(sim_bitmap_t));
+}
+
+
+//
+// 'bitmap_compare()' - Compare two bitmaps.
+//
+// The bitmaps are aligned using the bounding boxes of their black pixels.  The
+// difference is the number of mismatched pixels as a percentage of the area of
+// the first bitmap's bounding box.
+//
+
+static double				// O - Difference in percent
+bitmap_compare(sim_bitmap_t *a,		// I - First (reference) bitmap
+               sim_bitmap_t *b)		// I - Second bitmap
+{
+  unsigned	aleft, atop, aright, abottom,
+					// Bounds of first bitmap
+		bleft, btop, bright, bbottom,
+					// Bounds of second bitmap
+		x, y,			// Looping vars
+		width, height;		// Size of comparison
+  bool		aink, bink;		// Do the bitmaps have black pixels?
+  size_t	diff = 0;		// Number of mismatched pixels
+  unsigned char	apixel, bpixel;		// Current pixels
+
+
+  aink = bitmap_bounds(a, &aleft, &atop, &aright, &abottom);
+  bink = bitmap_bounds(b, &bleft, &btop, &bright, &bbottom);
+
+  if (!aink || !bink)
+    return (aink == bink ? 0.0 : 100.0);
+
+  width  = aright - aleft + 1;
+  height = abottom - atop + 1;
+
+  if ((bright - bleft + 1) > width)
+    width = bright - bleft + 1;
+  if ((bbottom - btop + 1) > height)
+    height = bbottom - btop + 1;
+
+  for (y = 0; y < height; y ++)
+  {
+    for (x = 0; x < width; x ++)
+    {
+      apixel = (aleft + x) < a->width && (atop + y) < a->height ? a->pixels[(atop + y) * a->width + aleft + x] : 0;
+      bpixel = (bleft + x) < b->width && (btop + y) < b->height ? b->pixels[(btop + y) * b->width + bleft + x] : 0;
+
+      if (apixel != bpixel)
+        diff ++;
+    }
+  }
+
+  return (100.0 * diff / ((double)(aright - aleft + 1) * (abottom - atop + 1)));
+}
+
+
+//
+// 'bitmap_draw()' - Draw one bitmap on another.
+//
+
+static void
+bitmap_draw(sim_bitmap_t *dst,		// I - Destination bitmap
+            unsigned     x,		// I - X position
+            unsigned     y,		// I - Y position
+            sim_bitmap_t *src)		// I - Source bitmap
+{
+  unsigned		sx,		// Source column
+			sy;		// Source row
+  const unsigned char	*sptr;		// Pointer into source
+  unsigned char		*dptr;		// Pointer into destination
+
+
+  if (!src->width || !src->height || !bitmap_resize(dst, x + src->width, y + src->height))
+    return;
+
+  for (sy = 0, sptr = src->pixels; sy < src->height; sy ++)
+  {
+    for (sx = 0, dptr = dst->pixels + (y + sy) * dst->width + x; sx < src->width; sx ++, sptr ++, dptr ++)
+      *dptr |= *sptr;
+  }
+}
+
+
+//
+// 'bitmap_lines()' - Draw lines of 1-bit graphics on a bitmap.
+//
+// The "black" argument specifies whether 1 bits (`true`) or 0 bits (`false`)
+// are black.
+//
+
+static void
+bitmap_lines(sim_bitmap_t        *bitmap,// I - Bitmap
+             unsigned            x,	// I - X position
+             unsigned            y,	// I - Y position
+             const unsigned char *data,	// I - Graphics data
+             unsigned            bytes,	// I - Bytes per line
+             unsigned            lines,	// I - Number of lines
+             bool                black)	// I - `true` if 1 bits are black
+{
+  unsigned	i,			// Current pixel
+		dots = 8 * bytes;	// Pixels per line
+  unsigned char	*dptr;			// Pointer into bitmap
+
+
+  if (!bytes || !lines || !bitmap_resize(bitmap, x + dots, y + lines))
+    return;
+
+  for (; lines > 0; lines --, y ++, data += bytes)
+  {
+    for (i = 0, dptr = bitmap->pixels + y * bitmap->width + x; i < dots; i ++, dptr ++)
+    {
+      if (((data[i / 8] & (0x80 >> (i & 7))) != 0) == black)
+        *dptr = 1;
+    }
+  }
+}
+
+
+//
+// 'bitmap_resize()' - Make sure a bitmap is at least the specified size.
+//
+// Rows are allocated in chunks so that graphics can be added a line at a time.
+//
+
+static bool				// O - `true` on success, `false` on error
+bitmap_resize(sim_bitmap_t *bitmap,	// I - Bitmap
+              unsigned     width,	// I - Minimum width
+              unsigned     height)	// I - Minimum height
+{
+  unsigned char	*pixels;		// New pixels
+  unsigned	alloc_height,		// New allocated height
+		y;			// Current row
+
+
+  if (width <= bitmap->width && height <= bitmap->height)
+    return (true);
+
+  if (width > 65535 || height > 65535)
+    return (false);
+
+  if (width <= bitmap->width && height <= bitmap->alloc_height)
+  {
+    // Just use more of the allocated rows...
+    bitmap->height = height;
+    return (true);
+  }
+
+  if (width < bitmap->width)
+    width = bitmap->width;
+  if (height < bitmap->height)
+    height = bitmap->height;
+
+  alloc_height = height + height / 2 + 64;
+
+  if ((pixels = calloc((size_t)width, alloc_height)) == NULL)
+    return (false);
+
+  for (y = 0; y < bitmap->height; y ++)
+    memcpy(pixels + y * width, bitmap->pixels + y * bitmap->width, bitmap->width);
+
+  free(bitmap->pixels);
+
+  bitmap->pixels       = pixels;
+  bitmap->width        = width;
+  bitmap->height       = height;
+  bitmap->alloc_height = alloc_height;
+
+  return (true);
+}
+
+
+//
+// 'bitmap_write()' - Write a bitmap as a PBM image.
+//
+
+static bool				// O - `true` on success, `false` on error
+bitmap_write(sim_bitmap_t *bitmap,	// I - Bitmap
+             const char   *filename)	// I - Filename
+{
+  FILE			*fp;		// PBM file
+  unsigned		x,		// Current column
+			y;		// Current row
+  const unsigned char	*pixel;		// Current pixel
+  unsigned char		byte,		// Current byte
+			bit;		// Current bit
+
+
+  if ((fp = fopen(filename, "wb")) == NULL)
+  {
+    perror(filename);
+    return (false);
+  }
+
+  fprintf(fp, "P4\n%u %u\n", bitmap->width, bitmap->height);
+
+  for (y = 0, pixel = bitmap->pixels; y < bitmap->height; y ++)
+  {
+    for (x = 0, byte = 0, bit = 0x80; x < bitmap->width; x ++, pixel ++)
+    {
+      if (*pixel)
+        byte |= bit;
+
+      if ((bit >>= 1) == 0 || (x + 1) == bitmap->width)
+      {
+        putc(byte, fp);
+        byte = 0;
+        bit  = 0x80;
+      }
+    }
+  }
+
+  return (!fclose(fp));
+}
+
+
+//
+// 'find_commas()' - Find the end of a command header with the given number of commas.
+//
+// Zero is returned if the header is incomplete or contains a newline.
+//
+
+static size_t				// O - Length of header or `0` if not found
+find_commas(const unsigned char *data,	// I - Data
+            size_t              len,	// I - Length of data
+            int                 commas)	// I - Number of commas
+{
+  size_t	i;			// Looping var
+
+
+  for (i = 0; i < len && i < 256; i ++)
+  {
+    if (data[i] == '\n')
+      break;
+    else if (data[i] == ',' && -- commas == 0)
+      return (i + 1);
+  }
+
+  return (0);
+}
+
+
+//
+// 'get_time()' - Get the current time in seconds.
+//
+
+static double				// O - Time in seconds
+get_time(void)
+{
+  struct timeval	curtime;	// Current time
+
+
+  gettimeofday(&curtime, NULL);
+
+  return ((double)curtime.tv_sec + 0.000001 * (double)curtime.tv_usec);
+}
+
+
+//
+// 'graphic_delete()' - Delete a stored graphic.
+//
+// The name "*" deletes all stored graphics.
+//
+
+static void
+graphic_delete(sim_t      *sim,		// I - Simulator
+               const char *name)	// I - Graphic name
+{
+  int	i;				// Looping var
+
+
+  for (i = 0; i < SIM_MAX_GRAPHICS; i ++)
+  {
+    if (sim->graphics[i].name[0] && (!strcmp(name, "*") || !strcmp(name, sim->graphics[i].name)))
+    {
+      sim->graphics[i].name[0] = '\0';
+      bitmap_clear(&sim->graphics[i].bitmap);
+    }
+  }
+}
+
+
+//
+// 'graphic_find()' - Find a stored graphic.
+//
+
+static sim_bitmap_t *			// O - Bitmap or `NULL` if not found
+graphic_find(sim_t      *sim,		// I - Simulator
+             const char *name)		// I - Graphic name
+{
+  int	i;				// Looping var
+
+
+  for (i = 0; i < SIM_MAX_GRAPHICS; i ++)
+  {
+    if (sim->graphics[i].name[0] && !strcmp(name, sim->graphics[i].name))
+      return (&sim->graphics[i].bitmap);
+  }
+
+  fprintf(stderr, "testsimulator: Graphic '%s' not found.\n", name);
+  sim->errors ++;
+
+  return (NULL);
+}
+
+
+//
+// 'graphic_store()' - Create or replace a stored graphic.
+//
+
+static sim_bitmap_t *			// O - Empty bitmap or `NULL` if memory is full
+graphic_store(sim_t      *sim,		// I - Simulator
+              const char *name)		// I - Graphic name
+{
+  int	i;				// Looping var
+
+
+  graphic_delete(sim, name);
+
+  for (i = 0; i < SIM_MAX_GRAPHICS; i ++)
+  {
+    if (!sim->graphics[i].name[0])
+    {
+      cupsCopyString(sim->graphics[i].name, name, sizeof(sim->graphics[i].name));
+      return (&sim->graphics[i].bitmap);
+    }
+  }
+
+  fprintf(stderr, "testsimulator: No room to store graphic '%s'.\n", name);
+  sim->errors ++;
+
+  return (NULL);
+}
+
+
+//
+// 'load_reference()' - Load the first page of a PWG raster file as a bitmap.
+//
+// Grayscale pixels are thresholded at 50%.
+//
+
+static bool				// O - `true` on success, `false` on error
+load_reference(const char   *filename,	// I - PWG raster file
+               sim_bitmap_t *bitmap)	// O - Bitmap
+{
+  int			fd;		// File descriptor
+  cups_raster_t		*ras;		// Raster stream
+  cups_page_header_t	header;		// Page header
+  unsigned char		*line = NULL,	// Line buffer
+			*pixel;		// Pointer into bitmap
+  unsigned		x,		// Current column
+			y;		// Current row
+  bool			ret = false;	// Return value
+
+
+  if ((fd = open(filename, O_RDONLY)) < 0)
+  {
+    perror(filename);
+    return (false);
+  }
+
+  if ((ras = cupsRasterOpen(fd, CUPS_RASTER_READ)) == NULL)
+  {
+    fprintf(stderr, "%s: %s\n", filename, cupsGetErrorString());
+    close(fd);
+    return (false);
+  }
+
+  if (!cupsRasterReadHeader(ras, &header))
+  {
+    fprintf(stderr, "%s: No pages.\n", filename);
+  }
+  else if (header.cupsBitsPerPixel != 8 || (header.cupsColorSpace != CUPS_CSPACE_K && header.cupsColorSpace != CUPS_CSPACE_SW))
+  {
+    fprintf(stderr, "%s: Only 8-bit grayscale pages are supported.\n", filename);
+  }
+  else if ((line = malloc(header.cupsBytesPerLine)) == NULL || !bitmap_resize(bitmap, header.cupsWidth, header.cupsHeight))
+  {
+    perror(filename);
+  }
+  else
+  {
+    for (y = 0, pixel = bitmap->pixels; y < header.cupsHeight; y ++)
+    {
+      if (!cupsRasterReadPixels(ras, line, header.cupsBytesPerLine))
+        break;
+
+      for (x = 0; x < header.cupsWidth; x ++, pixel ++)
+        *pixel = header.cupsColorSpace == CUPS_CSPACE_K ? line[x] >= 128 : line[x] < 128;
+    }
+
+    if (y < header.cupsHeight)
+      fprintf(stderr, "%s: Early end-of-file at line %u.\n", filename, y);
+    else
+      ret = true;
+  }
+
+  free(line);
+  cupsRasterClose(ras);
+  close(fd);
+
+  return (ret);
+}
+
+
+//
+// 'pcx_decode()' - Decode a 1-bit PCX image.
+//
+// PCX images use 1 bits for white.
+//
+
+static bool				// O - `true` on success, `false` on error
+pcx_decode(sim_bitmap_t        *bitmap,	// I - Bitmap
+           const unsigned char *data,	// I - PCX file
+           size_t              size)	// I - Size of PCX file
+{
+  const unsigned char	*ptr,		// Pointer into PCX data
+			*end = data + size;
+					// End of PCX data
+  unsigned		width,		// Width in pixels
+			height,		// Height in lines
+			bpl,		// Bytes per line
+			x,		// Current byte in line
+			y,		// Current line
+			count;		// Repeat count
+  unsigned char		*line;		// Line buffer
+
+
+  if (!bitmap || size < LPRINT_PCX_HEADER || data[0] != 10 || data[3] != 1 || data[65] != 1)
+    return (false);
+
+  width  = (unsigned)(data[8] | (data[9] << 8)) - (unsigned)(data[4] | (data[5] << 8)) + 1;
+  height = (unsigned)(data[10] | (data[11] << 8)) - (unsigned)(data[6] | (data[7] << 8)) + 1;
+  bpl    = (unsigned)(data[66] | (data[67] << 8));
+
+  if (width > 65535 || height > 65535 || bpl < (width + 7) / 8 || (line = malloc(bpl)) == NULL)
+    return (false);
+
+  for (y = 0, ptr = data + LPRINT_PCX_HEADER; y < height; y ++)
+  {
+    for (x = 0; x < bpl && ptr < end;)
+    {
+      if ((*ptr & 0xc0) == 0xc0)
+      {
+        count = *ptr++ & 0x3f;
+        if (ptr >= end)
+          break;
+      }
+      else
+      {
+        count = 1;
+      }
+
+      for (; count > 0 && x < bpl; count --)
+        line[x ++] = *ptr;
+
+      ptr ++;
+    }
+
+    if (x < bpl)
+      break;
+
+    bitmap_lines(bitmap, 0, y, line, (width + 7) / 8, 1, false);
+  }
+
+  free(line);
+
+  return (y >= height);
+}
+
+
+//
+// 'sim_dymo()' - Process DYMO commands.
+//
+
+static void
+sim_dymo(sim_t  *sim,			// I - Simulator
+         size_t *used,			// IO - Bytes processed
+         bool   eof)			// I - End of data?
+{
+  const unsigned char	*data,		// Current command
+			*ptr;		// Pointer into compressed line
+  size_t		len;		// Bytes remaining
+  unsigned		dots,		// Dots in compressed line
+			count;		// Dots in run
+  unsigned char		line[256],	// Decompressed line
+			status;		// Status byte
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    if (*data == 0x16)
+    {
+      // SYN: Raw line of graphics...
+      if (len < (1 + sim->width))
+        break;
+
+      bitmap_lines(&sim->page, sim->x, sim->y ++, data + 1, sim->width, 1, true);
+      sim->drawn = true;
+      *used += 1 + sim->width;
+    }
+    else if (*data == 0x17)
+    {
+      // ETB: Compressed line of graphics, each byte is a run of 1-128 dots...
+      memset(line, 0, sizeof(line));
+
+      for (ptr = data + 1, dots = 0; dots < 8 * sim->width && ptr < (data + len); ptr ++)
+      {
+        for (count = (*ptr & 0x7f) + 1; count > 0 && dots < 8 * sim->width; count --, dots ++)
+        {
+          if (*ptr & 0x80)
+            line[dots / 8] |= 0x80 >> (dots & 7);
+        }
+      }
+
+      if (dots < 8 * sim->width)
+        break;
+
+      bitmap_lines(&sim->page, sim->x, sim->y ++, line, sim->width, 1, true);
+      sim->drawn = true;
+      *used += (size_t)(ptr - data);
+    }
+    else if (*data == 0x1b)
+    {
+      // ESC commands...
+      if (len < 2)
+        break;
+
+      switch (data[1])
+      {
+        case 'A' : // Get status
+            status = sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT ? 0x20 : 0x00;
+            sim_respond(sim, &status, 1);
+            *used += 2;
+            break;
+
+        case 'B' : // Set dot tab
+            if (len < 3)
+              goto done;
+            sim->x = 8 * data[2];
+            *used += 3;
+            break;
+
+        case 'D' : // Set bytes per line
+            if (len < 3)
+              goto done;
+            sim->width = data[2];
+            *used += 3;
+            break;
+
+        case 'E' : // Form feed
+        case 'G' : // Short form feed
+            sim_label(sim, 1);
+            *used += 2;
+            break;
+
+        case 'L' : // Set label length
+            if (len < 4)
+              goto done;
+            sim->length = (unsigned)((data[2] << 8) | data[3]);
+            *used += 4;
+            break;
+
+        case 'Q' : // Set label index
+            if (len < 4)
+              goto done;
+            *used += 4;
+            break;
+
+        case 'C' : // Set tape type
+        case 'q' : // Select roll
+            if (len < 3)
+              goto done;
+            *used += 3;
+            break;
+
+        case 'f' : // Skip lines
+            if (len < 4)
+              goto done;
+            if (data[2] == 1)
+              sim->y += data[3];
+            *used += 4;
+            break;
+
+        case 0x1b : // Reset sequence
+            *used += 1;
+            break;
+
+        default : // Other commands have no arguments
+            *used += 2;
+            break;
+      }
+    }
+    else
+    {
+      // Skip nul bytes and other data...
+      *used += 1;
+    }
+  }
+
+  done:
+
+  if (eof)
+    *used = sim->used;
+}
+
+
+//
+// 'sim_epl2()' - Process EPL2 commands.
+//
+
+static void
+sim_epl2(sim_t  *sim,			// I - Simulator
+         size_t *used,			// IO - Bytes processed
+         bool   eof)			// I - End of data?
+{
+  const unsigned char	*data,		// Current command
+			*eol;		// End of line
+  size_t		len,		// Bytes remaining
+			linelen;	// Length of line
+  char			line[1024],	// Command line
+			name[64],	// Graphic name
+			response[1024];	// Response
+  unsigned		x, y,		// Position
+			bytes,		// Bytes per line
+			lines,		// Number of lines
+			size;		// Size of graphic
+  sim_bitmap_t		*graphic;	// Stored graphic
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    if (*data == '\r' || *data == '\n')
+    {
+      *used += 1;
+      continue;
+    }
+
+    if ((eol = memchr(data, '\n', len)) == NULL)
+      break;
+
+    // Copy the command line...
+    if ((linelen = (size_t)(eol - data)) > 0 && data[linelen - 1] == '\r')
+      linelen --;
+    if (linelen >= sizeof(line))
+      linelen = sizeof(line) - 1;
+
+    memcpy(line, data, linelen);
+    line[linelen] = '\0';
+
+    // Process it...
+    if (sscanf(line, "GW%u,%u,%u,%u", &x, &y, &bytes, &lines) == 4)
+    {
+      // Graphics follow the command line...
+      if ((len - (size_t)(eol - data + 1)) < (size_t)bytes * lines)
+        break;
+
+      bitmap_lines(&sim->page, x, y, eol + 1, bytes, lines, false);
+      sim->drawn = true;
+      *used += (size_t)(eol - data + 1) + (size_t)bytes * lines;
+      continue;
+    }
+    else if (sscanf(line, "GM\"%63[^\"]\"%u", name, &size) == 2)
+    {
+      // PCX image follows the command line...
+      if ((len - (size_t)(eol - data + 1)) < size)
+        break;
+
+      if ((graphic = graphic_store(sim, name)) != NULL && !pcx_decode(graphic, eol + 1, size))
+      {
+        fprintf(stderr, "testsimulator: Bad PCX image for graphic '%s'.\n", name);
+        sim->errors ++;
+      }
+
+      *used += (size_t)(eol - data + 1) + size;
+      continue;
+    }
+    else if (sscanf(line, "GG%u,%u,\"%63[^\"]\"", &x, &y, name) == 3)
+    {
+      if ((graphic = graphic_find(sim, name)) != NULL)
+        bitmap_draw(&sim->page, x, y, graphic);
+
+      sim->drawn = true;
+    }
+    else if (sscanf(line, "GK\"%63[^\"]\"", name) == 1)
+    {
+      graphic_delete(sim, name);
+    }
+    else if (!strcmp(line, "N"))
+    {
+      bitmap_clear(&sim->page);
+      sim->drawn = false;
+    }
+    else if (line[0] == 'P' && isdigit(line[1] & 255))
+    {
+      sim_label(sim, (unsigned)atoi(line + 1));
+    }
+    else if (line[0] == 'q' && isdigit(line[1] & 255))
+    {
+      sim->width = (unsigned)atoi(line + 1);
+    }
+    else if (line[0] == 'Q' && isdigit(line[1] & 255))
+    {
+      sim->length = (unsigned)atoi(line + 1);
+    }
+    else if (!strcmp(line, "UQ"))
+    {
+      snprintf(response, sizeof(response), "UKQ1935HLU     V4.70.1A\r\nSerial port:96,N,8,1\r\nImage buffer size:0245K\r\nq%u Q%u,24\r\n", sim->width, sim->length ? sim->length : 6 * (unsigned)sim->resolution);
+      sim_respond(sim, response, strlen(response));
+    }
+    else if (!strcmp(line, "^ee"))
+    {
+      // Error status, only "paper or ribbon empty" (07) is reported...
+      sim_respond(sim, sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT ? "07\r\n" : "00\r\n", 4);
+    }
+
+    *used += (size_t)(eol - data + 1);
+  }
+
+  if (eof)
+    *used = sim->used;
+}
+
+
+//
+// 'sim_escpos()' - Process ESC/POS commands.
+//
+
+static void
+sim_escpos(sim_t  *sim,			// I - Simulator
+           size_t *used,		// IO - Bytes processed
+           bool   eof)			// I - End of data?
+{
+  const unsigned char	*data;		// Current command
+  size_t		len,		// Bytes remaining
+			size;		// Size of command
+  unsigned		bytes,		// Bytes per line
+			lines;		// Number of lines
+  char			name[3];	// NV graphic name
+  unsigned char		status[4];	// Status bytes
+  sim_bitmap_t		*graphic;	// Stored graphic
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    if (*data == 0x1b)
+    {
+      // ESC commands...
+      if (len < 2)
+        break;
+
+      switch (data[1])
+      {
+        case '@' : // Initialize printer
+            if (sim->drawn)
+              sim_label(sim, 1);
+            sim->y = 0;
+            *used += 2;
+            break;
+
+        case 'J' : // Feed lines
+            if (len < 3)
+              goto done;
+            sim->y += data[2];
+            *used += 3;
+            break;
+
+        case 'i' : // Full cut
+        case 'm' : // Partial cut
+            sim_label(sim, 1);
+            sim->y = 0;
+            *used += 2;
+            break;
+
+        case 'v' : // Paper sensor status
+            status[0] = sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT ? 0x0c : 0x00;
+            sim_respond(sim, status, 1);
+            *used += 2;
+            break;
+
+        default : // Assume other commands have one argument
+            if (len < 3)
+              goto done;
+            *used += 3;
+            break;
+      }
+    }
+    else if (*data == 0x1d)
+    {
+      // GS commands...
+      if (len < 3)
+        break;
+
+      switch (data[1])
+      {
+        case 'a' : // Automatic status back
+            if (data[2])
+            {
+              status[0] = 0x10;
+              status[1] = 0x00;
+              status[2] = 0x00;
+              status[3] = 0x00;
+
+              if (sim->fault_active && sim->fault == SIM_FAULT_HEAD_OPEN)
+                status[0] |= 0x20;
+              else if (sim->fault_active && sim->fault == SIM_FAULT_JAM)
+                status[1] |= 0x08;
+              else if (sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT)
+                status[2] |= 0x0c;
+
+              sim_respond(sim, status, 4);
+            }
+            *used += 3;
+            break;
+
+        case 'L' : // Set left margin
+            if (len < 4)
+              goto done;
+            *used += 4;
+            break;
+
+        case 'v' : // Raster graphics
+            if (len < 8)
+              goto done;
+
+            bytes = (unsigned)(data[4] | (data[5] << 8));
+            lines = (unsigned)(data[6] | (data[7] << 8));
+
+            if (len < (8 + (size_t)bytes * lines))
+              goto done;
+
+            bitmap_lines(&sim->page, 0, sim->y, data + 8, bytes, lines, true);
+            sim->y     += lines;
+            sim->drawn = true;
+            *used += 8 + (size_t)bytes * lines;
+            break;
+
+        case '(' : // Graphics functions
+            if (len < 5)
+              goto done;
+
+            size = 5 + (size_t)(data[3] | (data[4] << 8));
+
+            if (len < size)
+              goto done;
+
+            if (data[2] == 'L' && size >= 9 && data[6] == 66)
+            {
+              // Delete NV graphic...
+              name[0] = (char)data[7];
+              name[1] = (char)data[8];
+              name[2] = '\0';
+
+              graphic_delete(sim, name);
+            }
+            else if (data[2] == 'L' && size >= 16 && data[6] == 67)
+            {
+              // Define NV graphic...
+              name[0] = (char)data[8];
+              name[1] = (char)data[9];
+              name[2] = '\0';
+
+              bytes = (unsigned)(data[11] | (data[12] << 8)) / 8;
+              lines = (unsigned)(data[13] | (data[14] << 8));
+
+              if ((16 + (size_t)bytes * lines) > size)
+              {
+                fprintf(stderr, "testsimulator: Bad NV graphic '%s'.\n", name);
+                sim->errors ++;
+              }
+              else if ((graphic = graphic_store(sim, name)) != NULL)
+              {
+                bitmap_lines(graphic, 0, 0, data + 16, bytes, lines, true);
+              }
+            }
+            else if (data[2] == 'L' && size >= 9 && data[6] == 69)
+            {
+              // Print NV graphic...
+              name[0] = (char)data[7];
+              name[1] = (char)data[8];
+              name[2] = '\0';
+
+              if ((graphic = graphic_find(sim, name)) != NULL)
+              {
+                bitmap_draw(&sim->page, 0, sim->y, graphic);
+                sim->y += graphic->height;
+              }
+
+              sim->drawn = true;
+            }
+
+            *used += size;
+            break;
+
+        default : // Assume other commands have one argument
+            *used += 3;
+            break;
+      }
+    }
+    else
+    {
+      // Skip text and other control characters...
+      *used += 1;
+    }
+  }
+
+  done:
+
+  if (eof)
+  {
+    // Receipts that were not cut are still printed...
+    if (sim->drawn)
+      sim_label(sim, 1);
+
+    *used = sim->used;
+  }
+}
+
+
+//
+// 'sim_label()' - Print the current label.
+//
+
+static void
+sim_label(sim_t    *sim,		// I - Simulator
+          unsigned copies)		// I - Number of copies
+{
+  char		filename[1024];		// PBM filename
+  double	diff;			// Difference from reference
+
+
+  if (copies == 0)
+    copies = 1;
+
+  sim->labels       += (int)copies;
+  sim->total_labels += (int)copies;
+  sim->last_label   = get_time();
+
+  if (sim->outdir)
+  {
+    snprintf(filename, sizeof(filename), "%s/%s-%05d.pbm", sim->outdir, sim_langs[sim->lang], sim->total_labels);
+    bitmap_write(&sim->page, filename);
+  }
+
+  if (sim->reference.pixels)
+  {
+    if ((diff = bitmap_compare(&sim->reference, &sim->page)) > sim->max_diff)
+      sim->max_diff = diff;
+
+    if (diff > sim->tolerance)
+      fprintf(stderr, "testsimulator: Label %d differs from the reference by %.2f%%.\n", sim->total_labels, diff);
+  }
+
+  bitmap_clear(&sim->page);
+  sim->drawn = false;
+
+  // Start the fault after the requested number of labels; a disconnect only
+  // happens once...
+  if (sim->fault != SIM_FAULT_NONE && !sim->fault_active && sim->total_labels >= sim->fault_after)
+    sim->fault_active = true;
+
+  if (sim->fault_active && sim->fault == SIM_FAULT_DISCONNECT)
+  {
+    sim->disconnect   = true;
+    sim->fault        = SIM_FAULT_NONE;
+    sim->fault_active = false;
+  }
+}
+
+
+//
+// 'sim_respond()' - Send a status response.
+//
+
+static void
+sim_respond(sim_t      *sim,		// I - Simulator
+            const void *data,		// I - Response
+            size_t     bytes)		// I - Size of response
+{
+  sim->queries ++;
+
+  if (sim->outfd < 0)
+    return;
+
+  if (sim->latency > 0)
+    usleep((useconds_t)(1000 * sim->latency));
+
+  if (write(sim->outfd, data, bytes) < 0)
+    sim->disconnect = true;
+}
+
+
+//
+// 'sim_run()' - Process a connection or capture file.
+//
+
+static bool				// O - `true` if all labels match, `false` otherwise
+sim_run(sim_t      *sim,		// I - Simulator
+        int        infd,		// I - Input file descriptor
+        int        outfd,		// I - Response file descriptor or `-1`
+        const char *source)		// I - Source of data
+{
+  ssize_t	bytes;			// Bytes read
+  size_t	chunk,			// Bytes to read
+		total = 0,		// Total bytes
+		used;			// Bytes processed
+  double	start = 0.0,		// Time of first byte
+		end,			// Time of last label or byte
+		delay;			// Bandwidth delay
+  unsigned char	*data;			// New data buffer
+
+
+  // Reset the connection state...
+  sim->outfd      = outfd;
+  sim->used       = 0;
+  sim->disconnect = false;
+  sim->drawn      = false;
+  sim->x          = 0;
+  sim->y          = 0;
+  sim->width      = 0;
+  sim->copies     = 1;
+  sim->labels     = 0;
+  sim->queries    = 0;
+  sim->errors     = 0;
+  sim->max_diff   = 0.0;
+  sim->last_label = 0.0;
+
+  bitmap_clear(&sim->page);
+
+  if (sim->fault_active && sim->fault == SIM_FAULT_DISCONNECT)
+  {
+    sim->disconnect   = true;
+    sim->fault        = SIM_FAULT_NONE;
+    sim->fault_active = false;
+  }
+
+  // Read and process data, limiting the read size so the link bandwidth is
+  // simulated in 20ms steps...
+  if (sim->bandwidth > 0.0)
+  {
+    if ((chunk = (size_t)(sim->bandwidth / 8.0 / 50.0)) < 1)
+      chunk = 1;
+    else if (chunk > 65536)
+      chunk = 65536;
+  }
+  else
+    chunk = 65536;
+
+  while (!sim->disconnect)
+  {
+    if ((sim->used + chunk) > sim->alloc)
+    {
+      if ((data = realloc(sim->data, sim->used + chunk)) == NULL)
+      {
+        perror("testsimulator");
+        sim->errors ++;
+        break;
+      }
+
+      sim->data  = data;
+      sim->alloc = sim->used + chunk;
+    }
+
+    if ((bytes = read(infd, sim->data + sim->used, chunk)) < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN)
+        continue;
+
+      break;
+    }
+    else if (bytes == 0)
+    {
+      break;
+    }
+
+    if (total == 0)
+      start = get_time();
+
+    sim->used += (size_t)bytes;
+    total     += (size_t)bytes;
+    used      = 0;
+
+    switch (sim->lang)
+    {
+      case SIM_LANG_DYMO :
+          sim_dymo(sim, &used, false);
+          break;
+      case SIM_LANG_EPL2 :
+          sim_epl2(sim, &used, false);
+          break;
+      case SIM_LANG_ESCPOS :
+          sim_escpos(sim, &used, false);
+          break;
+      case SIM_LANG_SII :
+          sim_sii(sim, &used, false);
+          break;
+      case SIM_LANG_TSPL :
+          sim_tspl(sim, &used, false);
+          break;
+      case SIM_LANG_ZPL :
+          sim_zpl(sim, &used, false);
+          break;
+    }
+
+    if (used > 0)
+    {
+      memmove(sim->data, sim->data + used, sim->used - used);
+      sim->used -= used;
+    }
+
+    if (sim->bandwidth > 0.0 && (delay = start + 8.0 * total / sim->bandwidth - get_time()) > 0.0)
+      usleep((useconds_t)(1000000.0 * delay));
+  }
+
+  // Process any remaining data, unless the connection was dropped...
+  used = 0;
+
+  if (!sim->disconnect)
+  {
+    switch (sim->lang)
+    {
+      case SIM_LANG_DYMO :
+          sim_dymo(sim, &used, true);
+          break;
+      case SIM_LANG_EPL2 :
+          sim_epl2(sim, &used, true);
+          break;
+      case SIM_LANG_ESCPOS :
+          sim_escpos(sim, &used, true);
+          break;
+      case SIM_LANG_SII :
+          sim_sii(sim, &used, true);
+          break;
+      case SIM_LANG_TSPL :
+          sim_tspl(sim, &used, true);
+          break;
+      case SIM_LANG_ZPL :
+          sim_zpl(sim, &used, true);
+          break;
+    }
+  }
+
+  sim->used = 0;
+
+  // Report the results...
+  end = sim->labels > 0 ? sim->last_label : get_time();
+
+  if (total == 0)
+    start = end;
+
+  printf("%s,%s,%lu,%.3f,%d,%.1f,%d,%.2f,%d\n", source, sim_langs[sim->lang], (unsigned long)total, end - start, sim->labels, end > start ? 60.0 * sim->labels / (end - start) : 0.0, sim->queries, sim->max_diff, sim->errors);
+  fflush(stdout);
+
+  return (sim->errors == 0 && sim->max_diff <= sim->tolerance);
+}
+
+
+//
+// 'sim_sii()' - Process SII SLP commands.
+//
+
+static void
+sim_sii(sim_t  *sim,			// I - Simulator
+        size_t *used,			// IO - Bytes processed
+        bool   eof)			// I - End of data?
+{
+  const unsigned char	*data;		// Current command
+  size_t		len;		// Bytes remaining
+  unsigned		i,		// Looping var
+			dots,		// Dots in compressed line
+			count;		// Dots in run
+  unsigned char		status;		// Status byte
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    switch (*data)
+    {
+      case 0x01 : // Status
+          if (!sim->fault_active)
+            status = 0x00;
+          else if (sim->fault == SIM_FAULT_MEDIA_OUT)
+            status = 0x01;
+          else if (sim->fault == SIM_FAULT_HEAD_OPEN)
+            status = 0x02;
+          else
+            status = 0x08;
+
+          sim_respond(sim, &status, 1);
+          *used += 1;
+          break;
+
+      case 0x04 : // Print line
+          if (len < 2 || len < (2 + (size_t)data[1]))
+            goto done;
+
+          memset(sim->line, 0, sizeof(sim->line));
+          memcpy(sim->line, data + 2, data[1]);
+          sim->width = data[1];
+
+          bitmap_lines(&sim->page, sim->x, sim->y ++, sim->line, sim->width, 1, true);
+          sim->drawn = true;
+          *used += 2 + (size_t)data[1];
+          break;
+
+      case 0x05 : // Print run-length encoded line, each byte is a run of 1-127 dots
+          if (len < 2 || len < (2 + (size_t)data[1]))
+            goto done;
+
+          memset(sim->line, 0, sizeof(sim->line));
+
+          for (i = 0, dots = 0; i < data[1]; i ++)
+          {
+            for (count = data[2 + i] & 0x7f; count > 0 && dots < 8 * sizeof(sim->line); count --, dots ++)
+            {
+              if (data[2 + i] & 0x80)
+                sim->line[dots / 8] |= 0x80 >> (dots & 7);
+            }
+          }
+
+          sim->width = (dots + 7) / 8;
+
+          bitmap_lines(&sim->page, sim->x, sim->y ++, sim->line, sim->width, 1, true);
+          sim->drawn = true;
+          *used += 2 + (size_t)data[1];
+          break;
+
+      case 0x07 : // Repeat last line
+          if (len < 2)
+            goto done;
+
+          for (i = 0; i < data[1]; i ++)
+            bitmap_lines(&sim->page, sim->x, sim->y ++, sim->line, sim->width, 1, true);
+
+          *used += 2;
+          break;
+
+      case 0x0a : // Line feed
+          sim->y ++;
+          *used += 1;
+          break;
+
+      case 0x0b : // Vertical tab
+          if (len < 2)
+            goto done;
+
+          sim->y += data[1];
+          *used  += 2;
+          break;
+
+      case 0x0c : // Form feed
+          sim_label(sim, 1);
+          sim->y = 0;
+          *used += 1;
+          break;
+
+      case 0x0f : // Reset, commands sent during the reset are answered afterwards
+          if (sim->outfd >= 0)
+            usleep(1000 * SIM_SII_RESET_TIME);
+
+          bitmap_clear(&sim->page);
+          sim->drawn = false;
+          sim->y     = 0;
+          sim->width = 0;
+          *used += 1;
+          break;
+
+      case 0x03 : // Set baud rate
+      case 0x06 : // Set margin, ignored since labels are aligned
+      case 0x0d : // Set speed
+      case 0x0e : // Set density
+      case 0x16 : // Set indent
+      case 0x17 : // Set fine mode
+          if (len < 2)
+            goto done;
+
+          *used += 2;
+          break;
+
+      default : // Other commands have no arguments
+          *used += 1;
+          break;
+    }
+  }
+
+  done:
+
+  if (eof)
+    *used = sim->used;
+}
+
+
+//
+// 'sim_tspl()' - Process TSPL commands.
+//
+
+static void
+sim_tspl(sim_t  *sim,			// I - Simulator
+         size_t *used,			// IO - Bytes processed
+         bool   eof)			// I - End of data?
+{
+  const unsigned char	*data,		// Current command
+			*eol;		// End of line
+  size_t		len,		// Bytes remaining
+			hdrlen,		// Length of command header
+			linelen;	// Length of line
+  char			line[1024],	// Command line
+			name[64];	// Graphic name
+  unsigned		x, y,		// Position
+			bytes,		// Bytes per line
+			lines,		// Number of lines
+			mode,		// Drawing mode
+			size,		// Size of graphic
+			sets,		// Number of label sets
+			copies;		// Number of copies
+  float			width,		// Label width in millimeters
+			length;		// Label length in millimeters
+  unsigned char		status;		// Status byte
+  sim_bitmap_t		*graphic;	// Stored graphic
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    if (*data == '\r' || *data == '\n' || *data == ' ')
+    {
+      *used += 1;
+      continue;
+    }
+    else if (*data == 0x1b)
+    {
+      // ESC ! ? status query...
+      if (len < 3)
+        break;
+
+      if (data[1] == '!' && data[2] == '?')
+      {
+        status = 0x00;
+
+        if (sim->fault_active && sim->fault == SIM_FAULT_HEAD_OPEN)
+          status = 0x01;
+        else if (sim->fault_active && sim->fault == SIM_FAULT_JAM)
+          status = 0x02;
+        else if (sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT)
+          status = 0x04;
+
+        sim_respond(sim, &status, 1);
+      }
+
+      *used += 3;
+      continue;
+    }
+    else if (len >= 7 && !memcmp(data, "BITMAP ", 7))
+    {
+      // BITMAP x,y,bytes,lines,mode,data
+      if ((hdrlen = find_commas(data, len, 5)) == 0)
+      {
+        if (len < 256 && !memchr(data, '\n', len))
+          break;
+      }
+      else
+      {
+        memcpy(line, data, hdrlen);
+        line[hdrlen] = '\0';
+
+        if (sscanf(line, "BITMAP %u,%u,%u,%u,%u,", &x, &y, &bytes, &lines, &mode) == 5)
+        {
+          if ((len - hdrlen) < (size_t)bytes * lines)
+            break;
+
+          bitmap_lines(&sim->page, x, y, data + hdrlen, bytes, lines, false);
+          sim->drawn = true;
+          *used += hdrlen + (size_t)bytes * lines;
+          continue;
+        }
+      }
+    }
+    else if (len >= 9 && !memcmp(data, "DOWNLOAD ", 9))
+    {
+      // DOWNLOAD "name",size,data
+      if ((hdrlen = find_commas(data, len, 2)) == 0)
+      {
+        if (len < 256 && !memchr(data, '\n', len))
+          break;
+      }
+      else
+      {
+        memcpy(line, data, hdrlen);
+        line[hdrlen] = '\0';
+
+        if (sscanf(line, "DOWNLOAD \"%63[^\"]\",%u,", name, &size) == 2)
+        {
+          if ((len - hdrlen) < size)
+            break;
+
+          if ((graphic = graphic_store(sim, name)) != NULL && !pcx_decode(graphic, data + hdrlen, size))
+          {
+            fprintf(stderr, "testsimulator: Bad PCX image for graphic '%s'.\n", name);
+            sim->errors ++;
+          }
+
+          *used += hdrlen + size;
+          continue;
+        }
+      }
+    }
+
+    // Other commands are terminated by a newline...
+    if ((eol = memchr(data, '\n', len)) == NULL)
+      break;
+
+    if ((linelen = (size_t)(eol - data)) > 0 && data[linelen - 1] == '\r')
+      linelen --;
+    if (linelen >= sizeof(line))
+      linelen = sizeof(line) - 1;
+
+    memcpy(line, data, linelen);
+    line[linelen] = '\0';
+
+    if (!strcmp(line, "CLS"))
+    {
+      bitmap_clear(&sim->page);
+      sim->drawn = false;
+    }
+    else if (sscanf(line, "SIZE %f mm,%f mm", &width, &length) == 2)
+    {
+      sim->length = (unsigned)(length * sim->resolution / 25.4);
+    }
+    else if (sscanf(line, "PUTPCX %u,%u,\"%63[^\"]\"", &x, &y, name) == 3)
+    {
+      if ((graphic = graphic_find(sim, name)) != NULL)
+        bitmap_draw(&sim->page, x, y, graphic);
+
+      sim->drawn = true;
+    }
+    else if (!strncmp(line, "PRINT ", 6))
+    {
+      sets   = 1;
+      copies = 1;
+
+      sscanf(line + 6, "%u,%u", &sets, &copies);
+      sim_label(sim, sets * copies);
+    }
+    else if (sscanf(line, "KILL \"%63[^\"]\"", name) == 1)
+    {
+      graphic_delete(sim, name);
+    }
+
+    *used += (size_t)(eol - data + 1);
+  }
+
+  if (eof)
+    *used = sim->used;
+}
+
+
+//
+// 'sim_zpl()' - Process ZPL commands.
+//
+
+static void
+sim_zpl(sim_t  *sim,			// I - Simulator
+        size_t *used,			// IO - Bytes processed
+        bool   eof)			// I - End of data?
+{
+  const unsigned char	*data,		// Current command
+			*end;		// End of command
+  size_t		len,		// Bytes remaining
+			cmdlen;		// Length of command
+  char			cmd[1024],	// Command
+			name[64],	// Graphic name
+			response[1024];	// Response
+  unsigned		x, y,		// Position
+			total,		// Total bytes in graphic
+			bpr,		// Bytes per row
+			done;		// Number of decoded rows
+  int			hdrlen;		// Length of ~DG header
+  unsigned char		*pixels;	// Graphic data
+  sim_bitmap_t		*graphic;	// Stored graphic
+  unsigned		errors;		// Error bits
+
+
+  while (*used < sim->used)
+  {
+    data = sim->data + *used;
+    len  = sim->used - *used;
+
+    if (*data != '^' && *data != '~')
+    {
+      // Skip whitespace and other characters between commands...
+      *used += 1;
+      continue;
+    }
+
+    if (len >= 3 && !memcmp(data, "~DG", 3))
+    {
+      // ~DGname,total,bpr,data - header ends after the third comma...
+      if ((cmdlen = find_commas(data, len, 3)) == 0)
+      {
+        if (len < 256 && !memchr(data, '\n', len))
+          break;
+
+        fputs("testsimulator: Bad ~DG command.\n", stderr);
+        sim->errors ++;
+        *used += 1;
+        continue;
+      }
+
+      memcpy(cmd, data, cmdlen);
+      cmd[cmdlen] = '\0';
+
+      if (sscanf(cmd, "~DG%63[^,],%u,%u,%n", name, &total, &bpr, &hdrlen) < 3 || bpr == 0 || (total / bpr) > 65535)
+      {
+        fputs("testsimulator: Bad ~DG command.\n", stderr);
+        sim->errors ++;
+        *used += cmdlen;
+        continue;
+      }
+
+      // Decode the ACS/hex graphics data...
+      if ((pixels = malloc(total)) == NULL)
+      {
+        perror("testsimulator");
+        sim->errors ++;
+        *used += cmdlen;
+        continue;
+      }
+
+      cmdlen += zpl_decode(data + cmdlen, len - cmdlen, pixels, bpr, total / bpr, &done);
+
+      if (done < (total / bpr) && cmdlen >= len && !eof)
+      {
+        // Need more data...
+        free(pixels);
+        break;
+      }
+      else if (done < (total / bpr))
+      {
+        fprintf(stderr, "testsimulator: Graphic '%s' is short %u lines.\n", name, total / bpr - done);
+        sim->errors ++;
+      }
+
+      if ((graphic = graphic_store(sim, name)) != NULL)
+        bitmap_lines(graphic, 0, 0, pixels, bpr, total / bpr, true);
+
+      free(pixels);
+      *used += cmdlen;
+      continue;
+    }
+
+    // Other commands end at the next command or newline...
+    for (end = data + 1; end < (data + len) && *end != '^' && *end != '~' && *end != '\r' && *end != '\n'; end ++);
+
+    if (end >= (data + len) && !eof)
+      break;
+
+    if ((cmdlen = (size_t)(end - data)) >= sizeof(cmd))
+      cmdlen = sizeof(cmd) - 1;
+
+    memcpy(cmd, data, cmdlen);
+    cmd[cmdlen] = '\0';
+
+    *used += (size_t)(end - data);
+
+    if (!strcmp(cmd, "^XA"))
+    {
+      // Start of label format...
+      bitmap_clear(&sim->page);
+      sim->drawn  = false;
+      sim->x      = 0;
+      sim->y      = 0;
+      sim->copies = 1;
+    }
+    else if (!strcmp(cmd, "^XZ"))
+    {
+      // End of label format, only formats with graphics are printed...
+      if (sim->drawn)
+        sim_label(sim, sim->copies);
+    }
+    else if (sscanf(cmd, "^FO%u,%u", &x, &y) == 2)
+    {
+      sim->x = x;
+      sim->y = y;
+    }
+    else if (sscanf(cmd, "^PQ%u", &sim->copies) == 1)
+    {
+      // Got quantity...
+    }
+    else if (sscanf(cmd, "^XG%63[^,^]", name) == 1)
+    {
+      if ((graphic = graphic_find(sim, name)) != NULL)
+        bitmap_draw(&sim->page, sim->x, sim->y, graphic);
+
+      sim->drawn = true;
+    }
+    else if (sscanf(cmd, "^ID%63[^^]", name) == 1)
+    {
+      graphic_delete(sim, name);
+    }
+    else if (!strcmp(cmd, "~HI"))
+    {
+      snprintf(response, sizeof(response), "\002ZT410-%ddpi,V75.20.01Z,%d,8176KB\003\r\n", sim->resolution, sim->resolution >= 600 ? 24 : sim->resolution >= 300 ? 12 : 8);
+      sim_respond(sim, response, strlen(response));
+    }
+    else if (!strcmp(cmd, "~HQES"))
+    {
+      if (sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT)
+        errors = 0x00000001;
+      else if (sim->fault_active && sim->fault == SIM_FAULT_HEAD_OPEN)
+        errors = 0x00000004;
+      else if (sim->fault_active && sim->fault == SIM_FAULT_JAM)
+        errors = 0x00001000;
+      else
+        errors = 0;
+
+      snprintf(response, sizeof(response), "\002\r\n\r\n  PRINTER STATUS\r\n   ERRORS:         %d 00000000 %08X\r\n   WARNINGS:       0 00000000 00000000\r\n\003\r\n", errors != 0, errors);
+      sim_respond(sim, response, strlen(response));
+    }
+    else if (!strcmp(cmd, "~HS"))
+    {
+      snprintf(response, sizeof(response), "\002030,%d,0,%04u,000,0,0,0,000,0,0,0\003\r\n\002000,0,%d,0,0,2,6,0,00000000,1,000\003\r\n\0021234,0\003\r\n", sim->fault_active && sim->fault == SIM_FAULT_MEDIA_OUT, sim->length ? sim->length : 6 * (unsigned)sim->resolution, sim->fault_active && sim->fault == SIM_FAULT_HEAD_OPEN);
+      sim_respond(sim, response, strlen(response));
+    }
+    else if (sscanf(cmd, "^LL%u", &sim->length) == 1)
+    {
+      // Got label length...
+    }
+  }
+
+  if (eof)
+    *used = sim->used;
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(int status)			// I - Exit status
+{
+  FILE	*fp = status ? stderr : stdout;	// Output file
+
+
+  fputs("Usage: ./testsimulator [OPTIONS] [CAPTURE-FILE ...] >RESULTS.csv\n", fp);
+  fputs("Options:\n", fp);
+  fputs("  --bandwidth BITS/SEC  Simulate a slower link, for example \"9600\" or \"10M\"\n", fp);
+  fputs("  --compare INPUT.pwg   Compare labels with the first page of INPUT.pwg\n", fp);
+  fputs("  --count CONNECTIONS   Exit after CONNECTIONS connections (default 0 = never)\n", fp);
+  fputs("  --fault FAULT         Report \"disconnect\", \"head-open\", \"jam\", or \"media-out\"\n", fp);
+  fputs("  --fault-after LABELS  Start the fault after LABELS labels (default 0)\n", fp);
+  fputs("  --help                Show program help\n", fp);
+  fputs("  --lang LANGUAGE       Use \"dymo\", \"epl2\", \"escpos\", \"sii\", \"tspl\", or \"zpl\" (default)\n", fp);
+  fputs("  --latency MS          Delay status responses by MS milliseconds (default 0)\n", fp);
+  fputs("  --output DIRECTORY    Save each label as a PBM image in DIRECTORY\n", fp);
+  fputs("  --port PORT           Listen on PORT (default 9100)\n", fp);
+  fputs("  --resolution DPI      Printer resolution (default 203)\n", fp);
+  fputs("  --tolerance PERCENT   Allowed difference for --compare (default 5)\n", fp);
+
+  return (status);
+}
+
+
+//
+// 'zpl_decode()' - Decode ZPL ACS/hex graphics data.
+//
+// Hex digits can be preceded by repeat counts ("G" to "Y" for 1 to 19 and "g"
+// to "z" for 20 to 400), "," fills the rest of the row with 0 bits, "!" fills
+// the rest of the row with 1 bits, and ":" repeats the previous row.  Decoding
+// stops at the end of the data, the next command, or after the last row.
+//
+
+static size_t				// O - Bytes consumed
+zpl_decode(const unsigned char *data,	// I - Graphics data
+           size_t              len,	// I - Length of data
+           unsigned char       *out,	// I - Output buffer
+           unsigned            bpr,	// I - Bytes per row
+           unsigned            rows,	// I - Number of rows
+           unsigned            *done)	// O - Number of decoded rows
+{
+  const unsigned char	*ptr,		// Pointer into data
+			*end = data + len;
+					// End of data
+  unsigned char		*row = out;	// Current row
+  unsigned		nibble = 0,	// Current nibble in row
+			nibbles = 2 * bpr,
+					// Nibbles per row
+			count = 0,	// Repeat count
+			value;		// Nibble value
+
+
+  memset(out, 0, (size_t)bpr * rows);
+
+  for (*done = 0, ptr = data; *done < rows && ptr < end && *ptr != '^' && *ptr != '~'; ptr ++)
+  {
+    if (*ptr >= 'G' && *ptr <= 'Y')
+    {
+      count += (unsigned)(*ptr - 'F');
+    }
+    else if (*ptr >= 'g' && *ptr <= 'z')
+    {
+      count += 20 * (unsigned)(*ptr - 'f');
+    }
+    else if (isxdigit(*ptr))
+    {
+      value = isdigit(*ptr) ? (unsigned)(*ptr - '0') : (unsigned)(tolower(*ptr) - 'a' + 10);
+
+      for (count = count ? count : 1; count > 0 && nibble < nibbles; count --, nibble ++)
+        row[nibble / 2] |= (unsigned char)((nibble & 1) ? value : value << 4);
+
+      count = 0;
+    }
+    else if (*ptr == ',' || *ptr == '!' || *ptr == ':')
+    {
+      if (*ptr == '!')
+      {
+        for (; nibble < nibbles; nibble ++)
+          row[nibble / 2] |= (unsigned char)((nibble & 1) ? 0x0f : 0xf0);
+      }
+      else if (*ptr == ':' && row > out)
+      {
+        memcpy(row, row - bpr, bpr);
+      }
+
+      nibble = nibbles;
+      count  = 0;
+    }
+
+    if (nibble >= nibbles)
+    {
+      // Move to the next row...
+      row += bpr;
+      nibble = 0;
+      (*done) ++;
+    }
+  }
+
+  return ((size_t)(ptr - data));
+}
@@ -0,0 +1,151 @@
+//
+// ZPL alert sender test program
+//
+// Copyright © 2026 by Michael R Sweet
+//
+// Licensed under Apache License v2.0.  See the file "LICENSE" for more
+// information.
+//
+// This program stands in for a network ZPL printer configured with ^SX,
+// sending alert messages to the LPrint alert listener ("zpl-alert-port"
+// server option).  Alerts are matched to printers by address, so add a printer
+// with a device URI of "socket://127.0.0.1" to test locally.
+//
+// Usage:
+//
+//   ./testzplalert [--delay SECONDS] HOST:PORT "MESSAGE" [... "MESSAGE"]
+//
+// Example:
+//
+//   ./testzplalert 127.0.0.1:9200 "ALERT: PAPER OUT" "ALERT: PAPER OUT CLEARED"
+//
+
+#include "lprint.h"
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+
+//
+// Local functions...
+//
+
+static int	usage(FILE *out);
+
+
+//
+// 'main()' - Main entry for test program.
+//
+
+int					// O - Exit status
+main(int  argc,				// I - Number of command-line arguments
+     char *argv[])			// I - Command-line arguments
+{
+  int			i;		// Looping var
+  int			delay = 1;	// Delay between messages
+  char			host[256],	// Hostname
+			*port;		// Port number
+  struct addrinfo	hints,		// Address lookup hints
+			*addrlist,	// List of addresses
+			*addr;		// Current address
+  int			fd = -1;	// Connection to LPrint
+  char			message[1024];	// Alert message
+
+
+  // Check command-line
+  for (i = 1; i < argc; i ++)
+  {
+    if (!strcmp(argv[i], "--help"))
+    {
+      return (usage(stdout));
+    }
+    else if (!strcmp(argv[i], "--delay"))
+    {
+      i ++;
+      if (i >= argc || (delay = atoi(argv[i])) < 0)
+        return (usage(stderr));
+    }
+    else if (argv[i][0] == '-')
+    {
+      fprintf(stderr, "testzplalert: Unknown option '%s'.\n", argv[i]);
+      return (usage(stderr));
+    }
+    else
+      break;
+  }
+
+  if ((i + 1) >= argc)
+    return (usage(stderr));
+
+  cupsCopyString(host, argv[i], sizeof(host));
+  if ((port = strrchr(host, ':')) == NULL)
+    return (usage(stderr));
+
+  *port++ = '\0';
+
+  // Connect to the alert listener...
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  if (getaddrinfo(host, port, &hints, &addrlist))
+  {
+    fprintf(stderr, "testzplalert: Unable to lookup '%s:%s'.\n", host, port);
+    return (1);
+  }
+
+  for (addr = addrlist; addr; addr = addr->ai_next)
+  {
+    if ((fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol)) < 0)
+      continue;
+
+    if (!connect(fd, addr->ai_addr, addr->ai_addrlen))
+      break;
+
+    close(fd);
+    fd = -1;
+  }
+
+  freeaddrinfo(addrlist);
+
+  if (fd < 0)
+  {
+    fprintf(stderr, "testzplalert: Unable to connect to '%s:%s': %s\n", host, port, strerror(errno));
+    return (1);
+  }
+
+  // Send the alerts...
+  for (i ++; i < argc; i ++)
+  {
+    snprintf(message, sizeof(message), "%s\r\n", argv[i]);
+
+    if (write(fd, message, strlen(message)) < 0)
+    {
+      fprintf(stderr, "testzplalert: Unable to send alert: %s\n", strerror(errno));
+      close(fd);
+      return (1);
+    }
+
+    printf("Sent '%s'.\n", argv[i]);
+
+    if ((i + 1) < argc && delay > 0)
+      sleep((unsigned)delay);
+  }
+
+  close(fd);
+
+  return (0);
+}
+
+
+//
+// 'usage()' - Show program usage.
+//
+
+static int				// O - Exit status
+usage(FILE *out)			// I - Output file
+{
+  fputs("Usage: ./testzplalert [--delay SECONDS] HOST:PORT \"MESSAGE\" [... \"MESSAGE\"]\n", out);
+
+  return (out == stdout ? 0 : 1);
+}